@@ -7,6 +7,8 @@
 #include <hash.h>
 #include <random.h>
 #include <uint256.h>
+#include <crypto/neoscrypt.h>
+#include <crypto/neoscrypt_multi.h>
 #include <crypto/ripemd160.h>
 #include <crypto/sha1.h>
 #include <crypto/sha256.h>
@@ -58,6 +60,25 @@ static void SHA256D64_1024(benchmark::State& state)
     }
 }
 
+static void NEOSCRYPT_80b(benchmark::State& state)
+{
+    std::vector<uint8_t> in(80, 0);
+    while (state.KeepRunning()) {
+        neoscrypt(in.data(), in.data(), 0);
+    }
+}
+
+static void NEOSCRYPT_MULTI_80b_64(benchmark::State& state)
+{
+    NeoscryptAutoDetect();
+    std::vector<uint8_t> in(80 * 64, 0);
+    std::vector<uint8_t> out(32 * 64);
+    while (state.KeepRunning()) {
+        NeoscryptMulti(out.data(), in.data(), 64);
+        memcpy(in.data(), out.data(), out.size());
+    }
+}
+
 static void SHA512(benchmark::State& state)
 {
     uint8_t hash[CSHA512::OUTPUT_SIZE];
@@ -99,5 +120,7 @@ BENCHMARK(SHA512, 330);
 BENCHMARK(SHA256_32b, 4700 * 1000);
 BENCHMARK(SipHash_32b, 40 * 1000 * 1000);
 BENCHMARK(SHA256D64_1024, 7400);
+BENCHMARK(NEOSCRYPT_80b, 1000);
+BENCHMARK(NEOSCRYPT_MULTI_80b_64, 20);
 BENCHMARK(FastRandom_32bit, 110 * 1000 * 1000);
 BENCHMARK(FastRandom_1bit, 440 * 1000 * 1000);
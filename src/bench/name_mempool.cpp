@@ -0,0 +1,138 @@
+// Copyright (c) 2019 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <script/names.h>
+#include <txmempool.h>
+#include <validation.h>
+
+#include <string>
+#include <vector>
+
+namespace
+{
+
+/** Number of names with pending operations already in the mempool.  */
+constexpr unsigned NUM_NAMES = 10000;
+/** Length of the pending chain for each of those names.  */
+constexpr unsigned CHAIN_LENGTH = 3;
+/** Number of names looked up or added per benchmark iteration.  */
+constexpr unsigned NUM_OPS = 1000;
+
+valtype
+BenchName (const std::string& prefix, const unsigned i)
+{
+  const std::string str = prefix + std::to_string (i);
+  return valtype (str.begin (), str.end ());
+}
+
+/**
+ * Builds a chain of name operations, the first registering the name and
+ * the others updating it.
+ */
+std::vector<CTransactionRef>
+BuildChain (const valtype& name, const unsigned len)
+{
+  const CScript addr = CScript () << OP_TRUE;
+  const valtype value = {'{', '}'};
+
+  std::vector<CTransactionRef> res;
+  for (unsigned i = 0; i < len; ++i)
+    {
+      CMutableTransaction mtx;
+      if (res.empty ())
+        mtx.vout.emplace_back (COIN, CNameScript::buildNameRegister (addr, name,
+                                                                     value));
+      else
+        {
+          mtx.vin.emplace_back (COutPoint (res.back ()->GetHash (), 0));
+          mtx.vout.emplace_back (COIN, CNameScript::buildNameUpdate (addr, name,
+                                                                     value));
+        }
+      res.push_back (MakeTransactionRef (std::move (mtx)));
+    }
+
+  return res;
+}
+
+void
+AddTx (const CTransactionRef& tx, CTxMemPool& pool)
+    EXCLUSIVE_LOCKS_REQUIRED (cs_main, pool.cs)
+{
+  LockPoints lp;
+  pool.addUnchecked (CTxMemPoolEntry (tx, 1000, 0, 1, false, 4, lp));
+}
+
+/**
+ * Fills the mempool with NUM_NAMES chains of pending name operations.
+ */
+void
+FillPool (CTxMemPool& pool) EXCLUSIVE_LOCKS_REQUIRED (cs_main, pool.cs)
+{
+  for (unsigned i = 0; i < NUM_NAMES; ++i)
+    for (const auto& tx : BuildChain (BenchName ("p/player", i), CHAIN_LENGTH))
+      AddTx (tx, pool);
+}
+
+} // anonymous namespace
+
+/**
+ * Queries done for each name transaction on mempool acceptance and by
+ * name_update:  checking for conflicting registrations, the length of the
+ * pending chain and its last output.
+ */
+static void
+NameMempoolLookups (benchmark::State& state)
+{
+  CTxMemPool pool;
+  LOCK2 (cs_main, pool.cs);
+  FillPool (pool);
+
+  std::vector<valtype> names;
+  std::vector<CTransactionRef> registrations;
+  for (unsigned i = 0; i < NUM_OPS; ++i)
+    {
+      names.push_back (BenchName ("p/player", i * (NUM_NAMES / NUM_OPS)));
+      registrations.push_back (BuildChain (BenchName ("p/new", i), 1)[0]);
+    }
+
+  while (state.KeepRunning ())
+    {
+      for (const auto& tx : registrations)
+        assert (pool.checkNameOps (*tx));
+      for (const auto& name : names)
+        {
+          assert (pool.pendingNameChainLength (name) == CHAIN_LENGTH);
+          assert (!pool.lastNameOutput (name).IsNull ());
+        }
+    }
+}
+
+/**
+ * Adds and removes chains of name operations to a mempool that already
+ * contains many other names.
+ */
+static void
+NameMempoolAddRemove (benchmark::State& state)
+{
+  CTxMemPool pool;
+  LOCK2 (cs_main, pool.cs);
+  FillPool (pool);
+
+  std::vector<std::vector<CTransactionRef>> chains;
+  for (unsigned i = 0; i < NUM_OPS / CHAIN_LENGTH; ++i)
+    chains.push_back (BuildChain (BenchName ("p/new", i), CHAIN_LENGTH));
+
+  while (state.KeepRunning ())
+    {
+      for (const auto& chain : chains)
+        for (const auto& tx : chain)
+          AddTx (tx, pool);
+      for (const auto& chain : chains)
+        pool.removeRecursive (*chain.front (), MemPoolRemovalReason::EXPIRY);
+    }
+}
+
+BENCHMARK (NameMempoolLookups, 20);
+BENCHMARK (NameMempoolAddRemove, 20);
@@ -0,0 +1,74 @@
+// Copyright (c) 2019 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <chain.h>
+#include <chainparams.h>
+#include <pow.h>
+#include <powdata.h>
+
+#include <vector>
+
+namespace
+{
+
+/** Number of blocks before the drought, enough for a full DGW window.  */
+constexpr unsigned NUM_EARLY_BLOCKS = 100;
+/** Number of blocks of a single algo at the end of the chain.  */
+constexpr unsigned DROUGHT_LENGTH = 50000;
+
+/**
+ * Builds a chain where both algos are mined alternately at first, followed
+ * by a long stretch of only neoscrypt blocks.
+ */
+void
+BuildDroughtChain (std::vector<CBlockIndex>& blocks,
+                   const Consensus::Params& params)
+{
+  blocks.resize (NUM_EARLY_BLOCKS + DROUGHT_LENGTH);
+  for (unsigned i = 0; i < blocks.size (); ++i)
+    {
+      CBlockIndex& index = blocks[i];
+      index.pprev = i > 0 ? &blocks[i - 1] : nullptr;
+      index.nHeight = i;
+      index.nTime = 1000000000 + 30 * i;
+      if (i < NUM_EARLY_BLOCKS && i % 2 == 0)
+        index.algo = PowAlgo::SHA256D;
+      else
+        index.algo = PowAlgo::NEOSCRYPT;
+      index.nBits = GetNextWorkRequired (index.algo, index.pprev, params);
+      index.nChainWork = (index.pprev ? index.pprev->nChainWork : 0)
+                            + GetBlockProof (index);
+      index.BuildSkip ();
+    }
+}
+
+} // anonymous namespace
+
+/**
+ * The per-algo work done when accepting a header on top of a chain in which
+ * SHA-256d has not been used for a long time:  Computing the required
+ * difficulty for the header's algo, and the equivalent time of the chain
+ * work as used e.g. for the stale-tip checks.
+ */
+static void
+PowDroughtHeaderAcceptance (benchmark::State& state)
+{
+  const auto chainParams = CreateChainParams (CBaseChainParams::MAIN);
+  const Consensus::Params& params = chainParams->GetConsensus ();
+
+  std::vector<CBlockIndex> blocks;
+  BuildDroughtChain (blocks, params);
+  const CBlockIndex& tip = blocks.back ();
+  const CBlockIndex& early = blocks[NUM_EARLY_BLOCKS];
+
+  while (state.KeepRunning ())
+    {
+      for (const PowAlgo algo : {PowAlgo::SHA256D, PowAlgo::NEOSCRYPT})
+        GetNextWorkRequired (algo, &tip, params);
+      GetBlockProofEquivalentTime (tip, early, tip, params);
+    }
+}
+
+BENCHMARK (PowDroughtHeaderAcceptance, 5000);
@@ -122,10 +122,45 @@ CBlockIndex* CBlockIndex::GetAncestor(int height)
     return const_cast<CBlockIndex*>(static_cast<const CBlockIndex*>(this)->GetAncestor(height));
 }
 
+namespace
+{
+
+/**
+ * Returns the index into CBlockIndex::pprevWithAlgo for the given algo,
+ * or -1 if the algo is not tracked there.
+ */
+int
+AlgoIndex (const PowAlgo algo)
+{
+  const int res = static_cast<int> (algo) - 1;
+  if (res < 0 || res >= static_cast<int> (CBlockIndex::NUM_POW_ALGOS))
+    return -1;
+  return res;
+}
+
+} // anonymous namespace
+
 const CBlockIndex*
 CBlockIndex::GetLastAncestorWithAlgo (const PowAlgo algo) const
 {
-  for (const CBlockIndex* pindex = this; pindex != nullptr;
+  if (this->algo == algo)
+    return this;
+  return GetPrevWithAlgo (algo);
+}
+
+const CBlockIndex*
+CBlockIndex::GetPrevWithAlgo (const PowAlgo algo) const
+{
+  const int idx = AlgoIndex (algo);
+  if (idx >= 0)
+    {
+      /* The pointers are only valid once BuildSkip has been called, which
+         also sets pskip for every block but the genesis.  */
+      assert (pprev == nullptr || pskip != nullptr);
+      return pprevWithAlgo[idx];
+    }
+
+  for (const CBlockIndex* pindex = pprev; pindex != nullptr;
        pindex = pindex->pprev)
     if (pindex->algo == algo)
       return pindex;
@@ -134,8 +169,14 @@ CBlockIndex::GetLastAncestorWithAlgo (const PowAlgo algo) const
 
 void CBlockIndex::BuildSkip()
 {
-    if (pprev)
+    if (pprev) {
         pskip = pprev->GetAncestor(GetSkipHeight(nHeight));
+
+        pprevWithAlgo = pprev->pprevWithAlgo;
+        const int idx = AlgoIndex(pprev->algo);
+        if (idx >= 0)
+            pprevWithAlgo[idx] = pprev;
+    }
 }
 
 arith_uint256 GetBlockProof(const CBlockIndex& block)
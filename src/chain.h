@@ -15,6 +15,7 @@
 #include <tinyformat.h>
 #include <uint256.h>
 
+#include <array>
 #include <vector>
 
 /**
@@ -150,6 +151,13 @@ public:
     //! pointer to the index of some further predecessor of this block
     CBlockIndex* pskip{nullptr};
 
+    //! number of PoW algos that are tracked in pprevWithAlgo
+    static constexpr size_t NUM_POW_ALGOS = 2;
+
+    //! for each PoW algo (indexed by its ID minus one), pointer to the index
+    //! of the last predecessor of this block mined with that algo
+    std::array<CBlockIndex*, NUM_POW_ALGOS> pprevWithAlgo{};
+
     //! height of the entry in the chain. The genesis block has height 0
     int nHeight{0};
 
@@ -303,7 +311,7 @@ public:
         return false;
     }
 
-    //! Build the skiplist pointer for this entry.
+    //! Build the skiplist and per-algo predecessor pointers for this entry.
     void BuildSkip();
 
     //! Efficiently find an ancestor of this block.
@@ -315,6 +323,14 @@ public:
      * PoW algo.  Returns nullptr if none exists.
      */
     const CBlockIndex* GetLastAncestorWithAlgo(PowAlgo algo) const;
+
+    /**
+     * Find the last previous block (excluding this one) mined by a particular
+     * PoW algo.  Returns nullptr if none exists.  This is constant-time
+     * for the algos tracked in pprevWithAlgo, and requires BuildSkip to
+     * have been called.
+     */
+    const CBlockIndex* GetPrevWithAlgo(PowAlgo algo) const;
 };
 
 arith_uint256 GetBlockProof(const CBlockIndex& block);
@@ -13,8 +13,10 @@ bool CCoinsView::GetCoin(const COutPoint &outpoint, Coin &coin) const { return f
 uint256 CCoinsView::GetBestBlock() const { return uint256(); }
 std::vector<uint256> CCoinsView::GetHeadBlocks() const { return std::vector<uint256>(); }
 bool CCoinsView::GetName(const valtype &name, CNameData &data) const { return false; }
-bool CCoinsView::GetNameHistory(const valtype &name, CNameHistory &data) const { return false; }
+uint32_t CCoinsView::GetNameHistorySize(const valtype &name) const { return 0; }
+bool CCoinsView::GetNameHistoryEntry(const valtype &name, uint32_t index, CNameData &data) const { return false; }
 CNameIterator* CCoinsView::IterateNames() const { assert (false); }
+CNameIterator* CCoinsView::IterateNamesLexicographic() const { assert (false); }
 bool CCoinsView::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, const CNameCache &names) { return false; }
 CCoinsViewCursor *CCoinsView::Cursor() const { return nullptr; }
 bool CCoinsView::ValidateNameDB() const { return false; }
@@ -31,8 +33,10 @@ bool CCoinsViewBacked::HaveCoin(const COutPoint &outpoint) const { return base->
 uint256 CCoinsViewBacked::GetBestBlock() const { return base->GetBestBlock(); }
 std::vector<uint256> CCoinsViewBacked::GetHeadBlocks() const { return base->GetHeadBlocks(); }
 bool CCoinsViewBacked::GetName(const valtype &name, CNameData &data) const { return base->GetName(name, data); }
-bool CCoinsViewBacked::GetNameHistory(const valtype &name, CNameHistory &data) const { return base->GetNameHistory(name, data); }
+uint32_t CCoinsViewBacked::GetNameHistorySize(const valtype &name) const { return base->GetNameHistorySize(name); }
+bool CCoinsViewBacked::GetNameHistoryEntry(const valtype &name, uint32_t index, CNameData &data) const { return base->GetNameHistoryEntry(name, index, data); }
 CNameIterator* CCoinsViewBacked::IterateNames() const { return base->IterateNames(); }
+CNameIterator* CCoinsViewBacked::IterateNamesLexicographic() const { return base->IterateNamesLexicographic(); }
 void CCoinsViewBacked::SetBackend(CCoinsView &viewIn) { base = &viewIn; }
 bool CCoinsViewBacked::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, const CNameCache &names) { return base->BatchWrite(mapCoins, hashBlock, names); }
 CCoinsViewCursor *CCoinsViewBacked::Cursor() const { return base->Cursor(); }
@@ -44,7 +48,8 @@ SaltedOutpointHasher::SaltedOutpointHasher() : k0(GetRand(std::numeric_limits<ui
 CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn) : CCoinsViewBacked(baseIn), cachedCoinsUsage(0) {}
 
 size_t CCoinsViewCache::DynamicMemoryUsage() const {
-    return memusage::DynamicUsage(cacheCoins) + cachedCoinsUsage;
+    return memusage::DynamicUsage(cacheCoins) + cachedCoinsUsage
+            + cacheNames.DynamicMemoryUsage();
 }
 
 CCoinsMap::iterator CCoinsViewCache::FetchCoin(const COutPoint &outpoint) const {
@@ -164,20 +169,45 @@ bool CCoinsViewCache::GetName(const valtype &name, CNameData& data) const {
     return base->GetName(name, data);
 }
 
-bool CCoinsViewCache::GetNameHistory(const valtype &name, CNameHistory& data) const {
-    if (cacheNames.getHistory(name, data))
-        return true;
+uint32_t CCoinsViewCache::GetNameHistorySize(const valtype &name) const {
+    const CNameCache::HistoryChange* change = cacheNames.getHistory(name);
+    if (change != nullptr)
+        return change->size;
 
     /* Note: This does not attempt to cache backend queries.  The cache
        only keeps track of changes!  */
 
-    return base->GetNameHistory(name, data);
+    return base->GetNameHistorySize(name);
+}
+
+bool CCoinsViewCache::GetNameHistoryEntry(const valtype &name, uint32_t index, CNameData& data) const {
+    const CNameCache::HistoryChange* change = cacheNames.getHistory(name);
+    if (change != nullptr)
+    {
+        if (index >= change->size)
+            return false;
+
+        /* Entries below the size that were not pushed in the cache
+           are unchanged from the base view.  */
+        const CNameData* entry = change->getEntry(index);
+        if (entry != nullptr)
+        {
+            data = *entry;
+            return true;
+        }
+    }
+
+    return base->GetNameHistoryEntry(name, index, data);
 }
 
 CNameIterator* CCoinsViewCache::IterateNames() const {
     return cacheNames.iterateNames(base->IterateNames());
 }
 
+CNameIterator* CCoinsViewCache::IterateNamesLexicographic() const {
+    return cacheNames.iterateNamesLexicographic(base->IterateNamesLexicographic());
+}
+
 /* undo is set if the change is due to disconnecting blocks / going back in
    time.  The ordinary case (!undo) means that we update the name normally,
    going forward in time.  This is important for keeping track of the
@@ -194,20 +224,21 @@ void CCoinsViewCache::SetName(const valtype &name, const CNameData& data, bool u
            for the name history.  */
         if (fNameHistory)
         {
-            CNameHistory history;
-            if (!GetNameHistory(name, history))
+            const uint32_t size = GetNameHistorySize(name);
+            if (undo)
             {
-                /* Ensure that the history stack is indeed (still) empty
-                   and was not modified by the failing GetNameHistory call.  */
-                assert(history.empty());
+                CNameData top;
+                assert(size > 0 && GetNameHistoryEntry(name, size - 1, top));
+                assert(top == data);
+                cacheNames.popHistory(name, size);
+            } else
+            {
+                /* The history stack is ordered by height.  */
+                CNameData top;
+                assert(size == 0 || (GetNameHistoryEntry(name, size - 1, top)
+                                     && top.getHeight() <= oldData.getHeight()));
+                cacheNames.pushHistory(name, size, oldData);
             }
-
-            if (undo)
-                history.pop(data);
-            else
-                history.push(oldData);
-
-            cacheNames.setHistory(name, history);
         }
     } else
         assert (!undo);
@@ -222,8 +253,7 @@ void CCoinsViewCache::DeleteName(const valtype &name) {
     if (fNameHistory)
     {
         /* When deleting a name, the history should already be clean.  */
-        CNameHistory history;
-        assert (!GetNameHistory(name, history) || history.empty());
+        assert (GetNameHistorySize(name) == 0);
     }
 
     cacheNames.remove(name);
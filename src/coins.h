@@ -176,12 +176,18 @@ public:
     // Get a name (if it exists)
     virtual bool GetName(const valtype& name, CNameData& data) const;
 
-    // Get a name's history (if it exists)
-    virtual bool GetNameHistory(const valtype& name, CNameHistory& data) const;
+    // Get the number of entries in a name's history stack
+    virtual uint32_t GetNameHistorySize(const valtype& name) const;
+
+    // Get an entry of a name's history stack (0 is the oldest)
+    virtual bool GetNameHistoryEntry(const valtype& name, uint32_t index, CNameData& data) const;
 
     // Get a name iterator.
     virtual CNameIterator* IterateNames() const;
 
+    // Get a name iterator in lexicographic order (requires -namescanindex).
+    virtual CNameIterator* IterateNamesLexicographic() const;
+
     //! Do a bulk modification (multiple Coin changes + BestBlock change).
     //! The passed mapCoins can be modified.
     virtual bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, const CNameCache &names);
@@ -213,8 +219,10 @@ public:
     uint256 GetBestBlock() const override;
     std::vector<uint256> GetHeadBlocks() const override;
     bool GetName(const valtype& name, CNameData& data) const override;
-    bool GetNameHistory(const valtype& name, CNameHistory& data) const override;
+    uint32_t GetNameHistorySize(const valtype& name) const override;
+    bool GetNameHistoryEntry(const valtype& name, uint32_t index, CNameData& data) const override;
     CNameIterator* IterateNames() const override;
+    CNameIterator* IterateNamesLexicographic() const override;
     void SetBackend(CCoinsView &viewIn);
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, const CNameCache &names) override;
     CCoinsViewCursor *Cursor() const override;
@@ -234,8 +242,8 @@ protected:
     mutable uint256 hashBlock;
     mutable CCoinsMap cacheCoins;
 
-    /* Cached dynamic memory usage for the inner Coin objects. */
-    /* TODO: Sum up also name cache usage.  */
+    /* Cached dynamic memory usage for the inner Coin objects.  The name
+       cache keeps track of its own usage.  */
     mutable size_t cachedCoinsUsage;
 
     /** Name changes cache.  */
@@ -255,8 +263,10 @@ public:
     uint256 GetBestBlock() const override;
     void SetBestBlock(const uint256 &hashBlock);
     bool GetName(const valtype &name, CNameData &data) const override;
-    bool GetNameHistory(const valtype &name, CNameHistory &data) const override;
+    uint32_t GetNameHistorySize(const valtype &name) const override;
+    bool GetNameHistoryEntry(const valtype &name, uint32_t index, CNameData &data) const override;
     CNameIterator* IterateNames() const override;
+    CNameIterator* IterateNamesLexicographic() const override;
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, const CNameCache &names) override;
     CCoinsViewCursor* Cursor() const override {
         throw std::logic_error("CCoinsViewCache cursor iteration not supported.");
@@ -266,6 +276,9 @@ public:
     void SetName(const valtype &name, const CNameData &data, bool undo);
     void DeleteName(const valtype &name);
 
+    /* Access the cached (not yet flushed) name changes.  */
+    const CNameCache& GetNameCache() const { return cacheNames; }
+
     /**
      * Check if we have the given utxo already loaded in this cache.
      * The semantics are the same as HaveCoin(), but no calls to
@@ -157,9 +157,9 @@ int64_t GetTransactionSigOpCost(const CTransaction& tx, const CCoinsViewCache& i
     return nSigOps;
 }
 
-bool Consensus::CheckTxInputs(const CTransaction& tx, CValidationState& state, const CCoinsViewCache& inputs, int nSpendHeight, CAmount& txfee)
+bool Consensus::CheckTxInputs(const CTransaction& tx, CValidationState& state, const CCoinsViewCache& inputs, int nSpendHeight, CAmount& txfee, std::shared_ptr<const ParsedNameValue>* parsedNameValue)
 {
-    if (!CheckNameTransaction (tx, nSpendHeight, inputs, state))
+    if (!CheckNameTransaction (tx, nSpendHeight, inputs, state, parsedNameValue))
       {
         /* Add a generic "invalid for name op" error to the state if none
            was added by CheckNameTransaction already.  */
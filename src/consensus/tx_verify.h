@@ -8,12 +8,14 @@
 #include <amount.h>
 
 #include <stdint.h>
+#include <memory>
 #include <vector>
 
 class CBlockIndex;
 class CCoinsViewCache;
 class CTransaction;
 class CValidationState;
+class ParsedNameValue;
 
 /** Transaction validation functions */
 
@@ -22,9 +24,10 @@ namespace Consensus {
  * Check whether all inputs of this transaction are valid (no double spends and amounts)
  * This does not modify the UTXO set. This does not check scripts and sigs.
  * @param[out] txfee Set to the transaction fee if successful.
+ * @param[out] parsedNameValue If not null, set to the name value parsed by CheckNameTransaction (if any).
  * Preconditions: tx.IsCoinBase() is false.
  */
-bool CheckTxInputs(const CTransaction& tx, CValidationState& state, const CCoinsViewCache& inputs, int nSpendHeight, CAmount& txfee);
+bool CheckTxInputs(const CTransaction& tx, CValidationState& state, const CCoinsViewCache& inputs, int nSpendHeight, CAmount& txfee, std::shared_ptr<const ParsedNameValue>* parsedNameValue = nullptr);
 } // namespace Consensus
 
 /** Auxiliary functions for transaction validation (ideally should not be exposed) */
@@ -166,9 +166,9 @@ void ScriptPubKeyToUniv(const CScript& scriptPubKey,
     std::vector<CTxDestination> addresses;
     int nRequired;
 
-    const CNameScript nameOp(scriptPubKey);
-    if (nameOp.isNameOp ())
-        out.pushKV ("nameOp", NameOpToUniv (nameOp));
+    const CNameScriptView nameOp(scriptPubKey);
+    if (nameOp.isNameOp())
+        out.pushKV ("nameOp", NameOpToUniv (CNameScript(nameOp)));
 
     out.pushKV("asm", ScriptToAsmStr(scriptPubKey));
     if (fIncludeHex)
@@ -13,6 +13,10 @@ void neoscrypt_blake2s(const void *input, const unsigned int input_size,
   const void *key, const unsigned char key_size,
   void *output, const unsigned char output_size);
 
+void neoscrypt_fastkdf(const unsigned char *password, unsigned int password_len,
+  const unsigned char *salt, unsigned int salt_len, unsigned int N,
+  unsigned char *output, unsigned int output_len);
+
 void neoscrypt_copy(void *dstp, const void *srcp, unsigned int len);
 void neoscrypt_erase(void *dstp, unsigned int len);
 void neoscrypt_xor(void *dstp, const void *srcp, unsigned int len);
@@ -0,0 +1,177 @@
+// Copyright (c) 2019 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// 8-way AVX2 implementation of NeoScrypt(128, 2, 1) as used for the
+// Xaya PoW.  Each vector lane holds one 32-bit word of the state of one of
+// 8 independent hashes, so that the ChaCha20 and Salsa20 cores are the
+// scalar code from crypto/neoscrypt.c applied lane-wise.
+
+#ifdef ENABLE_AVX2
+
+#include <stdint.h>
+#include <string.h>
+#include <immintrin.h>
+
+#include <crypto/neoscrypt.h>
+
+#include <vector>
+
+namespace neoscrypt_avx2 {
+namespace {
+
+/** Number of hashes computed in parallel.  */
+constexpr unsigned LANES = 8;
+/** Number of 32-bit words in the state (r = 2).  */
+constexpr unsigned WORDS = 64;
+/** Number of states kept in the scratchpad.  */
+constexpr unsigned N = 128;
+/** Number of ChaCha20 / Salsa20 rounds.  */
+constexpr unsigned ROUNDS = 20;
+
+__m256i inline Add(__m256i x, __m256i y) { return _mm256_add_epi32(x, y); }
+__m256i inline Xor(__m256i x, __m256i y) { return _mm256_xor_si256(x, y); }
+__m256i inline RotL(__m256i x, int n) { return _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - n)); }
+
+/** Salsa20 on one block, like neoscrypt_salsa.  */
+void inline __attribute__((always_inline)) Salsa(__m256i* X)
+{
+    __m256i x0 = X[0], x1 = X[1], x2 = X[2], x3 = X[3];
+    __m256i x4 = X[4], x5 = X[5], x6 = X[6], x7 = X[7];
+    __m256i x8 = X[8], x9 = X[9], x10 = X[10], x11 = X[11];
+    __m256i x12 = X[12], x13 = X[13], x14 = X[14], x15 = X[15];
+
+#define QUARTER(a, b, c, d) \
+    b = Xor(b, RotL(Add(a, d), 7)); \
+    c = Xor(c, RotL(Add(b, a), 9)); \
+    d = Xor(d, RotL(Add(c, b), 13)); \
+    a = Xor(a, RotL(Add(d, c), 18));
+
+    for (unsigned i = 0; i < ROUNDS; i += 2) {
+        QUARTER( x0,  x4,  x8, x12);
+        QUARTER( x5,  x9, x13,  x1);
+        QUARTER(x10, x14,  x2,  x6);
+        QUARTER(x15,  x3,  x7, x11);
+        QUARTER( x0,  x1,  x2,  x3);
+        QUARTER( x5,  x6,  x7,  x4);
+        QUARTER(x10, x11,  x8,  x9);
+        QUARTER(x15, x12, x13, x14);
+    }
+
+#undef QUARTER
+
+    X[0] = Add(X[0], x0); X[1] = Add(X[1], x1); X[2] = Add(X[2], x2); X[3] = Add(X[3], x3);
+    X[4] = Add(X[4], x4); X[5] = Add(X[5], x5); X[6] = Add(X[6], x6); X[7] = Add(X[7], x7);
+    X[8] = Add(X[8], x8); X[9] = Add(X[9], x9); X[10] = Add(X[10], x10); X[11] = Add(X[11], x11);
+    X[12] = Add(X[12], x12); X[13] = Add(X[13], x13); X[14] = Add(X[14], x14); X[15] = Add(X[15], x15);
+}
+
+/** ChaCha20 on one block, like neoscrypt_chacha.  */
+void inline __attribute__((always_inline)) ChaCha(__m256i* X)
+{
+    __m256i x0 = X[0], x1 = X[1], x2 = X[2], x3 = X[3];
+    __m256i x4 = X[4], x5 = X[5], x6 = X[6], x7 = X[7];
+    __m256i x8 = X[8], x9 = X[9], x10 = X[10], x11 = X[11];
+    __m256i x12 = X[12], x13 = X[13], x14 = X[14], x15 = X[15];
+
+#define QUARTER(a, b, c, d) \
+    a = Add(a, b); d = RotL(Xor(d, a), 16); \
+    c = Add(c, d); b = RotL(Xor(b, c), 12); \
+    a = Add(a, b); d = RotL(Xor(d, a), 8); \
+    c = Add(c, d); b = RotL(Xor(b, c), 7);
+
+    for (unsigned i = 0; i < ROUNDS; i += 2) {
+        QUARTER( x0,  x4,  x8, x12);
+        QUARTER( x1,  x5,  x9, x13);
+        QUARTER( x2,  x6, x10, x14);
+        QUARTER( x3,  x7, x11, x15);
+        QUARTER( x0,  x5, x10, x15);
+        QUARTER( x1,  x6, x11, x12);
+        QUARTER( x2,  x7,  x8, x13);
+        QUARTER( x3,  x4,  x9, x14);
+    }
+
+#undef QUARTER
+
+    X[0] = Add(X[0], x0); X[1] = Add(X[1], x1); X[2] = Add(X[2], x2); X[3] = Add(X[3], x3);
+    X[4] = Add(X[4], x4); X[5] = Add(X[5], x5); X[6] = Add(X[6], x6); X[7] = Add(X[7], x7);
+    X[8] = Add(X[8], x8); X[9] = Add(X[9], x9); X[10] = Add(X[10], x10); X[11] = Add(X[11], x11);
+    X[12] = Add(X[12], x12); X[13] = Add(X[13], x13); X[14] = Add(X[14], x14); X[15] = Add(X[15], x15);
+}
+
+/** The NeoScrypt block mixer for r = 2, like neoscrypt_blkmix.  */
+template<bool chacha>
+void BlkMix(__m256i* X)
+{
+    for (unsigned b = 0; b < 4; ++b) {
+        __m256i* blk = X + 16 * b;
+        const __m256i* prev = X + 16 * ((b + 3) % 4);
+        for (unsigned w = 0; w < 16; ++w) blk[w] = Xor(blk[w], prev[w]);
+        if (chacha) ChaCha(blk);
+        else Salsa(blk);
+    }
+    for (unsigned w = 16; w < 32; ++w) {
+        const __m256i t = X[w];
+        X[w] = X[w + 16];
+        X[w + 16] = t;
+    }
+}
+
+/** SMix of the state X, using V as scratchpad of N * WORDS * LANES words.  */
+template<bool chacha>
+void SMix(__m256i* X, uint32_t* V)
+{
+    for (unsigned i = 0; i < N; ++i) {
+        memcpy(V + i * WORDS * LANES, X, WORDS * sizeof(__m256i));
+        BlkMix<chacha>(X);
+    }
+    for (unsigned i = 0; i < N; ++i) {
+        // The integerify result (and thus the scratchpad entry) differs
+        // between the lanes, so gather each lane's words individually.
+        const __m256i lane = _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+        const __m256i entry = _mm256_and_si256(X[48], _mm256_set1_epi32(N - 1));
+        __m256i idx = Add(_mm256_mullo_epi32(entry, _mm256_set1_epi32(WORDS * LANES)), lane);
+        const __m256i step = _mm256_set1_epi32(LANES);
+        for (unsigned w = 0; w < WORDS; ++w) {
+            X[w] = Xor(X[w], _mm256_i32gather_epi32(reinterpret_cast<const int*>(V), idx, 4));
+            idx = Add(idx, step);
+        }
+        BlkMix<chacha>(X);
+    }
+}
+
+} // namespace
+
+void Transform_8way(unsigned char* out, const unsigned char* in)
+{
+    uint32_t kdf[LANES][WORDS];
+    for (unsigned l = 0; l < LANES; ++l) {
+        neoscrypt_fastkdf(in + 80 * l, 80, in + 80 * l, 80, 32, reinterpret_cast<unsigned char*>(kdf[l]), sizeof(kdf[l]));
+    }
+
+    __m256i X[WORDS], Z[WORDS];
+    for (unsigned w = 0; w < WORDS; ++w) {
+        X[w] = _mm256_set_epi32(kdf[7][w], kdf[6][w], kdf[5][w], kdf[4][w], kdf[3][w], kdf[2][w], kdf[1][w], kdf[0][w]);
+        Z[w] = X[w];
+    }
+
+    std::vector<uint32_t> V(N * WORDS * LANES);
+    SMix<true>(Z, V.data());
+    SMix<false>(X, V.data());
+
+    for (unsigned w = 0; w < WORDS; ++w) {
+        uint32_t words[LANES];
+        memcpy(words, X + w, sizeof(words));
+        uint32_t zwords[LANES];
+        memcpy(zwords, Z + w, sizeof(zwords));
+        for (unsigned l = 0; l < LANES; ++l) kdf[l][w] = words[l] ^ zwords[l];
+    }
+
+    for (unsigned l = 0; l < LANES; ++l) {
+        neoscrypt_fastkdf(in + 80 * l, 80, reinterpret_cast<const unsigned char*>(kdf[l]), sizeof(kdf[l]), 32, out + 32 * l, 32);
+    }
+}
+
+}
+
+#endif
@@ -0,0 +1,159 @@
+// Copyright (c) 2019 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <crypto/neoscrypt_multi.h>
+#include <crypto/common.h>
+#include <crypto/neoscrypt.h>
+
+#include <assert.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__amd64__) || defined(__i386__)
+#if defined(USE_ASM)
+#include <cpuid.h>
+#endif
+#endif
+
+namespace neoscrypt_sse2
+{
+void Transform_4way(unsigned char* out, const unsigned char* in);
+}
+
+namespace neoscrypt_avx2
+{
+void Transform_8way(unsigned char* out, const unsigned char* in);
+}
+
+// Internal implementation code.
+namespace
+{
+
+typedef void (*TransformMultiType)(unsigned char*, const unsigned char*);
+
+TransformMultiType Transform_4way = nullptr;
+TransformMultiType Transform_8way = nullptr;
+
+/** Profile used for the Xaya PoW hash, see primitives/pureheader.cpp.  */
+constexpr unsigned int PROFILE = 0;
+
+bool SelfTest()
+{
+    // Some random input data to test with, processed as eight 80-byte blobs.
+    static const unsigned char data[641] = "-" // Intentionally not aligned
+        "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do "
+        "eiusmod tempor incididunt ut labore et dolore magna aliqua. Et m"
+        "olestie ac feugiat sed lectus vestibulum mattis ullamcorper. Mor"
+        "bi blandit cursus risus at ultrices mi tempus imperdiet nulla. N"
+        "unc congue nisi vita suscipit tellus mauris. Imperdiet proin fer"
+        "mentum leo vel orci. Massa tempor nec feugiat nisl pretium fusce"
+        " id velit. Telus in metus vulputate eu scelerisque felis. Mi tem"
+        "pus imperdiet nulla malesuada pellentesque. Tristique magna sit.";
+
+    // The multi-way kernels must match the reference implementation.
+    unsigned char expected[256];
+    for (size_t i = 0; i < 8; ++i) {
+        neoscrypt(data + 1 + 80 * i, expected + 32 * i, PROFILE);
+    }
+
+    if (Transform_4way) {
+        unsigned char out[128];
+        Transform_4way(out, data + 1);
+        if (memcmp(out, expected, sizeof(out)) != 0) return false;
+    }
+
+    if (Transform_8way) {
+        unsigned char out[256];
+        Transform_8way(out, data + 1);
+        if (memcmp(out, expected, sizeof(out)) != 0) return false;
+    }
+
+    return true;
+}
+
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__)) && defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+// We can't use cpuid.h's __get_cpuid as it does not support subleafs.
+void inline cpuid(uint32_t leaf, uint32_t subleaf, uint32_t& a, uint32_t& b, uint32_t& c, uint32_t& d)
+{
+#ifdef __GNUC__
+    __cpuid_count(leaf, subleaf, a, b, c, d);
+#else
+  __asm__ ("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "0"(leaf), "2"(subleaf));
+#endif
+}
+
+/** Check whether the OS has enabled AVX registers. */
+bool AVXEnabled()
+{
+    uint32_t a, d;
+    __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    return (a & 6) == 6;
+}
+#endif
+} // namespace
+
+
+std::string NeoscryptAutoDetect()
+{
+    std::string ret = "standard";
+    Transform_4way = nullptr;
+    Transform_8way = nullptr;
+
+#if defined(__SSE2__)
+    // The SSE2 kernel is only compiled in when the compiler may assume SSE2
+    // anyway (e.g. always on x86_64), so no runtime check is needed.
+    Transform_4way = neoscrypt_sse2::Transform_4way;
+    ret += ",sse2(4way)";
+#endif
+
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__)) && defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+    // The AVX2 kernel is only used if the CPU supports it and the OS has
+    // enabled the AVX registers.
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, 0, eax, ebx, ecx, edx);
+    const bool have_xsave = (ecx >> 27) & 1;
+    const bool have_avx = (ecx >> 28) & 1;
+    const bool enabled_avx = have_xsave && have_avx && AVXEnabled();
+
+    cpuid(0, 0, eax, ebx, ecx, edx);
+    bool have_avx2 = false;
+    if (eax >= 7) {
+        cpuid(7, 0, eax, ebx, ecx, edx);
+        have_avx2 = (ebx >> 5) & 1;
+    }
+
+    if (have_avx2 && enabled_avx) {
+        Transform_8way = neoscrypt_avx2::Transform_8way;
+        ret += ",avx2(8way)";
+    }
+#endif
+
+    assert(SelfTest());
+    return ret;
+}
+
+void NeoscryptMulti(unsigned char* out, const unsigned char* in, size_t count)
+{
+    if (Transform_8way) {
+        while (count >= 8) {
+            Transform_8way(out, in);
+            out += 256;
+            in += 640;
+            count -= 8;
+        }
+    }
+    if (Transform_4way) {
+        while (count >= 4) {
+            Transform_4way(out, in);
+            out += 128;
+            in += 320;
+            count -= 4;
+        }
+    }
+    while (count > 0) {
+        neoscrypt(in, out, PROFILE);
+        out += 32;
+        in += 80;
+        --count;
+    }
+}
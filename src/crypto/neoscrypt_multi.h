@@ -0,0 +1,25 @@
+// Copyright (c) 2019 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_NEOSCRYPT_MULTI_H
+#define BITCOIN_CRYPTO_NEOSCRYPT_MULTI_H
+
+#include <stdlib.h>
+#include <string>
+
+/** Autodetect the best available multi-way neoscrypt implementation.
+ *  Returns the name of the implementation.
+ */
+std::string NeoscryptAutoDetect();
+
+/** Compute the neoscrypt (profile 0) hashes of multiple 80-byte blobs.
+ *  The result is the same as calling neoscrypt() on each of them, but
+ *  several hashes are computed at once where SIMD kernels are available.
+ *  output:  pointer to a count*32 byte output buffer
+ *  input:   pointer to a count*80 byte input buffer
+ *  count:   the number of hashes to compute.
+ */
+void NeoscryptMulti(unsigned char* output, const unsigned char* input, size_t count);
+
+#endif // BITCOIN_CRYPTO_NEOSCRYPT_MULTI_H
@@ -233,6 +233,19 @@ bool CDBWrapper::IsEmpty()
     return !(it->Valid());
 }
 
+CDBSnapshot::CDBSnapshot(const CDBWrapper &_parent)
+    : parent(_parent), psnapshot(parent.pdb->GetSnapshot()),
+      readoptions(parent.readoptions), iteroptions(parent.iteroptions)
+{
+    readoptions.snapshot = psnapshot;
+    iteroptions.snapshot = psnapshot;
+}
+
+CDBSnapshot::~CDBSnapshot()
+{
+    parent.pdb->ReleaseSnapshot(psnapshot);
+}
+
 CDBIterator::~CDBIterator() { delete piter; }
 bool CDBIterator::Valid() const { return piter->Valid(); }
 void CDBIterator::SeekToFirst() { piter->SeekToFirst(); }
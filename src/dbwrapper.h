@@ -175,6 +175,7 @@ public:
 class CDBWrapper
 {
     friend const std::vector<unsigned char>& dbwrapper_private::GetObfuscateKey(const CDBWrapper &w);
+    friend class CDBSnapshot;
 private:
     //! custom environment this database is using (may be nullptr in case of default environment)
     leveldb::Env* penv;
@@ -211,23 +212,8 @@ private:
 
     std::vector<unsigned char> CreateObfuscateKey() const;
 
-public:
-    /**
-     * @param[in] path        Location in the filesystem where leveldb data will be stored.
-     * @param[in] nCacheSize  Configures various leveldb cache settings.
-     * @param[in] fMemory     If true, use leveldb's memory environment.
-     * @param[in] fWipe       If true, remove all existing data.
-     * @param[in] obfuscate   If true, store data obfuscated via simple XOR. If false, XOR
-     *                        with a zero'd byte array.
-     */
-    CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false);
-    ~CDBWrapper();
-
-    CDBWrapper(const CDBWrapper&) = delete;
-    CDBWrapper& operator=(const CDBWrapper&) = delete;
-
     template <typename K, typename V>
-    bool Read(const K& key, V& value) const
+    bool ReadWithOptions(const leveldb::ReadOptions& opts, const K& key, V& value) const
     {
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
@@ -235,7 +221,7 @@ public:
         leveldb::Slice slKey(ssKey.data(), ssKey.size());
 
         std::string strValue;
-        leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
+        leveldb::Status status = pdb->Get(opts, slKey, &strValue);
         if (!status.ok()) {
             if (status.IsNotFound())
                 return false;
@@ -252,6 +238,27 @@ public:
         return true;
     }
 
+public:
+    /**
+     * @param[in] path        Location in the filesystem where leveldb data will be stored.
+     * @param[in] nCacheSize  Configures various leveldb cache settings.
+     * @param[in] fMemory     If true, use leveldb's memory environment.
+     * @param[in] fWipe       If true, remove all existing data.
+     * @param[in] obfuscate   If true, store data obfuscated via simple XOR. If false, XOR
+     *                        with a zero'd byte array.
+     */
+    CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false);
+    ~CDBWrapper();
+
+    CDBWrapper(const CDBWrapper&) = delete;
+    CDBWrapper& operator=(const CDBWrapper&) = delete;
+
+    template <typename K, typename V>
+    bool Read(const K& key, V& value) const
+    {
+        return ReadWithOptions(readoptions, key, value);
+    }
+
     template <typename K, typename V>
     bool Write(const K& key, const V& value, bool fSync = false)
     {
@@ -348,4 +355,40 @@ public:
 
 };
 
+/**
+ * A consistent, read-only view of a CDBWrapper as it was when the snapshot
+ * was taken.  Later writes to the database are not visible through it.
+ * The snapshot must not outlive the database it was taken from.
+ */
+class CDBSnapshot
+{
+private:
+    const CDBWrapper &parent;
+    const leveldb::Snapshot *psnapshot;
+
+    //! options used when reading from the snapshot
+    leveldb::ReadOptions readoptions;
+
+    //! options used when iterating over values of the snapshot
+    leveldb::ReadOptions iteroptions;
+
+public:
+    explicit CDBSnapshot(const CDBWrapper &_parent);
+    ~CDBSnapshot();
+
+    CDBSnapshot(const CDBSnapshot&) = delete;
+    CDBSnapshot& operator=(const CDBSnapshot&) = delete;
+
+    template <typename K, typename V>
+    bool Read(const K& key, V& value) const
+    {
+        return parent.ReadWithOptions(readoptions, key, value);
+    }
+
+    CDBIterator *NewIterator() const
+    {
+        return new CDBIterator(parent, parent.pdb->NewIterator(iteroptions));
+    }
+};
+
 #endif // BITCOIN_DBWRAPPER_H
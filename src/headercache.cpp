@@ -0,0 +1,103 @@
+// Copyright (c) 2019 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <headercache.h>
+
+#include <clientversion.h>
+#include <memusage.h>
+#include <streams.h>
+#include <util/system.h>
+
+#include <algorithm>
+
+BlockHeaderCache g_header_cache(DEFAULT_HEADER_CACHE << 20);
+
+size_t BlockHeaderCache::EntryUsage(const size_t dataSize)
+{
+    using Node = memusage::unordered_node<std::pair<const uint256, Entry>>;
+
+    /* A list node holds the value and two pointers.  */
+    return memusage::MallocUsage(sizeof(Node))
+        + memusage::MallocUsage(3 * sizeof(void*))
+        + memusage::MallocUsage(dataSize);
+}
+
+void BlockHeaderCache::Evict()
+{
+    const size_t limit = maxUsage;
+    while (usage > limit) {
+        assert(!lru.empty());
+        const auto mit = entries.find(*lru.back());
+        assert(mit != entries.end());
+        usage -= EntryUsage(mit->second.data.capacity());
+        lru.pop_back();
+        entries.erase(mit);
+    }
+}
+
+void BlockHeaderCache::SetMaxUsage(const size_t maxUsageIn)
+{
+    maxUsage = maxUsageIn;
+    LOCK(cs);
+    Evict();
+}
+
+bool BlockHeaderCache::Lookup(const uint256& hash, CBlockHeader& header)
+{
+    std::vector<unsigned char> data;
+    {
+        LOCK(cs);
+        const auto mit = entries.find(hash);
+        if (mit == entries.end())
+            return false;
+        lru.splice(lru.begin(), lru, mit->second.pos);
+        data = mit->second.data;
+    }
+
+    /* Deserialise outside of the lock, since it may be slow for auxpow.  */
+    VectorReader reader(SER_DISK, CLIENT_VERSION, data, 0);
+    reader >> header;
+    return true;
+}
+
+void BlockHeaderCache::Insert(const CBlockHeader& header)
+{
+    std::vector<unsigned char> data;
+    CVectorWriter(SER_DISK, CLIENT_VERSION, data, 0, header);
+    data.shrink_to_fit();
+    if (EntryUsage(data.capacity()) > maxUsage)
+        return;
+
+    const uint256 hash = header.GetHash();
+    LOCK(cs);
+    if (entries.count(hash) > 0)
+        return;
+
+    const auto mit = entries.emplace(hash, Entry()).first;
+    usage += EntryUsage(data.capacity());
+    mit->second.data = std::move(data);
+    lru.push_front(&mit->first);
+    mit->second.pos = lru.begin();
+
+    Evict();
+}
+
+size_t BlockHeaderCache::Size() const
+{
+    LOCK(cs);
+    return entries.size();
+}
+
+size_t BlockHeaderCache::DynamicMemoryUsage() const
+{
+    LOCK(cs);
+    return usage;
+}
+
+void InitHeaderCache()
+{
+    const int64_t n = std::max<int64_t>(0, gArgs.GetArg("-headercache", DEFAULT_HEADER_CACHE));
+    g_header_cache.SetMaxUsage(n << 20);
+    LogPrintf("Using up to %d MiB for the block header cache\n", n);
+}
@@ -0,0 +1,93 @@
+// Copyright (c) 2019 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_HEADERCACHE_H
+#define BITCOIN_HEADERCACHE_H
+
+#include <crypto/common.h>
+#include <primitives/block.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <atomic>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+/** Default for -headercache, the memory (in MiB) used for caching block headers. */
+static constexpr int64_t DEFAULT_HEADER_CACHE = 32;
+
+/**
+ * LRU cache of full block headers (including their PowData), keyed by block
+ * hash.  The block index does not keep the PowData in memory, so without it
+ * every header served to peers, over REST or by getblockheader is a random
+ * read from the block files, followed by deserialisation and a PoW check.
+ *
+ * Headers are kept serialised, which is much more compact than CBlockHeader
+ * objects with their auxpow.  Since a block hash always refers to the same
+ * (already validated) header, entries never need to be invalidated.
+ */
+class BlockHeaderCache
+{
+private:
+    struct Hasher {
+        size_t operator()(const uint256& hash) const { return ReadLE64(hash.begin()); }
+    };
+
+    //! LRU list of pointers to the keys in the map (which are stable), most recent first.
+    using LruList = std::list<const uint256*>;
+
+    struct Entry {
+        std::vector<unsigned char> data;
+        LruList::iterator pos;
+    };
+
+    using EntryMap = std::unordered_map<uint256, Entry, Hasher>;
+
+    mutable CCriticalSection cs;
+    EntryMap entries GUARDED_BY(cs);
+    LruList lru GUARDED_BY(cs);
+    size_t usage GUARDED_BY(cs) = 0;
+
+    std::atomic<size_t> maxUsage;
+
+    //! Memory used for an entry with the given serialised size.
+    static size_t EntryUsage(size_t dataSize);
+
+    //! Evicts least-recently used entries until usage is within the limit.
+    void Evict() EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+public:
+    //! Constructs the cache with a memory budget in bytes.  Zero disables it.
+    explicit BlockHeaderCache(size_t maxUsageIn) : maxUsage(maxUsageIn) {}
+
+    BlockHeaderCache(const BlockHeaderCache&) = delete;
+    void operator=(const BlockHeaderCache&) = delete;
+
+    //! Changes the memory budget, evicting entries if needed.
+    void SetMaxUsage(size_t maxUsageIn);
+
+    //! Looks up the header for a block hash.  Returns false if it is not cached.
+    bool Lookup(const uint256& hash, CBlockHeader& header);
+
+    //! Adds a validated header.
+    void Insert(const CBlockHeader& header);
+
+    //! Returns the number of cached headers.
+    size_t Size() const;
+
+    //! Returns the memory used by the cached headers.
+    size_t DynamicMemoryUsage() const;
+};
+
+/** The global cache of block headers. */
+extern BlockHeaderCache g_header_cache;
+
+/**
+ * Initialises the size of the global header cache from -headercache.
+ * To be called once in AppInitMain and the test setup.
+ */
+void InitHeaderCache();
+
+#endif // BITCOIN_HEADERCACHE_H
@@ -0,0 +1,268 @@
+// Copyright (c) 2019 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/gameindex.h>
+
+#include <dbwrapper.h>
+#include <util/system.h>
+#include <validation.h>
+
+#include <set>
+
+/* The index database stores two kinds of records, both keyed by height in the
+ * active chain:
+ *
+ * For each block, a block record of type [DB_BLOCK_HEIGHT, uint32 (BE)] holds
+ * the block hash, the block's RNG seed (which cannot be computed from the
+ * block index alone) and the list of games with data in that block.
+ *
+ * For each game with moves or admin commands in a block, a game record of type
+ * [DB_GAME_HEIGHT, game, uint32 (BE)] holds the block hash and the game's
+ * moves and admin commands.  Since the game ID comes before the height, all
+ * records of a single game are stored sequentially and can be streamed for
+ * a range of heights with a single iterator.
+ *
+ * When blocks are disconnected, their records are deleted again.  The list of
+ * games in the block record allows us to find all game records to delete.
+ */
+constexpr char DB_BLOCK_HEIGHT = 'b';
+constexpr char DB_GAME_HEIGHT = 'g';
+
+std::unique_ptr<GameIndex> g_gameindex;
+
+namespace {
+
+struct DBBlockVal {
+    uint256 hash;
+    uint256 rngseed;
+    std::vector<std::string> games;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(hash);
+        READWRITE(rngseed);
+        READWRITE(games);
+    }
+};
+
+struct DBGameVal {
+    uint256 hash;
+    GameMoveIndex::MoveList moves;
+    GameMoveIndex::AdminCommandList admin;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(hash);
+        READWRITE(moves);
+        READWRITE(admin);
+    }
+};
+
+struct DBBlockKey {
+    int height;
+
+    DBBlockKey() : height(0) {}
+    explicit DBBlockKey(int height_in) : height(height_in) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, DB_BLOCK_HEIGHT);
+        ser_writedata32be(s, height);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        char prefix = ser_readdata8(s);
+        if (prefix != DB_BLOCK_HEIGHT) {
+            throw std::ios_base::failure("Invalid format for game index DB block key");
+        }
+        height = ser_readdata32be(s);
+    }
+};
+
+struct DBGameKey {
+    std::string game;
+    int height;
+
+    DBGameKey() : height(0) {}
+    DBGameKey(const std::string& game_in, int height_in) : game(game_in), height(height_in) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, DB_GAME_HEIGHT);
+        s << game;
+        ser_writedata32be(s, height);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        char prefix = ser_readdata8(s);
+        if (prefix != DB_GAME_HEIGHT) {
+            throw std::ios_base::failure("Invalid format for game index DB game key");
+        }
+        s >> game;
+        height = ser_readdata32be(s);
+    }
+};
+
+}; // namespace
+
+/**
+ * Access to the game index database (indexes/gameindex/)
+ */
+class GameIndex::DB : public BaseIndex::DB
+{
+public:
+    explicit DB(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+};
+
+GameIndex::DB::DB(size_t n_cache_size, bool f_memory, bool f_wipe) :
+    BaseIndex::DB(GetDataDir() / "indexes" / "gameindex", n_cache_size, f_memory, f_wipe)
+{}
+
+GameIndex::GameIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_db(MakeUnique<GameIndex::DB>(n_cache_size, f_memory, f_wipe))
+{}
+
+GameIndex::~GameIndex() {}
+
+bool GameIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    const BlockGameMoves data(block);
+
+    std::set<std::string> games;
+    for (const auto& entry : data.moves.GetAllMoves()) {
+        games.insert(entry.first);
+    }
+    for (const auto& entry : data.moves.GetAllAdminCommands()) {
+        games.insert(entry.first);
+    }
+
+    CDBBatch batch(*m_db);
+
+    DBBlockVal block_val;
+    block_val.hash = data.hash;
+    block_val.rngseed = data.rngseed;
+    block_val.games.assign(games.begin(), games.end());
+    batch.Write(DBBlockKey(pindex->nHeight), block_val);
+
+    for (const auto& game : games) {
+        DBGameVal game_val;
+        game_val.hash = data.hash;
+        game_val.moves = data.moves.GetMoves(game);
+        game_val.admin = data.moves.GetAdminCommands(game);
+        batch.Write(DBGameKey(game, pindex->nHeight), game_val);
+    }
+
+    return m_db->WriteBatch(batch);
+}
+
+bool GameIndex::Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip)
+{
+    assert(current_tip->GetAncestor(new_tip->nHeight) == new_tip);
+
+    // Delete all records of the disconnected blocks.  Otherwise we would keep
+    // stale game records if the replacing block at the same height does not
+    // have data for the same games.
+    CDBBatch batch(*m_db);
+    for (int height = new_tip->nHeight + 1; height <= current_tip->nHeight; ++height) {
+        DBBlockVal block_val;
+        if (!m_db->Read(DBBlockKey(height), block_val)) {
+            return error("%s: unable to read block record in %s at height %d",
+                         __func__, GetName(), height);
+        }
+
+        for (const auto& game : block_val.games) {
+            batch.Erase(DBGameKey(game, height));
+        }
+        batch.Erase(DBBlockKey(height));
+    }
+    if (!m_db->WriteBatch(batch)) return false;
+
+    return BaseIndex::Rewind(current_tip, new_tip);
+}
+
+BaseIndex::DB& GameIndex::GetDB() const { return *m_db; }
+
+bool GameIndex::LookupRange(const std::string& game, int start_height, const CBlockIndex* stop_index,
+                            std::vector<std::shared_ptr<const BlockGameMoves>>& data_out) const
+{
+    // An invalid range is a mistake by the caller (e.g. from RPC arguments)
+    // rather than a problem with the index, so it is not logged as an error.
+    if (start_height < 0 || start_height > stop_index->nHeight) {
+        return false;
+    }
+
+    const size_t results_size = static_cast<size_t>(stop_index->nHeight - start_height + 1);
+    std::unique_ptr<CDBIterator> db_it(m_db->NewIterator());
+
+    // Read all block records.  If any is missing (e.g. because the index is
+    // not yet synced that far), the range is not available.
+    std::vector<DBBlockVal> blocks(results_size);
+    DBBlockKey block_key(start_height);
+    db_it->Seek(block_key);
+    for (int height = start_height; height <= stop_index->nHeight; ++height) {
+        if (!db_it->Valid() || !db_it->GetKey(block_key) || block_key.height != height) {
+            return false;
+        }
+
+        const size_t i = static_cast<size_t>(height - start_height);
+        if (!db_it->GetValue(blocks[i])) {
+            return error("%s: unable to read value in %s at key (%c, %d)",
+                         __func__, GetName(), DB_BLOCK_HEIGHT, height);
+        }
+
+        db_it->Next();
+    }
+
+    // Verify that the indexed blocks are the ones on the requested chain and
+    // prepare the result objects with the header data.
+    std::vector<std::unique_ptr<BlockGameMoves>> results(results_size);
+    for (const CBlockIndex* block_index = stop_index;
+         block_index && block_index->nHeight >= start_height;
+         block_index = block_index->pprev) {
+        const size_t i = static_cast<size_t>(block_index->nHeight - start_height);
+        if (blocks[i].hash != block_index->GetBlockHash()) {
+            return false;
+        }
+        results[i] = MakeUnique<BlockGameMoves>(*block_index, blocks[i].rngseed);
+    }
+
+    // Stream the game records for the range and fill them in.
+    DBGameKey game_key(game, start_height);
+    db_it->Seek(game_key);
+    while (db_it->Valid() && db_it->GetKey(game_key) && game_key.game == game
+           && game_key.height <= stop_index->nHeight) {
+        const size_t i = static_cast<size_t>(game_key.height - start_height);
+
+        DBGameVal game_val;
+        if (!db_it->GetValue(game_val)) {
+            return error("%s: unable to read value in %s at key (%c, %s, %d)",
+                         __func__, GetName(), DB_GAME_HEIGHT, game, game_key.height);
+        }
+        if (game_val.hash != blocks[i].hash) {
+            return error("%s: game record in %s at height %d belongs to unexpected block %s",
+                         __func__, GetName(), game_key.height, game_val.hash.ToString());
+        }
+
+        results[i]->moves.SetGameData(game, std::move(game_val.moves), std::move(game_val.admin));
+        db_it->Next();
+    }
+
+    data_out.clear();
+    data_out.reserve(results_size);
+    for (auto& entry : results) {
+        data_out.push_back(std::move(entry));
+    }
+
+    return true;
+}
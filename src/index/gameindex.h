@@ -0,0 +1,65 @@
+// Copyright (c) 2019 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_GAMEINDEX_H
+#define BITCOIN_INDEX_GAMEINDEX_H
+
+#include <chain.h>
+#include <index/base.h>
+#include <names/gamemoves.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+static const bool DEFAULT_GAMEINDEX = false;
+
+/**
+ * GameIndex stores the moves and admin commands of each game per block
+ * height of the active chain, so that game_sendupdates can replay the
+ * history of a game without reading and parsing full blocks from disk.
+ * Blocks without any data for a game do not need any disk access beyond
+ * the LevelDB lookup at all.
+ */
+class GameIndex final : public BaseIndex
+{
+protected:
+    class DB;
+
+private:
+    const std::unique_ptr<DB> m_db;
+
+protected:
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip) override;
+
+    BaseIndex::DB& GetDB() const override;
+
+    const char* GetName() const override { return "gameindex"; }
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit GameIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    // Destructor is declared because this class contains a unique_ptr to an incomplete type.
+    virtual ~GameIndex() override;
+
+    /// Look up the data of a game for a range of blocks on a chain.
+    ///
+    /// @param[in]   game  The game ID for which to look up data.
+    /// @param[in]   start_height  Height of the first block to return.
+    /// @param[in]   stop_index  The last block to return.  The blocks returned
+    ///                          are the ancestors of this block.
+    /// @param[out]  data_out  The block data, containing only the given game.
+    /// @return  true if all blocks are indexed, false otherwise (including
+    ///          for an invalid range)
+    bool LookupRange(const std::string& game, int start_height, const CBlockIndex* stop_index,
+                     std::vector<std::shared_ptr<const BlockGameMoves>>& data_out) const;
+};
+
+/// The global game index, used by game_sendupdates. May be null.
+extern std::unique_ptr<GameIndex> g_gameindex;
+
+#endif // BITCOIN_INDEX_GAMEINDEX_H
@@ -17,16 +17,22 @@
 #include <chainparams.h>
 #include <compat/sanity.h>
 #include <consensus/validation.h>
+#include <crypto/neoscrypt_multi.h>
 #include <fs.h>
+#include <headercache.h>
 #include <httprpc.h>
 #include <httpserver.h>
 #include <index/blockfilterindex.h>
+#include <index/gameindex.h>
 #include <index/txindex.h>
 #include <interfaces/chain.h>
 #include <key.h>
 #include <miner.h>
 #include <names/encoding.h>
+#include <names/main.h>
 #include <names/mempool.h>
+#include <names/readcache.h>
+#include <names/valuecache.h>
 #include <net.h>
 #include <net_permissions.h>
 #include <net_processing.h>
@@ -170,6 +176,9 @@ void Interrupt()
     if (g_txindex) {
         g_txindex->Interrupt();
     }
+    if (g_gameindex) {
+        g_gameindex->Interrupt();
+    }
     if (g_send_updates_worker != nullptr) {
         g_send_updates_worker->interrupt();
     }
@@ -208,6 +217,7 @@ void Shutdown(InitInterfaces& interfaces)
     if (peerLogic) UnregisterValidationInterface(peerLogic.get());
     if (g_connman) g_connman->Stop();
     if (g_txindex) g_txindex->Stop();
+    if (g_gameindex) g_gameindex->Stop();
     ForEachBlockFilterIndex([](BlockFilterIndex& index) { index.Stop(); });
 
     StopTorControl();
@@ -223,6 +233,7 @@ void Shutdown(InitInterfaces& interfaces)
     g_connman.reset();
     g_banman.reset();
     g_txindex.reset();
+    g_gameindex.reset();
     DestroyAllBlockFilterIndexes();
 
     if (::mempool.IsLoaded() && gArgs.GetArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
@@ -382,6 +393,7 @@ void SetupServerArgs()
     gArgs.AddArg("-dbcache=<n>", strprintf("Maximum database cache size <n> MiB (%d to %d, default: %d). In addition, unused mempool memory is shared for this cache (see -maxmempool).", nMinDbCache, nMaxDbCache, nDefaultDbCache), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-debuglogfile=<file>", strprintf("Specify location of debug log file. Relative paths will be prefixed by a net-specific datadir location. (-nodebuglogfile to disable; default: %s)", DEFAULT_DEBUGLOGFILE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-feefilter", strprintf("Tell other nodes to filter invs to us by our mempool min fee (default: %u)", DEFAULT_FEEFILTER), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-headercache=<n>", strprintf("Maximum memory in MiB used to cache block headers served to peers and RPC (default: %u)", DEFAULT_HEADER_CACHE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-includeconf=<file>", "Specify additional configuration file, relative to the -datadir path (only useable from configuration file, not command line)", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-loadblock=<file>", "Imports blocks from external blk000??.dat file on startup", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-maxmempool=<n>", strprintf("Keep the transaction memory pool below <n> megabytes (default: %u)", DEFAULT_MAX_MEMPOOL_SIZE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
@@ -407,7 +419,11 @@ void SetupServerArgs()
                  strprintf("Maintain an index of compact filters by block (default: %s, values: %s).", DEFAULT_BLOCKFILTERINDEX, ListBlockFilterTypes()) +
                  " If <type> is not supplied or if <type> = 1, indexes for all known types are enabled.",
                  ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-gameindex", strprintf("Maintain an index of game moves per block, used by game_sendupdates (default: %u)", DEFAULT_GAMEINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-namehistory", strprintf("Keep track of the full name history (default: %u)", 0), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-namereadcache=<n>", strprintf("Maximum memory in MiB used to cache name data read from the database (default: %u)", DEFAULT_NAME_READ_CACHE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-namescanindex", strprintf("Maintain a lexicographic index of names, used by name_scan for prefix queries (default: %u)", DEFAULT_NAMESCANINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-namevaluecache=<n>", strprintf("Maximum memory in MiB used to cache parsed name values (default: %u)", DEFAULT_NAME_VALUE_CACHE), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
 
     gArgs.AddArg("-addnode=<ip>", "Add a node to connect to and attempt to keep the connection open (see the `addnode` RPC command help for more info). This option can be specified multiple times to add multiple nodes.", ArgsManager::ALLOW_ANY | ArgsManager::NETWORK_ONLY, OptionsCategory::CONNECTION);
     gArgs.AddArg("-banscore=<n>", strprintf("Threshold for disconnecting misbehaving peers (default: %u)", DEFAULT_BANSCORE_THRESHOLD), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
@@ -471,7 +487,14 @@ void SetupServerArgs()
     gArgs.AddArg("-zmqpubrawblockhwm=<n>", strprintf("Set publish raw block outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubrawtxhwm=<n>", strprintf("Set publish raw transaction outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubgameblocks=<address>", "Enable publication of game data for block attach/detach events in <address>", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubgameblocksfor=<game>=<address>", "Publish game data for block attach/detach events of <game> in <address> instead of the -zmqpubgameblocks address. Can be specified multiple times, also with the same address for a group of games", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubgamepending=<address>", "Enable publication of pending game transactions in <address>", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubgamependingbatch=<ms>,<max>", "Publish pending moves in batches per game, sent when the oldest move is <ms> milliseconds old or when <max> moves are collected (default: disabled)", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqgameblocksbinary", strprintf("Also publish game block notifications in the binary encoding (default: %u)", DEFAULT_ZMQ_GAME_BLOCKS_BINARY), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqgametracksubscriptions", strprintf("Use XPUB sockets for the game notifiers and only build notifications that a connected subscriber is subscribed to (default: %u)", DEFAULT_ZMQ_GAME_TRACK_SUBSCRIPTIONS), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqgamequeue=<n>", strprintf("Maximum number of notifications queued for publishing by the game notifiers, 0 to publish synchronously (default: %d)", DEFAULT_ZMQ_GAME_QUEUE), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqgamequeuepolicy=<policy>", strprintf("What to do if the game notification queue is full: 'block' to wait, 'drop' to skip notifications and leave a gap in the sequence numbers (default: %s)", DEFAULT_ZMQ_GAME_QUEUE_POLICY), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqgamequeuedelay=<ms>", "Wait <ms> milliseconds before publishing each queued game notification (for testing)", ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::ZMQ);
     gArgs.AddArg("-trackgame=<game>", "Enable tracking of the listed game for the Xaya game interface", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
 #else
     hidden_args.emplace_back("-zmqpubhashblock=<address>");
@@ -483,7 +506,14 @@ void SetupServerArgs()
     hidden_args.emplace_back("-zmqpubrawblockhwm=<n>");
     hidden_args.emplace_back("-zmqpubrawtxhwm=<n>");
     hidden_args.emplace_back("-zmqpubgameblocks=<address>");
+    hidden_args.emplace_back("-zmqpubgameblocksfor=<game>=<address>");
     hidden_args.emplace_back("-zmqpubgamepending=<address>");
+    hidden_args.emplace_back("-zmqpubgamependingbatch=<ms>,<max>");
+    hidden_args.emplace_back("-zmqgameblocksbinary");
+    hidden_args.emplace_back("-zmqgametracksubscriptions");
+    hidden_args.emplace_back("-zmqgamequeue=<n>");
+    hidden_args.emplace_back("-zmqgamequeuepolicy=<policy>");
+    hidden_args.emplace_back("-zmqgamequeuedelay=<ms>");
     hidden_args.emplace_back("-trackgame=<game>");
 #endif
 
@@ -497,6 +527,7 @@ void SetupServerArgs()
         "each level includes the checks of the previous levels "
         "(0-4, default: %u)", DEFAULT_CHECKLEVEL), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-checkblockindex", strprintf("Do a consistency check for the block tree, chainstate, and other validation data structures occasionally. (default: %u, regtest: %u)", defaultChainParams->DefaultConsistencyChecks(), regtestChainParams->DefaultConsistencyChecks()), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-checknamedbincremental", strprintf("Check the name database entries of the names touched by each connected or disconnected block (default: %u)", DEFAULT_CHECKNAMEDB_INCREMENTAL), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-checkmempool=<n>", strprintf("Run checks every <n> transactions (default: %u, regtest: %u)", defaultChainParams->DefaultConsistencyChecks(), regtestChainParams->DefaultConsistencyChecks()), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-checkpoints", strprintf("Disable expensive verification for known chain history (default: %u)", DEFAULT_CHECKPOINTS_ENABLED), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-deprecatedrpc=<method>", "Allows deprecated RPC method(s) to be used", ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
@@ -517,6 +548,7 @@ void SetupServerArgs()
     gArgs.AddArg("-logtimemicros", strprintf("Add microsecond precision to debug timestamps (default: %u)", DEFAULT_LOGTIMEMICROS), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-mocktime=<n>", "Replace actual time with <n> seconds since epoch (default: 0)", ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-maxsigcachesize=<n>", strprintf("Limit sum of signature cache and script execution cache sizes to <n> MiB (default: %u)", DEFAULT_MAX_SIG_CACHE_SIZE), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-maxpowcachesize=<n>", strprintf("Limit size of the cache of verified header proofs-of-work to <n> MiB (default: %u)", DEFAULT_MAX_POW_CACHE_SIZE), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-maxtipage=<n>", strprintf("Maximum tip age in seconds to consider node in initial block download (default: %u)", DEFAULT_MAX_TIP_AGE), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-printpriority", strprintf("Log transaction fee per kB when mining blocks (default: %u)", DEFAULT_PRINTPRIORITY), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-printtoconsole", "Send trace/debug info to console (default: 1 when no -daemon. To disable logging to file, set -nodebuglogfile)", ArgsManager::ALLOW_ANY, OptionsCategory::DEBUG_TEST);
@@ -560,6 +592,8 @@ void SetupServerArgs()
     gArgs.AddArg("-limitnamechains=<n>", strprintf("Limit pending chains of name operations for name_update to <n> (default: %u)", DEFAULT_NAME_CHAIN_LIMIT), ArgsManager::ALLOW_ANY, OptionsCategory::RPC);
 
     gArgs.AddArg("-maxgameblockattaches=<n>", strprintf("Sets the maximum number of attach steps sent for a single game_sendupdates request (default: %d)", DEFAULT_MAX_GAME_BLOCK_ATTACHES), ArgsManager::ALLOW_ANY, OptionsCategory::RPC);
+    gArgs.AddArg("-sendupdatesreadahead=<n>", strprintf("Sets the maximum number of blocks per game_sendupdates request that are read ahead of the notifications being sent (default: %d)", DEFAULT_SENDUPDATES_READAHEAD), ArgsManager::ALLOW_ANY, OptionsCategory::RPC);
+    gArgs.AddArg("-sendupdatesthreads=<n>", strprintf("Sets the number of threads used to read blocks for game_sendupdates (default: %d)", DEFAULT_SENDUPDATES_THREADS), ArgsManager::ALLOW_ANY, OptionsCategory::RPC);
 
 #if HAVE_DECL_DAEMON
     gArgs.AddArg("-daemon", "Run in the background as a daemon and accept commands", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
@@ -988,6 +1022,8 @@ bool AppInitParameterInteraction()
     if (gArgs.GetArg("-prune", 0)) {
         if (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX))
             return InitError(_("Prune mode is incompatible with -txindex.").translated);
+        if (gArgs.GetBoolArg("-gameindex", DEFAULT_GAMEINDEX))
+            return InitError(_("Prune mode is incompatible with -gameindex.").translated);
         if (!g_enabled_filter_types.empty()) {
             return InitError(_("Prune mode is incompatible with -blockfilterindex.").translated);
         }
@@ -1049,6 +1085,7 @@ bool AppInitParameterInteraction()
     }
     fCheckBlockIndex = gArgs.GetBoolArg("-checkblockindex", chainparams.DefaultConsistencyChecks());
     fCheckpointsEnabled = gArgs.GetBoolArg("-checkpoints", DEFAULT_CHECKPOINTS_ENABLED);
+    fCheckNameDBIncremental = gArgs.GetBoolArg("-checknamedbincremental", DEFAULT_CHECKNAMEDB_INCREMENTAL);
 
     hashAssumeValid = uint256S(gArgs.GetArg("-assumevalid", chainparams.GetConsensus().defaultAssumeValid.GetHex()));
     if (!hashAssumeValid.IsNull())
@@ -1203,6 +1240,8 @@ bool AppInitSanityChecks()
     // Initialize elliptic curve code
     std::string sha256_algo = SHA256AutoDetect();
     LogPrintf("Using the '%s' SHA256 implementation\n", sha256_algo);
+    std::string neoscrypt_algo = NeoscryptAutoDetect();
+    LogPrintf("Using the '%s' neoscrypt implementation\n", neoscrypt_algo);
     RandomInit();
     ECC_Start();
     globalVerifyHandle.reset(new ECCVerifyHandle());
@@ -1279,6 +1318,9 @@ bool AppInitMain(InitInterfaces& interfaces)
 
     InitSignatureCache();
     InitScriptExecutionCache();
+    InitPowCache();
+    InitNameValueCache();
+    InitHeaderCache();
 
     LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
     if (nScriptCheckThreads) {
@@ -1431,6 +1473,32 @@ bool AppInitMain(InitInterfaces& interfaces)
     }
 
 #if ENABLE_ZMQ
+    {
+        ZMQGamePublishQueue::Policy policy;
+        const std::string strPolicy = gArgs.GetArg("-zmqgamequeuepolicy", DEFAULT_ZMQ_GAME_QUEUE_POLICY);
+        if (!ZMQGamePublishQueue::ParsePolicy(strPolicy, policy)) {
+            return InitError(strprintf(_("Invalid -zmqgamequeuepolicy: '%s'").translated, strPolicy));
+        }
+
+        int64_t batchMillis;
+        size_t batchMax;
+        const std::string strBatch = gArgs.GetArg("-zmqpubgamependingbatch", "");
+        if (!strBatch.empty() && !ZMQGamePendingNotifier::ParseBatchOptions(strBatch, batchMillis, batchMax)) {
+            return InitError(strprintf(_("Invalid -zmqpubgamependingbatch: '%s'").translated, strBatch));
+        }
+
+        std::map<std::string, std::string> gameEndpoints;
+        for (const auto& arg : gArgs.GetArgs("-zmqpubgameblocksfor")) {
+            std::string game, address;
+            if (!ZMQGameBlocksNotifier::ParseGameEndpoint(arg, game, address)) {
+                return InitError(strprintf(_("Invalid -zmqpubgameblocksfor: '%s'").translated, arg));
+            }
+            const auto res = gameEndpoints.emplace(game, address);
+            if (!res.second && res.first->second != address) {
+                return InitError(strprintf(_("Multiple -zmqpubgameblocksfor addresses for game '%s'").translated, game));
+            }
+        }
+    }
     g_zmq_notification_interface = CZMQNotificationInterface::Create();
 
     if (g_zmq_notification_interface) {
@@ -1457,6 +1525,8 @@ bool AppInitMain(InitInterfaces& interfaces)
     nTotalCache -= nBlockTreeDBCache;
     int64_t nTxIndexCache = std::min(nTotalCache / 8, gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX) ? nMaxTxIndexCache << 20 : 0);
     nTotalCache -= nTxIndexCache;
+    int64_t nGameIndexCache = std::min(nTotalCache / 8, gArgs.GetBoolArg("-gameindex", DEFAULT_GAMEINDEX) ? nMaxGameIndexCache << 20 : 0);
+    nTotalCache -= nGameIndexCache;
     int64_t filter_index_cache = 0;
     if (!g_enabled_filter_types.empty()) {
         size_t n_indexes = g_enabled_filter_types.size();
@@ -1474,6 +1544,10 @@ bool AppInitMain(InitInterfaces& interfaces)
     if (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX)) {
         LogPrintf("* Using %.1f MiB for transaction index database\n", nTxIndexCache * (1.0 / 1024 / 1024));
     }
+    if (gArgs.GetBoolArg("-gameindex", DEFAULT_GAMEINDEX)) {
+        LogPrintf("* Using %.1f MiB for game index database\n", nGameIndexCache * (1.0 / 1024 / 1024));
+    }
+    LogPrintf("* Using up to %d MiB for name read cache\n", std::max<int64_t>(0, gArgs.GetArg("-namereadcache", DEFAULT_NAME_READ_CACHE)));
     for (BlockFilterType filter_type : g_enabled_filter_types) {
         LogPrintf("* Using %.1f MiB for %s block filter index database\n",
                   filter_index_cache * (1.0 / 1024 / 1024), BlockFilterTypeName(filter_type));
@@ -1534,6 +1608,12 @@ bool AppInitMain(InitInterfaces& interfaces)
                     break;
                 }
 
+                // Check for changed -namescanindex state
+                if (fNameScanIndex != gArgs.GetBoolArg("-namescanindex", DEFAULT_NAMESCANINDEX)) {
+                    strLoadError = _("You need to rebuild the database using -reindex to change -namescanindex").translated;
+                    break;
+                }
+
                 // Check for changed -prune state.  What we are concerned about is a user who has pruned blocks
                 // in the past, but is now trying to run unpruned.
                 if (fHavePruned && !fPruneMode) {
@@ -1566,7 +1646,7 @@ bool AppInitMain(InitInterfaces& interfaces)
 
                 // If necessary, upgrade from older database format.
                 // This is a no-op if we cleared the coinsviewdb with -reindex or -reindex-chainstate
-                if (!::ChainstateActive().CoinsDB().Upgrade()) {
+                if (!::ChainstateActive().CoinsDB().Upgrade() || !::ChainstateActive().CoinsDB().UpgradeNameHistory()) {
                     strLoadError = _("Error upgrading chainstate database").translated;
                     break;
                 }
@@ -1683,6 +1763,11 @@ bool AppInitMain(InitInterfaces& interfaces)
         g_txindex->Start();
     }
 
+    if (gArgs.GetBoolArg("-gameindex", DEFAULT_GAMEINDEX)) {
+        g_gameindex = MakeUnique<GameIndex>(nGameIndexCache, false, fReindex);
+        g_gameindex->Start();
+    }
+
     for (const auto& filter_type : g_enabled_filter_types) {
         InitBlockFilterIndex(filter_type, filter_index_cache, false, fReindex);
         GetBlockFilterIndex(filter_type)->Start();
@@ -1839,7 +1924,9 @@ bool AppInitMain(InitInterfaces& interfaces)
     }
 
     assert (g_send_updates_worker == nullptr);
-    g_send_updates_worker.reset(new SendUpdatesWorker ());
+    g_send_updates_worker.reset(new SendUpdatesWorker (
+        gArgs.GetArg("-sendupdatesthreads", DEFAULT_SENDUPDATES_THREADS),
+        gArgs.GetArg("-sendupdatesreadahead", DEFAULT_SENDUPDATES_READAHEAD)));
 
     // ********************************************************* Step 13: finished
 
@@ -4,9 +4,28 @@
 
 #include <names/common.h>
 
+#include <crypto/siphash.h>
+#include <memusage.h>
+#include <random.h>
 #include <script/names.h>
 
+#include <algorithm>
+#include <limits>
+#include <vector>
+
 bool fNameHistory = false;
+bool fNameScanIndex = false;
+
+SaltedNameHasher::SaltedNameHasher ()
+  : k0(GetRand (std::numeric_limits<uint64_t>::max ())),
+    k1(GetRand (std::numeric_limits<uint64_t>::max ()))
+{}
+
+size_t
+SaltedNameHasher::operator() (const valtype& name) const
+{
+  return CSipHasher (k0, k1).Write (name.data (), name.size ()).Finalize ();
+}
 
 /* ************************************************************************** */
 /* CNameData.  */
@@ -22,6 +41,12 @@ CNameData::fromScript (unsigned h, const COutPoint& out,
   addr = script.getAddress ();
 }
 
+size_t
+CNameData::DynamicMemoryUsage () const
+{
+  return memusage::DynamicUsage (value) + memusage::DynamicUsage (addr);
+}
+
 /* ************************************************************************** */
 /* CNameIterator.  */
 
@@ -52,22 +77,45 @@ private:
   /** "Next" data of the base iterator.  */
   CNameData baseData;
 
-  /** Iterator of the cache's entries.  */
+  /**
+   * Whether names are ordered lexicographically rather than by length
+   * first.  This must match the order of the base iterator.
+   */
+  const bool lexicographic;
+
+  /** Iterator of the cache's entries (for length-first order).  */
   CNameCache::EntryMap::const_iterator cacheIter;
 
+  /**
+   * The cache's entries sorted lexicographically, and the current position
+   * in them.  This is only used for lexicographic order.
+   */
+  std::vector<CNameCache::EntryMap::const_iterator> lexEntries;
+  size_t lexPos;
+
   /* Call the base iterator's next() routine to fill in the internal
      "cache" for the next entry.  This already skips entries that are
      marked as deleted in the cache.  */
   void advanceBaseIterator ();
 
+  /* Access the current entry of the cache and advance it.  These take
+     care of the ordering mode.  */
+  bool cacheHasMore () const;
+  CNameCache::EntryMap::const_iterator cacheCurrent () const;
+  void advanceCache ();
+
+  /* Compare two names according to the ordering mode.  */
+  bool lessThan (const valtype& a, const valtype& b) const;
+
 public:
 
   /**
    * Construct the iterator.  This takes ownership of the base iterator.
    * @param c The cache object to use.
    * @param b The base iterator.
+   * @param lex Whether the base iterator is ordered lexicographically.
    */
-  CCacheNameIterator (const CNameCache& c, CNameIterator* b);
+  CCacheNameIterator (const CNameCache& c, CNameIterator* b, bool lex);
 
   /* Destruct, this deletes also the base iterator.  */
   ~CCacheNameIterator ();
@@ -78,9 +126,23 @@ public:
 
 };
 
-CCacheNameIterator::CCacheNameIterator (const CNameCache& c, CNameIterator* b)
-  : cache(c), base(b)
+CCacheNameIterator::CCacheNameIterator (const CNameCache& c, CNameIterator* b,
+                                        const bool lex)
+  : cache(c), base(b), lexicographic(lex), lexPos(0)
 {
+  if (lexicographic)
+    {
+      lexEntries.reserve (cache.entries.size ());
+      for (auto it = cache.entries.begin (); it != cache.entries.end (); ++it)
+        lexEntries.push_back (it);
+      std::sort (lexEntries.begin (), lexEntries.end (),
+                 [] (const CNameCache::EntryMap::const_iterator& a,
+                     const CNameCache::EntryMap::const_iterator& b)
+                 {
+                   return a->first < b->first;
+                 });
+    }
+
   /* Add a seek-to-start to ensure that everything is consistent.  This call
      may be superfluous if we seek to another position afterwards anyway,
      but it should also not hurt too much.  */
@@ -101,10 +163,58 @@ CCacheNameIterator::advanceBaseIterator ()
   while (baseHasMore && cache.isDeleted (baseName));
 }
 
+bool
+CCacheNameIterator::cacheHasMore () const
+{
+  if (lexicographic)
+    return lexPos < lexEntries.size ();
+  return cacheIter != cache.entries.end ();
+}
+
+CNameCache::EntryMap::const_iterator
+CCacheNameIterator::cacheCurrent () const
+{
+  assert (cacheHasMore ());
+  if (lexicographic)
+    return lexEntries[lexPos];
+  return cacheIter;
+}
+
+void
+CCacheNameIterator::advanceCache ()
+{
+  assert (cacheHasMore ());
+  if (lexicographic)
+    ++lexPos;
+  else
+    ++cacheIter;
+}
+
+bool
+CCacheNameIterator::lessThan (const valtype& a, const valtype& b) const
+{
+  if (lexicographic)
+    return a < b;
+
+  CNameCache::NameComparator cmp;
+  return cmp (a, b);
+}
+
 void
 CCacheNameIterator::seek (const valtype& start)
 {
-  cacheIter = cache.entries.lower_bound (start);
+  if (lexicographic)
+    {
+      const auto mit = std::lower_bound (
+          lexEntries.begin (), lexEntries.end (), start,
+          [] (const CNameCache::EntryMap::const_iterator& e, const valtype& n)
+          {
+            return e->first < n;
+          });
+      lexPos = mit - lexEntries.begin ();
+    }
+  else
+    cacheIter = cache.entries.lower_bound (start);
   base->seek (start);
 
   baseHasMore = true;
@@ -116,21 +226,23 @@ CCacheNameIterator::next (valtype& name, CNameData& data)
 {
   /* Exit early if no more data is available in either the cache
      nor the base iterator.  */
-  if (!baseHasMore && cacheIter == cache.entries.end ())
+  if (!baseHasMore && !cacheHasMore ())
     return false;
 
   /* Determine which source to use for the next.  */
   bool useBase;
   if (!baseHasMore)
     useBase = false;
-  else if (cacheIter == cache.entries.end ())
+  else if (!cacheHasMore ())
     useBase = true;
   else
     {
+      const auto cur = cacheCurrent ();
+
       /* A special case is when both iterators are equal.  In this case,
          we want to use the cached version.  We also have to advance
          the base iterator.  */
-      if (baseName == cacheIter->first)
+      if (baseName == cur->first)
         advanceBaseIterator ();
 
       /* Due to advancing the base iterator above, it may happen that
@@ -139,10 +251,8 @@ CCacheNameIterator::next (valtype& name, CNameData& data)
         useBase = false;
       else
         {
-          assert (baseName != cacheIter->first);
-
-          CNameCache::NameComparator cmp;
-          useBase = cmp (baseName, cacheIter->first);
+          assert (baseName != cur->first);
+          useBase = lessThan (baseName, cur->first);
         }
     }
 
@@ -155,9 +265,10 @@ CCacheNameIterator::next (valtype& name, CNameData& data)
     }
   else
     {
-      name = cacheIter->first;
-      data = cacheIter->second;
-      ++cacheIter;
+      const auto cur = cacheCurrent ();
+      name = cur->first;
+      data = cur->second;
+      advanceCache ();
     }
 
   return true;
@@ -166,6 +277,49 @@ CCacheNameIterator::next (valtype& name, CNameData& data)
 /* ************************************************************************** */
 /* CNameCache.  */
 
+const CNameData*
+CNameCache::HistoryChange::getEntry (const uint32_t index) const
+{
+  assert (entries.size () <= size);
+  const uint32_t first = size - entries.size ();
+  if (index < first || index >= size)
+    return nullptr;
+
+  return &entries[index - first];
+}
+
+size_t
+CNameCache::HistoryChange::DynamicMemoryUsage () const
+{
+  size_t res = memusage::DynamicUsage (entries);
+  for (const auto& e : entries)
+    res += e.DynamicMemoryUsage ();
+
+  return res;
+}
+
+size_t
+CNameCache::entryUsage (const valtype& name, const CNameData& data) const
+{
+  return memusage::IncrementalDynamicUsage (entries)
+          + memusage::DynamicUsage (name) + data.DynamicMemoryUsage ();
+}
+
+size_t
+CNameCache::deletedUsage (const valtype& name) const
+{
+  return memusage::IncrementalDynamicUsage (deleted)
+          + memusage::DynamicUsage (name);
+}
+
+size_t
+CNameCache::historyUsage (const valtype& name,
+                          const HistoryChange& change) const
+{
+  return memusage::IncrementalDynamicUsage (history)
+          + memusage::DynamicUsage (name) + change.DynamicMemoryUsage ();
+}
+
 bool
 CNameCache::get (const valtype& name, CNameData& data) const
 {
@@ -182,13 +336,23 @@ CNameCache::set (const valtype& name, const CNameData& data)
 {
   const std::set<valtype>::iterator di = deleted.find (name);
   if (di != deleted.end ())
-    deleted.erase (di);
+    {
+      cachedUsage -= deletedUsage (*di);
+      deleted.erase (di);
+    }
 
   const EntryMap::iterator ei = entries.find (name);
   if (ei != entries.end ())
-    ei->second = data;
+    {
+      cachedUsage -= ei->second.DynamicMemoryUsage ();
+      ei->second = data;
+      cachedUsage += ei->second.DynamicMemoryUsage ();
+    }
   else
-    entries.insert (std::make_pair (name, data));
+    {
+      const auto inserted = entries.emplace (name, data).first;
+      cachedUsage += entryUsage (inserted->first, inserted->second);
+    }
 }
 
 void
@@ -196,40 +360,103 @@ CNameCache::remove (const valtype& name)
 {
   const EntryMap::iterator ei = entries.find (name);
   if (ei != entries.end ())
-    entries.erase (ei);
+    {
+      cachedUsage -= entryUsage (ei->first, ei->second);
+      entries.erase (ei);
+    }
 
-  deleted.insert (name);
+  const auto inserted = deleted.insert (name);
+  if (inserted.second)
+    cachedUsage += deletedUsage (*inserted.first);
 }
 
 CNameIterator*
 CNameCache::iterateNames (CNameIterator* base) const
 {
-  return new CCacheNameIterator (*this, base);
+  return new CCacheNameIterator (*this, base, false);
 }
 
-bool
-CNameCache::getHistory (const valtype& name, CNameHistory& res) const
+CNameIterator*
+CNameCache::iterateNamesLexicographic (CNameIterator* base) const
+{
+  return new CCacheNameIterator (*this, base, true);
+}
+
+const CNameCache::HistoryChange*
+CNameCache::getHistory (const valtype& name) const
 {
   assert (fNameHistory);
 
-  const std::map<valtype, CNameHistory>::const_iterator i = history.find (name);
-  if (i == history.end ())
-    return false;
+  const auto mit = history.find (name);
+  if (mit == history.end ())
+    return nullptr;
 
-  res = i->second;
-  return true;
+  return &mit->second;
+}
+
+namespace
+{
+
+/**
+ * Looks up or creates the history change entry for a name.  Returns
+ * the map iterator and whether the entry was newly created.
+ */
+std::pair<std::map<valtype, CNameCache::HistoryChange>::iterator, bool>
+GetHistoryChange (std::map<valtype, CNameCache::HistoryChange>& history,
+                  const valtype& name, const uint32_t size)
+{
+  auto mit = history.find (name);
+  if (mit != history.end ())
+    {
+      assert (mit->second.size == size);
+      return std::make_pair (mit, false);
+    }
+
+  CNameCache::HistoryChange change;
+  change.size = size;
+  change.maxSize = size;
+  return history.emplace (name, std::move (change));
 }
 
+} // anonymous namespace
+
 void
-CNameCache::setHistory (const valtype& name, const CNameHistory& data)
+CNameCache::pushHistory (const valtype& name, const uint32_t size,
+                         const CNameData& entry)
 {
   assert (fNameHistory);
 
-  const std::map<valtype, CNameHistory>::iterator ei = history.find (name);
-  if (ei != history.end ())
-    ei->second = data;
-  else
-    history.insert (std::make_pair (name, data));
+  const auto res = GetHistoryChange (history, name, size);
+  auto& change = res.first->second;
+  if (res.second)
+    cachedUsage += historyUsage (res.first->first, change);
+
+  cachedUsage -= memusage::DynamicUsage (change.entries);
+  change.entries.push_back (entry);
+  cachedUsage += memusage::DynamicUsage (change.entries);
+  cachedUsage += entry.DynamicMemoryUsage ();
+
+  ++change.size;
+  change.maxSize = std::max (change.maxSize, change.size);
+}
+
+void
+CNameCache::popHistory (const valtype& name, const uint32_t size)
+{
+  assert (fNameHistory);
+
+  const auto res = GetHistoryChange (history, name, size);
+  auto& change = res.first->second;
+  if (res.second)
+    cachedUsage += historyUsage (res.first->first, change);
+
+  assert (change.size > 0);
+  --change.size;
+  if (!change.entries.empty ())
+    {
+      cachedUsage -= change.entries.back ().DynamicMemoryUsage ();
+      change.entries.pop_back ();
+    }
 }
 
 void
@@ -243,7 +470,38 @@ CNameCache::apply (const CNameCache& cache)
        i != cache.deleted.end (); ++i)
     remove (*i);
 
-  for (std::map<valtype, CNameHistory>::const_iterator i
-        = cache.history.begin (); i != cache.history.end (); ++i)
-    setHistory (i->first, i->second);
+  /* The other cache's changes are based on our state.  Entries it pushed
+     are the top of the stack; of our own entries, only those below
+     its pushed ones are still valid.  */
+  for (const auto& h : cache.history)
+    {
+      const HistoryChange& other = h.second;
+      const auto mit = history.find (h.first);
+      if (mit == history.end ())
+        {
+          const auto inserted = history.emplace (h.first, other).first;
+          cachedUsage += historyUsage (inserted->first, inserted->second);
+          continue;
+        }
+
+      auto& change = mit->second;
+      cachedUsage -= change.DynamicMemoryUsage ();
+
+      const uint32_t ourFirst = change.size - change.entries.size ();
+      const uint32_t otherFirst = other.size - other.entries.size ();
+      const uint32_t keepUntil = std::min (change.size, otherFirst);
+      if (keepUntil > ourFirst)
+        {
+          change.entries.resize (keepUntil - ourFirst);
+          assert (keepUntil == otherFirst);
+        }
+      else
+        change.entries.clear ();
+      change.entries.insert (change.entries.end (),
+                             other.entries.begin (), other.entries.end ());
+
+      change.size = other.size;
+      change.maxSize = std::max (change.maxSize, other.maxSize);
+      cachedUsage += change.DynamicMemoryUsage ();
+    }
 }
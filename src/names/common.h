@@ -12,6 +12,7 @@
 
 #include <map>
 #include <set>
+#include <vector>
 
 class CNameScript;
 class CDBBatch;
@@ -19,6 +20,35 @@ class CDBBatch;
 /** Whether or not name history is enabled.  */
 extern bool fNameHistory;
 
+/**
+ * Whether or not the lexicographic name index (used for prefix scans)
+ * is enabled.
+ */
+extern bool fNameScanIndex;
+
+/** Default for -namescanindex.  */
+static constexpr bool DEFAULT_NAMESCANINDEX = false;
+
+/**
+ * Salted hasher for names in hash tables, so that peers cannot make us
+ * run into bad hash table behaviour by choosing names.
+ */
+class SaltedNameHasher
+{
+
+private:
+
+  uint64_t k0;
+  uint64_t k1;
+
+public:
+
+  SaltedNameHasher ();
+
+  size_t operator() (const valtype& name) const;
+
+};
+
 /* ************************************************************************** */
 /* CNameData.  */
 
@@ -111,6 +141,11 @@ public:
     return addr;
   }
 
+  /**
+   * Returns the memory used by this object's heap allocations.
+   */
+  size_t DynamicMemoryUsage () const;
+
   /**
    * Set from a name update operation.
    * @param h The height (not available from script).
@@ -121,79 +156,6 @@ public:
 
 };
 
-/* ************************************************************************** */
-/* CNameHistory.  */
-
-/**
- * Keep track of a name's history.  This is a stack of old CNameData
- * objects that have been obsoleted.
- */
-class CNameHistory
-{
-
-private:
-
-  /** The actual data.  */
-  std::vector<CNameData> data;
-
-public:
-
-  ADD_SERIALIZE_METHODS;
-
-  template<typename Stream, typename Operation>
-    inline void SerializationOp (Stream& s, Operation ser_action)
-  {
-    READWRITE (data);
-  }
-
-  /**
-   * Check if the stack is empty.  This is used to decide when to fully
-   * delete an entry in the database.
-   * @return True iff the data stack is empty.
-   */
-  inline bool
-  empty () const
-  {
-    return data.empty ();
-  }
-
-  /**
-   * Access the data in a read-only way.
-   * @return The data stack.
-   */
-  inline const std::vector<CNameData>&
-  getData () const
-  {
-    return data;
-  }
-
-  /**
-   * Push a new entry onto the data stack.  The new entry's height should
-   * be at least as high as the stack top entry's.  If not, fail.
-   * @param entry The new entry to push onto the stack.
-   */
-  inline void
-  push (const CNameData& entry)
-  {
-    assert (data.empty () || data.back ().getHeight () <= entry.getHeight ());
-    data.push_back (entry);
-  }
-
-  /**
-   * Pop the top entry off the stack.  This is used when undoing name
-   * changes.  The name's new value is passed as argument and should
-   * match the removed entry.  If not, fail.
-   * @param entry The name's value after undoing.
-   */
-  inline void
-  pop (const CNameData& entry)
-  {
-    assert (!data.empty () && data.back () == entry);
-    data.pop_back ();
-  }
-
-};
-
 /* ************************************************************************** */
 /* CNameIterator.  */
 
@@ -263,6 +225,48 @@ public:
    */
   typedef std::map<valtype, CNameData, NameComparator> EntryMap;
 
+  /**
+   * Changes to a name's history.  The history is a stack of the name's
+   * previous CNameData entries.  In the database, each entry is stored
+   * in its own record (keyed by its index in the stack), together with
+   * a record holding the stack size.  This allows pushing and popping
+   * in constant time, independent of how long the history is.
+   */
+  struct HistoryChange
+  {
+
+    /** The number of entries after the changes.  */
+    uint32_t size;
+
+    /**
+     * Upper bound for the number of entries the history may have in the
+     * underlying view.  Entries from size up to this have been popped, and
+     * are erased when writing the changes.
+     */
+    uint32_t maxSize;
+
+    /**
+     * Entries pushed by the changes (and not popped again).  Since pushes
+     * and pops always happen at the top, these are always the topmost
+     * entries of the stack, i. e. those with indices from
+     * size - entries.size () up to size.  Entries below are unchanged
+     * from the underlying view.
+     */
+    std::vector<CNameData> entries;
+
+    /**
+     * Returns the entry with the given index if it is one of the pushed
+     * entries, and null otherwise.
+     */
+    const CNameData* getEntry (uint32_t index) const;
+
+    /**
+     * Returns the memory used by the pushed entries.
+     */
+    size_t DynamicMemoryUsage () const;
+
+  };
+
 private:
 
   /** New or updated names.  */
@@ -270,11 +274,23 @@ private:
   /** Deleted names.  */
   std::set<valtype> deleted;
 
+  /** Changes to history stacks.  */
+  std::map<valtype, HistoryChange> history;
+
   /**
-   * New or updated history stacks.  If they are empty, the corresponding
-   * database entry is deleted instead.
+   * Memory used by all the cached changes.  This is kept up-to-date
+   * as changes are made, so that it can be queried cheaply (e. g. when
+   * deciding whether to flush the coins cache).
    */
-  std::map<valtype, CNameHistory> history;
+  size_t cachedUsage = 0;
+
+  /* Memory usage of a single name entry or deleted mark.  */
+  size_t entryUsage (const valtype& name, const CNameData& data) const;
+  size_t deletedUsage (const valtype& name) const;
+
+  /* Memory usage of a history change, including its map node.  */
+  size_t historyUsage (const valtype& name,
+                       const HistoryChange& change) const;
 
   friend class CCacheNameIterator;
 
@@ -286,6 +302,7 @@ public:
     entries.clear ();
     deleted.clear ();
     history.clear ();
+    cachedUsage = 0;
   }
 
   /**
@@ -300,12 +317,36 @@ public:
     if (entries.empty () && deleted.empty ())
       {
         assert (history.empty ());
+        assert (cachedUsage == 0);
         return true;
       }
 
     return false;
   }
 
+  /**
+   * Returns the memory used by the cached changes.  This is what is
+   * accounted towards -dbcache for the name cache.
+   */
+  inline size_t
+  DynamicMemoryUsage () const
+  {
+    return cachedUsage;
+  }
+
+  /* Access the updated and deleted names, e. g. to invalidate them in
+     other caches after they have been written.  */
+  inline const EntryMap&
+  getEntries () const
+  {
+    return entries;
+  }
+  inline const std::set<valtype>&
+  getDeleted () const
+  {
+    return deleted;
+  }
+
   /* See if the given name is marked as deleted.  */
   inline bool
   isDeleted (const valtype& name) const
@@ -329,20 +370,32 @@ public:
      ownership of.  */
   CNameIterator* iterateNames (CNameIterator* base) const;
 
+  /* Same as iterateNames, but for a base iterator that returns names
+     in byte-wise lexicographic order (instead of length first).  */
+  CNameIterator* iterateNamesLexicographic (CNameIterator* base) const;
+
   /**
-   * Query for an history entry.
+   * Query for the changes to a name's history.
    * @param name The name to look up.
-   * @param res Put the resulting history entry here.
-   * @return True iff the name was found in the cache.
+   * @return The changes or null if the history is not changed in the cache.
+   */
+  const HistoryChange* getHistory (const valtype& name) const;
+
+  /**
+   * Push an entry onto a name's history stack.
+   * @param name The name to modify.
+   * @param size The current size of the stack (including the cache).
+   * @param entry The entry to push.
    */
-  bool getHistory (const valtype& name, CNameHistory& res) const;
+  void pushHistory (const valtype& name, uint32_t size,
+                    const CNameData& entry);
 
   /**
-   * Set a name history entry.
+   * Pop the top entry off a name's history stack.
    * @param name The name to modify.
-   * @param data The new history entry.
+   * @param size The current size of the stack (including the cache).
    */
-  void setHistory (const valtype& name, const CNameHistory& data);
+  void popHistory (const valtype& name, uint32_t size);
 
   /* Apply all the changes in the passed-in record on top of this one.  */
   void apply (const CNameCache& cache);
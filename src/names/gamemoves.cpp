@@ -0,0 +1,383 @@
+// Copyright (c) 2018-2019 The Xaya developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <names/gamemoves.h>
+
+#include <chain.h>
+#include <core_io.h>
+#include <key_io.h>
+#include <logging.h>
+#include <names/encoding.h>
+#include <names/valuecache.h>
+#include <optional.h>
+#include <primitives/block.h>
+#include <script/names.h>
+#include <script/standard.h>
+#include <streams.h>
+#include <version.h>
+
+UniValue
+GameMoveTx::ToJson () const
+{
+  UniValue res(UniValue::VOBJ);
+  res.pushKV ("txid", txid.GetHex ());
+  res.pushKV ("name", name);
+
+  UniValue inputs(UniValue::VARR);
+  for (const auto& in : this->inputs)
+    {
+      UniValue cur(UniValue::VOBJ);
+      cur.pushKV ("txid", in.hash.GetHex ());
+      cur.pushKV ("vout", static_cast<int> (in.n));
+      inputs.push_back (cur);
+    }
+  res.pushKV ("inputs", inputs);
+
+  UniValue outputs(UniValue::VOBJ);
+  for (const auto& entry : out)
+    outputs.pushKV (entry.first, ValueFromAmount (entry.second));
+  res.pushKV ("out", outputs);
+
+  return res;
+}
+
+UniValue
+GameMove::ToJson () const
+{
+  UniValue res = tx->ToJson ();
+  res.pushKV ("move", move);
+
+  return res;
+}
+
+UniValue
+GameAdminCommand::ToJson () const
+{
+  UniValue res(UniValue::VOBJ);
+  res.pushKV ("txid", txid.GetHex ());
+  res.pushKV ("cmd", cmd);
+
+  return res;
+}
+
+/* ************************************************************************** */
+
+void
+GameMoveIndex::AddTransaction (const CTransaction& tx,
+                               std::shared_ptr<const ParsedNameValue> parsed)
+{
+  /* Determine if this is a name update at all; if it isn't, then there
+     is nothing to do for this transaction.  */
+  Optional<CNameScriptView> nameOp;
+  for (const auto& out : tx.vout)
+    {
+      const CNameScriptView cur(out.scriptPubKey);
+      if (cur.isNameOp ())
+        {
+          nameOp = cur;
+          break;
+        }
+    }
+  if (!nameOp)
+    return;
+
+  /* Only p/ and g/ names are relevant.  Check this on the raw name before
+     decoding anything, so that we do not spend time on other names.  */
+  const auto rawName = nameOp->getOpName ();
+  if (rawName.size () < 2 || rawName[1] != '/'
+        || (rawName[0] != 'p' && rawName[0] != 'g'))
+    return;
+  const std::string name
+      = EncodeName (valtype (rawName.begin (), rawName.end ()),
+                    NameEncoding::UTF8);
+  const std::string ns = name.substr (0, 2);
+
+  /* Get the parsed value.  Usually it is cached already from when the
+     transaction was validated; otherwise we parse it now.  */
+  const uint256 txid = tx.GetHash ();
+  auto& cache = GetNameValueCache ();
+  if (parsed == nullptr)
+    parsed = cache.Lookup (txid);
+  if (parsed == nullptr)
+    {
+      const auto rawValue = nameOp->getOpValue ();
+      UniValue value;
+      if (!value.read (std::string (rawValue.begin (), rawValue.end ()))
+            || !value.isObject ())
+        {
+          /* This shouldn't actually happen, as the consensus rules check for
+             these conditions for name updates.  But if it does happen, we
+             just ignore it for here.  */
+          LogPrintf ("%s: invalid value ignored\n", __func__);
+          return;
+        }
+
+      parsed = std::make_shared<const ParsedNameValue> (value);
+      cache.Insert (txid, parsed);
+    }
+
+  /* Special case:  Handle admin commands.  */
+  if (ns == "g/")
+    {
+      const std::string game = name.substr (2);
+      for (const auto& c : parsed->cmds)
+        {
+          GameAdminCommand cmd;
+          cmd.txid = txid;
+          cmd.cmd = c;
+          adminCmds[game].push_back (std::move (cmd));
+        }
+
+      return;
+    }
+  assert (ns == "p/");
+
+  /* See if there are actually games mentioned in the update's value.  */
+  if (parsed->moves.empty ())
+    return;
+
+  /* Build up the data that is shared between all games.  */
+  std::shared_ptr<GameMoveTx> txData = std::make_shared<GameMoveTx> ();
+  txData->txid = tx.GetHash ();
+  txData->name = name.substr (2);
+
+  txData->inputs.reserve (tx.vin.size ());
+  for (const auto& in : tx.vin)
+    txData->inputs.push_back (in.prevout);
+
+  for (const auto& out : tx.vout)
+    {
+      if (CNameScript::isNameScript (out.scriptPubKey))
+        continue;
+
+      CTxDestination dest;
+      if (!ExtractDestination (out.scriptPubKey, dest))
+        continue;
+
+      txData->out[EncodeDestination (dest)] += out.nValue;
+    }
+
+  for (const auto& entry : parsed->moves)
+    {
+      GameMove mv;
+      mv.tx = txData;
+      mv.move = entry.second;
+      moves[entry.first].push_back (std::move (mv));
+    }
+}
+
+void
+GameMoveIndex::SetGameData (const std::string& game, MoveList&& mv,
+                            AdminCommandList&& cmds)
+{
+  if (mv.empty ())
+    moves.erase (game);
+  else
+    moves[game] = std::move (mv);
+
+  if (cmds.empty ())
+    adminCmds.erase (game);
+  else
+    adminCmds[game] = std::move (cmds);
+}
+
+const GameMoveIndex::MoveList&
+GameMoveIndex::GetMoves (const std::string& game) const
+{
+  static const MoveList empty;
+
+  const auto mit = moves.find (game);
+  if (mit == moves.end ())
+    return empty;
+
+  return mit->second;
+}
+
+const GameMoveIndex::AdminCommandList&
+GameMoveIndex::GetAdminCommands (const std::string& game) const
+{
+  static const AdminCommandList empty;
+
+  const auto mit = adminCmds.find (game);
+  if (mit == adminCmds.end ())
+    return empty;
+
+  return mit->second;
+}
+
+/* ************************************************************************** */
+
+BlockGameMoves::BlockGameMoves (const CBlock& block)
+  : hash(block.GetHash ()), parent(block.hashPrevBlock),
+    timestamp(block.GetBlockTime ()), rngseed(block.GetRngSeed ())
+{
+  for (const auto& tx : block.vtx)
+    moves.AddTransaction (*tx);
+}
+
+BlockGameMoves::BlockGameMoves (const CBlockIndex& pindex, const uint256& seed)
+  : hash(pindex.GetBlockHash ()),
+    parent(pindex.pprev == nullptr
+              ? uint256 () : pindex.pprev->GetBlockHash ()),
+    timestamp(pindex.GetBlockTime ()), rngseed(seed)
+{}
+
+namespace
+{
+
+/**
+ * Writes a table of entries to the stream.  The table is prefixed by the
+ * number of entries, and each entry by its serialised length.  This allows
+ * readers to skip over entries they are not interested in.
+ */
+template <typename Stream, typename T>
+  void
+  WriteBinaryTable (Stream& s, const std::vector<T>& entries,
+                    std::vector<unsigned char>& scratch)
+{
+  WriteCompactSize (s, entries.size ());
+  for (const auto& e : entries)
+    {
+      scratch.clear ();
+      CVectorWriter (SER_NETWORK, PROTOCOL_VERSION, scratch, 0, e);
+      WriteCompactSize (s, scratch.size ());
+      s.write (reinterpret_cast<const char*> (scratch.data ()),
+               scratch.size ());
+    }
+}
+
+} // anonymous namespace
+
+void
+EncodeGameBlockBinaryHeader (const BlockGameMoves& block, const int height,
+                             const int64_t mediantime,
+                             const std::string& reqtoken,
+                             std::vector<unsigned char>& out)
+{
+  CVectorWriter writer(SER_NETWORK, PROTOCOL_VERSION, out, out.size ());
+
+  writer << GAME_BINARY_VERSION;
+  writer << block.hash << block.parent;
+  writer << static_cast<uint32_t> (height) << block.timestamp << mediantime;
+  writer << block.rngseed;
+  writer << reqtoken;
+}
+
+void
+EncodeGameBlockBinaryGameData (const BlockGameMoves& block,
+                               const std::string& game,
+                               std::vector<unsigned char>& out)
+{
+  CVectorWriter writer(SER_NETWORK, PROTOCOL_VERSION, out, out.size ());
+
+  std::vector<unsigned char> scratch;
+  WriteBinaryTable (writer, block.moves.GetMoves (game), scratch);
+  WriteBinaryTable (writer, block.moves.GetAdminCommands (game), scratch);
+}
+
+void
+EncodeGameBlockBinary (const BlockGameMoves& block, const int height,
+                       const int64_t mediantime, const std::string& game,
+                       const std::string& reqtoken,
+                       std::vector<unsigned char>& out)
+{
+  EncodeGameBlockBinaryHeader (block, height, mediantime, reqtoken, out);
+  EncodeGameBlockBinaryGameData (block, game, out);
+}
+
+std::string
+AssembleGameBlockJson (const std::string& jsonHeader,
+                       const BlockGameMoves& block, const std::string& game,
+                       std::map<const GameMoveTx*, std::string>& txFragments)
+{
+  std::string data = jsonHeader;
+  data += R"(,"moves":[)";
+  bool first = true;
+  for (const auto& mv : block.moves.GetMoves (game))
+    {
+      auto mit = txFragments.find (mv.tx.get ());
+      if (mit == txFragments.end ())
+        {
+          std::string txJson = mv.tx->ToJson ().write ();
+          assert (!txJson.empty () && txJson.back () == '}');
+          txJson.pop_back ();
+          mit = txFragments.emplace (mv.tx.get (),
+                                     std::move (txJson)).first;
+        }
+
+      if (!first)
+        data += ',';
+      first = false;
+      data += mit->second;
+      data += R"(,"move":)";
+      data += mv.move.write ();
+      data += '}';
+    }
+
+  data += R"(],"admin":[)";
+  first = true;
+  for (const auto& cmd : block.moves.GetAdminCommands (game))
+    {
+      if (!first)
+        data += ',';
+      first = false;
+      data += cmd.ToJson ().write ();
+    }
+  data += "]}";
+
+  return data;
+}
+
+/* ************************************************************************** */
+
+std::shared_ptr<const BlockGameMoves>
+BlockGameMovesCache::Lookup (const uint256& hash)
+{
+  LOCK (cs);
+
+  const auto mit = byHash.find (hash);
+  if (mit == byHash.end ())
+    return nullptr;
+
+  entries.splice (entries.begin (), entries, mit->second);
+  return mit->second->second;
+}
+
+std::shared_ptr<const BlockGameMoves>
+BlockGameMovesCache::Get (const CBlock& block)
+{
+  const uint256 hash = block.GetHash ();
+  auto res = Lookup (hash);
+  if (res != nullptr)
+    return res;
+
+  /* Parse the block without holding the lock.  If another thread
+     adds the same block in the meantime, we simply use our version.  */
+  res = std::make_shared<const BlockGameMoves> (block);
+  if (maxBlocks == 0)
+    return res;
+
+  LOCK (cs);
+
+  const auto mit = byHash.find (hash);
+  if (mit != byHash.end ())
+    entries.erase (mit->second);
+  entries.emplace_front (hash, res);
+  byHash[hash] = entries.begin ();
+
+  while (entries.size () > maxBlocks)
+    {
+      byHash.erase (entries.back ().first);
+      entries.pop_back ();
+    }
+
+  return res;
+}
+
+size_t
+BlockGameMovesCache::GetSize () const
+{
+  LOCK (cs);
+  return entries.size ();
+}
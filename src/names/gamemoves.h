@@ -0,0 +1,389 @@
+// Copyright (c) 2018-2019 The Xaya developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef H_BITCOIN_NAMES_GAMEMOVES
+#define H_BITCOIN_NAMES_GAMEMOVES
+
+#include <amount.h>
+#include <primitives/transaction.h>
+#include <serialize.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <univalue.h>
+
+#include <ios>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+class CBlock;
+class CBlockIndex;
+class ParsedNameValue;
+
+/**
+ * Serialises a UniValue as its JSON string.
+ */
+template <typename Stream>
+  void
+  SerializeJson (Stream& s, const UniValue& val)
+{
+  s << val.write ();
+}
+
+/**
+ * Deserialises a UniValue from its JSON string.
+ */
+template <typename Stream>
+  void
+  UnserializeJson (Stream& s, UniValue& val)
+{
+  std::string str;
+  s >> str;
+  if (!val.read (str))
+    throw std::ios_base::failure ("invalid JSON in game data");
+}
+
+/**
+ * Default number of blocks for which the parsed game moves are kept
+ * in a BlockGameMovesCache.
+ */
+static constexpr size_t DEFAULT_GAME_MOVES_CACHE_BLOCKS = 64;
+
+/**
+ * Data about a transaction that contains game moves.  This is the part that
+ * is the same for all games the transaction has moves for, and it is shared
+ * between those moves.
+ */
+struct GameMoveTx
+{
+
+  /** The transaction's txid.  */
+  uint256 txid;
+
+  /** The name that sent the move (without the "p/" prefix).  */
+  std::string name;
+
+  /** The outpoints spent by the transaction.  */
+  std::vector<COutPoint> inputs;
+
+  /** Non-name outputs of the transaction, summed up per address.  */
+  std::map<std::string, CAmount> out;
+
+  /**
+   * Returns the JSON object with the fields of a move's JSON representation
+   * that come from the transaction (i.e. all except the move itself).
+   */
+  UniValue ToJson () const;
+
+  ADD_SERIALIZE_METHODS;
+
+  template<typename Stream, typename Operation>
+    inline void SerializationOp (Stream& s, Operation ser_action)
+  {
+    READWRITE (txid);
+    READWRITE (name);
+    READWRITE (inputs);
+    READWRITE (out);
+  }
+
+};
+
+/**
+ * A single move for some game.
+ */
+struct GameMove
+{
+
+  /** The transaction data shared with moves for other games.  */
+  std::shared_ptr<const GameMoveTx> tx;
+
+  /** The game-specific move data.  */
+  UniValue move;
+
+  /**
+   * Returns the full JSON representation of the move as it is sent in
+   * the game ZMQ notifications.
+   */
+  UniValue ToJson () const;
+
+  /* For serialisation (as used in the game index), the transaction data
+     is written out with each move.  It is not shared again when reading
+     the data back.  */
+
+  template <typename Stream>
+    void
+    Serialize (Stream& s) const
+  {
+    s << *tx;
+    SerializeJson (s, move);
+  }
+
+  template <typename Stream>
+    void
+    Unserialize (Stream& s)
+  {
+    std::shared_ptr<GameMoveTx> txData = std::make_shared<GameMoveTx> ();
+    s >> *txData;
+    tx = std::move (txData);
+    UnserializeJson (s, move);
+  }
+
+};
+
+/**
+ * A single admin command for some game.
+ */
+struct GameAdminCommand
+{
+
+  /** The txid of the transaction that sent the command.  */
+  uint256 txid;
+
+  /** The command's data.  */
+  UniValue cmd;
+
+  /**
+   * Returns the JSON representation of the command as it is sent in
+   * the game ZMQ notifications.
+   */
+  UniValue ToJson () const;
+
+  template <typename Stream>
+    void
+    Serialize (Stream& s) const
+  {
+    s << txid;
+    SerializeJson (s, cmd);
+  }
+
+  template <typename Stream>
+    void
+    Unserialize (Stream& s)
+  {
+    s >> txid;
+    UnserializeJson (s, cmd);
+  }
+
+};
+
+/**
+ * Index of the game moves and admin commands in a list of transactions,
+ * organised per game.  The name values of all transactions added are parsed
+ * exactly once, so that the index can then be used to build notifications
+ * for any number of games.
+ */
+class GameMoveIndex
+{
+
+public:
+
+  using MoveList = std::vector<GameMove>;
+  using AdminCommandList = std::vector<GameAdminCommand>;
+
+private:
+
+  /** Moves per game, in the order of the transactions.  */
+  std::map<std::string, MoveList> moves;
+
+  /** Admin commands per game, in the order of the transactions.  */
+  std::map<std::string, AdminCommandList> adminCmds;
+
+public:
+
+  GameMoveIndex () = default;
+
+  GameMoveIndex (const GameMoveIndex&) = delete;
+  void operator= (const GameMoveIndex&) = delete;
+
+  /**
+   * Analyses the given transaction and adds its moves or admin commands
+   * to the index.  If a transaction has multiple moves for the same game
+   * (e.g. due to duplicate JSON keys), only the last of them is kept.
+   * If the parsed name value of the transaction is already known, it can
+   * be passed in; otherwise it is taken from the name value cache or parsed.
+   */
+  void AddTransaction (const CTransaction& tx,
+                       std::shared_ptr<const ParsedNameValue> parsed = nullptr);
+
+  /**
+   * Sets the moves and admin commands for the given game directly.  This is
+   * used when the data is read from the game index rather than parsed.
+   */
+  void SetGameData (const std::string& game, MoveList&& mv,
+                    AdminCommandList&& cmds);
+
+  /**
+   * Returns all moves indexed, keyed by game ID.
+   */
+  const std::map<std::string, MoveList>&
+  GetAllMoves () const
+  {
+    return moves;
+  }
+
+  /**
+   * Returns all admin commands indexed, keyed by game ID.
+   */
+  const std::map<std::string, AdminCommandList>&
+  GetAllAdminCommands () const
+  {
+    return adminCmds;
+  }
+
+  /**
+   * Returns the moves for the given game.  If there are none, an empty
+   * list is returned.
+   */
+  const MoveList& GetMoves (const std::string& game) const;
+
+  /**
+   * Returns the admin commands for the given game.  If there are none,
+   * an empty list is returned.
+   */
+  const AdminCommandList& GetAdminCommands (const std::string& game) const;
+
+};
+
+/**
+ * The parsed game data of a full block, i.e. the move index of all its
+ * transactions together with the block header data needed for the game
+ * notifications.
+ */
+class BlockGameMoves
+{
+
+public:
+
+  const uint256 hash;
+  const uint256 parent;
+  const int64_t timestamp;
+  const uint256 rngseed;
+
+  /** The moves and admin commands in the block.  */
+  GameMoveIndex moves;
+
+  BlockGameMoves () = delete;
+  BlockGameMoves (const BlockGameMoves&) = delete;
+  void operator= (const BlockGameMoves&) = delete;
+
+  /**
+   * Constructs the data by parsing a full block.
+   */
+  explicit BlockGameMoves (const CBlock& block);
+
+  /**
+   * Constructs an instance with the header data from the given block index
+   * and the given RNG seed, but without any moves yet.  This is used for
+   * data from the game index, which fills in the moves itself.
+   */
+  explicit BlockGameMoves (const CBlockIndex& pindex, const uint256& seed);
+
+};
+
+/**
+ * Version byte at the start of the binary encoding of game notifications.
+ */
+static constexpr uint8_t GAME_BINARY_VERSION = 1;
+
+/**
+ * Appends the compact binary encoding (see doc/xaya/interface.md) of the
+ * block notification for one game to the given buffer.  The data is
+ * serialised straight from the move index without building any JSON
+ * objects; only the move and command values themselves are written
+ * as JSON strings.  Height and median time are not part of BlockGameMoves
+ * and have to be passed in by the caller.
+ */
+void EncodeGameBlockBinary (const BlockGameMoves& block, int height,
+                            int64_t mediantime, const std::string& game,
+                            const std::string& reqtoken,
+                            std::vector<unsigned char>& out);
+
+/**
+ * Appends only the game-independent first part of the binary encoding
+ * (everything up to and including the reqtoken).  This can be used to
+ * encode the header once and then complete it for multiple games
+ * with EncodeGameBlockBinaryGameData.
+ */
+void EncodeGameBlockBinaryHeader (const BlockGameMoves& block, int height,
+                                  int64_t mediantime,
+                                  const std::string& reqtoken,
+                                  std::vector<unsigned char>& out);
+
+/**
+ * Appends the game-specific part (move and admin command tables) of the
+ * binary encoding to the given buffer.
+ */
+void EncodeGameBlockBinaryGameData (const BlockGameMoves& block,
+                                    const std::string& game,
+                                    std::vector<unsigned char>& out);
+
+/**
+ * Assembles the JSON block notification for one game from the pre-rendered
+ * game-independent header, which is a JSON object without its closing brace.
+ * The result is the same as rendering the full UniValue object, but the
+ * transaction parts of moves are rendered only once and cached in
+ * txFragments, so that they are shared between games.
+ */
+std::string AssembleGameBlockJson (
+    const std::string& jsonHeader, const BlockGameMoves& block,
+    const std::string& game,
+    std::map<const GameMoveTx*, std::string>& txFragments);
+
+/**
+ * Bounded cache of BlockGameMoves keyed by block hash.  It is used to share
+ * the parsed data of a block between the attach and detach notifications
+ * as well as game_sendupdates.  Blocks are evicted in least-recently-used
+ * order.  Since the data only depends on the block hash, entries never
+ * have to be invalidated.
+ */
+class BlockGameMovesCache
+{
+
+private:
+
+  using Entry = std::pair<uint256, std::shared_ptr<const BlockGameMoves>>;
+
+  /** Maximum number of blocks to keep.  */
+  const size_t maxBlocks;
+
+  /** The cached entries, most-recently used first.  */
+  std::list<Entry> entries GUARDED_BY (cs);
+
+  /** Lookup map from block hash into the entries list.  */
+  std::map<uint256, std::list<Entry>::iterator> byHash GUARDED_BY (cs);
+
+  mutable CCriticalSection cs;
+
+public:
+
+  explicit BlockGameMovesCache (size_t n = DEFAULT_GAME_MOVES_CACHE_BLOCKS)
+    : maxBlocks(n)
+  {}
+
+  BlockGameMovesCache (const BlockGameMovesCache&) = delete;
+  void operator= (const BlockGameMovesCache&) = delete;
+
+  /**
+   * Looks up the data for the block with the given hash.  Returns null if
+   * it is not cached.
+   */
+  std::shared_ptr<const BlockGameMoves> Lookup (const uint256& hash);
+
+  /**
+   * Returns the data for the given block, parsing it and adding it to
+   * the cache if it is not yet there.
+   */
+  std::shared_ptr<const BlockGameMoves> Get (const CBlock& block);
+
+  /**
+   * Returns the number of currently cached blocks.
+   */
+  size_t GetSize () const;
+
+};
+
+#endif // H_BITCOIN_NAMES_GAMEMOVES
@@ -10,6 +10,7 @@
 #include <dbwrapper.h>
 #include <hash.h>
 #include <names/encoding.h>
+#include <names/valuecache.h>
 #include <script/interpreter.h>
 #include <script/names.h>
 #include <script/script.h>
@@ -23,6 +24,7 @@
 
 #include <univalue.h>
 
+#include <memory>
 #include <string>
 
 namespace
@@ -116,7 +118,8 @@ IsNameValid (const valtype& name, CValidationState& state)
 }
 
 bool
-IsValueValid (const valtype& value, CValidationState& state)
+IsValueValid (const valtype& value, CValidationState& state,
+              UniValue* parsed)
 {
   if (value.size () > MAX_VALUE_LENGTH)
     return state.Invalid (ValidationInvalidReason::CONSENSUS, false,
@@ -134,13 +137,16 @@ IsValueValid (const valtype& value, CValidationState& state)
                           REJECT_INVALID, "tx-value-no-json-object",
                           "The value must be a JSON object");
 
+  if (parsed != nullptr)
+    *parsed = std::move (jsonValue);
   return true;
 }
 
 bool
 CheckNameTransaction (const CTransaction& tx, unsigned nHeight,
                       const CCoinsView& view,
-                      CValidationState& state)
+                      CValidationState& state,
+                      std::shared_ptr<const ParsedNameValue>* parsedValue)
 {
   /* As a first step, try to locate inputs and outputs of the transaction
      that are name scripts.  At most one input and output should be
@@ -158,7 +164,7 @@ CheckNameTransaction (const CTransaction& tx, unsigned nHeight,
                               REJECT_INVALID, "bad-txns-inputs-missingorspent",
                               "Failed to fetch name input coin");
 
-      const CNameScript op(coin.out.scriptPubKey);
+      const CNameScriptView op(coin.out.scriptPubKey);
       if (op.isNameOp ())
         {
           if (nameIn != -1)
@@ -166,7 +172,7 @@ CheckNameTransaction (const CTransaction& tx, unsigned nHeight,
                                   REJECT_INVALID, "tx-multiple-name-inputs",
                                   "Multiple name inputs");
           nameIn = i;
-          nameOpIn = op;
+          nameOpIn = CNameScript (op);
           coinIn = coin;
         }
     }
@@ -175,7 +181,7 @@ CheckNameTransaction (const CTransaction& tx, unsigned nHeight,
   CNameScript nameOpOut;
   for (unsigned i = 0; i < tx.vout.size (); ++i)
     {
-      const CNameScript op(tx.vout[i].scriptPubKey);
+      const CNameScriptView op(tx.vout[i].scriptPubKey);
       if (op.isNameOp ())
         {
           if (nameOut != -1)
@@ -183,7 +189,7 @@ CheckNameTransaction (const CTransaction& tx, unsigned nHeight,
                                   REJECT_INVALID, "tx-multiple-name-outputs",
                                   "Multiple name outputs");
           nameOut = i;
-          nameOpOut = op;
+          nameOpOut = CNameScript (op);
         }
     }
 
@@ -227,10 +233,26 @@ CheckNameTransaction (const CTransaction& tx, unsigned nHeight,
       error ("%s: Name is invalid: %s", __func__, FormatStateMessage (state));
       return false;
     }
-  if (!IsValueValid (nameOpOut.getOpValue (), state))
+
+  /* Parsing the value is expensive, so values of accepted transactions are
+     cached by txid.  When the transaction is checked again later (typically
+     when it is included in a block), only the cheap checks are redone.
+     The cache is only filled by the caller once the transaction has been
+     accepted, so that invalid transactions cannot fill it up.  */
+  const valtype& value = nameOpOut.getOpValue ();
+  auto& valueCache = GetNameValueCache ();
+  const uint256 txid = tx.GetHash ();
+  if (value.size () > MAX_VALUE_LENGTH || valueCache.Lookup (txid) == nullptr)
     {
-      error ("%s: Value is invalid: %s", __func__, FormatStateMessage (state));
-      return false;
+      UniValue jsonValue;
+      if (!IsValueValid (value, state, &jsonValue))
+        {
+          error ("%s: Value is invalid: %s", __func__,
+                 FormatStateMessage (state));
+          return false;
+        }
+      if (parsedValue != nullptr)
+        *parsedValue = std::make_shared<const ParsedNameValue> (jsonValue);
     }
 
   /* Process NAME_UPDATE next.  */
@@ -293,8 +315,12 @@ ApplyNameTransaction (const CTransaction& tx, unsigned nHeight,
 
   for (unsigned i = 0; i < tx.vout.size (); ++i)
     {
-      const CNameScript op(tx.vout[i].scriptPubKey);
-      if (op.isNameOp () && op.isAnyUpdate ())
+      const CNameScriptView parsed(tx.vout[i].scriptPubKey);
+      if (!parsed.isNameOp ())
+        continue;
+
+      const CNameScript op(parsed);
+      if (op.isAnyUpdate ())
         {
           const valtype& name = op.getOpName ();
           LogPrint (BCLog::NAMES, "Updating name at height %d: %s\n",
@@ -311,23 +337,116 @@ ApplyNameTransaction (const CTransaction& tx, unsigned nHeight,
     }
 }
 
+bool
+ValidateNames (const CCoinsView& view, const std::set<valtype>& names)
+{
+  for (const auto& name : names)
+    {
+      CNameData data;
+      const bool exists = view.GetName (name, data);
+
+      if (exists)
+        {
+          Coin coin;
+          if (!view.GetCoin (data.getUpdateOutpoint (), coin))
+            return error ("%s: output of name '%s' is not in the UTXO set",
+                          __func__, EncodeNameForMessage (name));
+
+          const CNameScript nameOp(coin.out.scriptPubKey);
+          if (!nameOp.isNameOp () || !nameOp.isAnyUpdate ()
+                || nameOp.getOpName () != name)
+            return error ("%s: output of name '%s' is not an update of it",
+                          __func__, EncodeNameForMessage (name));
+        }
+
+      if (fNameHistory)
+        {
+          const uint32_t size = view.GetNameHistorySize (name);
+          if (!exists && size > 0)
+            return error ("%s: deleted name '%s' has history",
+                          __func__, EncodeNameForMessage (name));
+
+          CNameData entry;
+          for (uint32_t i = 0; i < size; ++i)
+            if (!view.GetNameHistoryEntry (name, i, entry))
+              return error ("%s: history of name '%s' is missing entry %u",
+                            __func__, EncodeNameForMessage (name), i);
+          if (view.GetNameHistoryEntry (name, size, entry))
+            return error ("%s: history of name '%s' is longer than its size",
+                          __func__, EncodeNameForMessage (name));
+        }
+    }
+
+  return true;
+}
+
+bool fCheckNameDBIncremental = DEFAULT_CHECKNAMEDB_INCREMENTAL;
+
+namespace
+{
+
+/** Names touched by blocks since the last check of the name database.  */
+std::set<valtype> namesToCheck;
+
+} // anonymous namespace
+
+void
+MarkNamesForCheck (const CBlockUndo& undo)
+{
+  AssertLockHeld (cs_main);
+
+  if (!fCheckNameDBIncremental)
+    return;
+
+  for (const auto& op : undo.vnameundo)
+    namesToCheck.insert (op.getName ());
+}
+
+bool
+ValidateMarkedNames (const CCoinsView& view)
+{
+  AssertLockHeld (cs_main);
+
+  if (namesToCheck.empty ())
+    return true;
+
+  const bool res = ValidateNames (view, namesToCheck);
+  namesToCheck.clear ();
+
+  return res;
+}
+
 void
 CheckNameDB (bool disconnect)
 {
+  AssertLockHeld (cs_main);
+
   const int option
     = gArgs.GetArg ("-checknamedb", Params ().DefaultCheckNameDB ());
 
+  bool full;
   if (option == -1)
-    return;
-
-  assert (option >= 0);
-  if (option != 0)
+    full = false;
+  else
     {
-      if (disconnect || ::ChainActive ().Height () % option != 0)
-        return;
+      assert (option >= 0);
+      full = (option == 0
+                || (!disconnect && ::ChainActive ().Height () % option == 0));
     }
 
   auto& coinsTip = ::ChainstateActive ().CoinsTip ();
-  coinsTip.Flush ();
-  assert (coinsTip.ValidateNameDB ());
+  if (full)
+    {
+      coinsTip.Flush ();
+      assert (coinsTip.ValidateNameDB ());
+    }
+  else
+    {
+      /* The names are checked through the cache, so that (unlike for
+         the full check) nothing needs to be flushed.  */
+      const bool ok = ValidateMarkedNames (coinsTip);
+      assert (ok);
+    }
+
+  namesToCheck.clear ();
 }
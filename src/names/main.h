@@ -10,6 +10,7 @@
 #include <primitives/transaction.h>
 #include <serialize.h>
 
+#include <memory>
 #include <set>
 
 class CBlockUndo;
@@ -17,6 +18,8 @@ class CCoinsView;
 class CCoinsViewCache;
 class CTxMemPool;
 class CValidationState;
+class ParsedNameValue;
+class UniValue;
 
 /** The amount of coins to lock in created transactions.  */
 constexpr CAmount NAME_LOCKED_AMOUNT = COIN / 100;
@@ -70,6 +73,15 @@ public:
    */
   void apply (CCoinsViewCache& view) const;
 
+  /**
+   * Returns the name this concerns.
+   */
+  const valtype&
+  getName () const
+  {
+    return name;
+  }
+
 };
 
 /* ************************************************************************** */
@@ -82,9 +94,11 @@ bool IsNameValid (const valtype& name, CValidationState& state);
 
 /**
  * Verifies whether a given value is valid according to the restrictions we
- * have for it.
+ * have for it.  If parsed is not null, it is set to the parsed JSON value
+ * on success.
  */
-bool IsValueValid (const valtype& value, CValidationState& state);
+bool IsValueValid (const valtype& value, CValidationState& state,
+                   UniValue* parsed = nullptr);
 
 /**
  * Check a transaction according to the additional Namecoin rules.  This
@@ -94,11 +108,17 @@ bool IsValueValid (const valtype& value, CValidationState& state);
  * @param nHeight Height at which the tx will be.
  * @param view The current chain state.
  * @param state Resulting validation state.
+ * @param parsedValue If not null, set to the parsed name value if it was
+ *                    parsed (i.e. not found in the name value cache).  The
+ *                    caller should add it to the cache once the transaction
+ *                    has been accepted.
  * @return True in case of success.
  */
 bool CheckNameTransaction (const CTransaction& tx, unsigned nHeight,
                            const CCoinsView& view,
-                           CValidationState& state);
+                           CValidationState& state,
+                           std::shared_ptr<const ParsedNameValue>* parsedValue
+                              = nullptr);
 
 /**
  * Apply the changes of a name transaction to the name database.
@@ -110,10 +130,47 @@ bool CheckNameTransaction (const CTransaction& tx, unsigned nHeight,
 void ApplyNameTransaction (const CTransaction& tx, unsigned nHeight,
                            CCoinsViewCache& view, CBlockUndo& undo);
 
+/**
+ * Check the consistency of only the given names in the chain state.  This
+ * verifies that each name's record matches the unspent output it refers to,
+ * and its history entries.  Unlike ValidateNameDB, it cannot find name
+ * outputs for which there is no name record at all, and it does not check
+ * the scan index (which is only written when the state is flushed).
+ * @param view The chain state to check.
+ * @param names The names to check (e.g. the ones touched by some blocks).
+ * @return True if no inconsistency was found.
+ */
+bool ValidateNames (const CCoinsView& view, const std::set<valtype>& names);
+
+/** Default for -checknamedbincremental.  */
+static constexpr bool DEFAULT_CHECKNAMEDB_INCREMENTAL = false;
+
+/** Whether the names touched by each block are checked (set from
+    -checknamedbincremental).  */
+extern bool fCheckNameDBIncremental;
+
+/**
+ * Record the names touched by a connected or disconnected block (as given
+ * by its name undo data), so that the next CheckNameDB verifies them if
+ * fCheckNameDBIncremental is set.  Requires cs_main.
+ * @param undo The block's undo data.
+ */
+void MarkNamesForCheck (const CBlockUndo& undo);
+
+/**
+ * Check the names recorded by MarkNamesForCheck since the last check
+ * with ValidateNames, and clear the record.  Requires cs_main.
+ * @param view The chain state to check.
+ * @return True if no inconsistency was found.
+ */
+bool ValidateMarkedNames (const CCoinsView& view);
+
 /**
  * Check the name database consistency.  This calls CCoinsView::ValidateNameDB,
- * but only if applicable depending on the -checknamedb setting.  If it fails,
- * this throws an assertion failure.
+ * but only if applicable depending on the -checknamedb setting.  Otherwise,
+ * if -checknamedbincremental is set, it calls ValidateNames for the names
+ * touched by blocks since the last check.  If it fails, this throws an
+ * assertion failure.  Requires cs_main.
  * @param disconnect Whether we are disconnecting blocks.
  */
 void CheckNameDB (bool disconnect);
@@ -12,117 +12,161 @@
 #include <util/strencodings.h>
 #include <validation.h>
 
-/* ************************************************************************** */
-
-unsigned
-CNameMemPool::pendingChainLength (const valtype& name) const
-{
-  unsigned res = 0;
-  if (registersName (name))
-    ++res;
-
-  const auto mit = updates.find (name);
-  if (mit != updates.end ())
-    res += mit->second.size ();
+#include <algorithm>
+#include <map>
+#include <set>
 
-  return res;
-}
+/* ************************************************************************** */
 
 namespace
 {
 
 /**
- * Returns the outpoint matching the name operation in a given mempool tx, if
- * there is any.  The txid must be for an entry in the mempool.
+ * Returns true if the given transaction spends any output of the
+ * transaction with the given txid.  Checking by txid (rather than outpoint)
+ * is enough, as the pending operations of a name are in a chain anyway.
  */
-COutPoint
-getNameOutput (const CTxMemPool& pool, const uint256& txid)
+bool
+SpendsFrom (const CTransaction& tx, const uint256& txid)
+{
+  for (const auto& in : tx.vin)
+    if (in.prevout.hash == txid)
+      return true;
+  return false;
+}
+
+} // anonymous namespace
+
+void
+CNameMemPool::SortChain (PendingOperations& ops) const
 {
   AssertLockHeld (pool.cs);
 
-  const auto mit = pool.mapTx.find (txid);
-  assert (mit != pool.mapTx.end ());
-  const auto& vout = mit->GetTx ().vout;
+  std::vector<const CTransaction*> txs;
+  txs.reserve (ops.size ());
+  for (const auto& op : ops)
+    {
+      const auto mit = pool.mapTx.find (op.outpoint.hash);
+      assert (mit != pool.mapTx.end ());
+      txs.push_back (&mit->GetTx ());
+    }
 
-  for (unsigned i = 0; i != vout.size (); ++i)
+  /* Stable topological sort:  Repeatedly take the first remaining operation
+     that does not spend any other remaining one.  Chains are short, so the
+     quadratic (or worse) cost does not matter.  */
+  PendingOperations sorted;
+  sorted.reserve (ops.size ());
+  std::vector<bool> done(ops.size (), false);
+  while (sorted.size () < ops.size ())
     {
-      const CNameScript nameOp(vout[i].scriptPubKey);
-      if (nameOp.isNameOp ())
-        return COutPoint (txid, i);
+      bool found = false;
+      for (unsigned i = 0; i < ops.size () && !found; ++i)
+        {
+          if (done[i])
+            continue;
+
+          bool hasParent = false;
+          for (unsigned j = 0; j < ops.size () && !hasParent; ++j)
+            if (!done[j] && j != i
+                  && SpendsFrom (*txs[i], ops[j].outpoint.hash))
+              hasParent = true;
+          if (hasParent)
+            continue;
+
+          sorted.push_back (std::move (ops[i]));
+          done[i] = true;
+          found = true;
+        }
+      assert (found);
     }
 
-  return COutPoint ();
+  ops = std::move (sorted);
 }
 
-} // anonymous namespace
-
 COutPoint
 CNameMemPool::lastNameOutput (const valtype& name) const
 {
-  const auto itUpd = updates.find (name);
-  if (itUpd != updates.end ())
-    {
-      /* From all the pending updates, we have to find the last one.  This is
-         the unique outpoint that is not also spent by some other transaction.
-         Thus, we keep track of all the transactions spent as well, and then
-         remove those from the sets of candidates.  Doing so by txid (rather
-         than outpoint) is enough, as those transactions must be in a "chain"
-         anyway.  */
+  const NameState* state = getState (name);
+  if (state == nullptr)
+    return COutPoint ();
 
-      const std::set<uint256>& candidateTxids = itUpd->second;
-      std::set<uint256> spentTxids;
-
-      for (const auto& txid : candidateTxids)
-        {
-          const auto mit = pool.mapTx.find (txid);
-          assert (mit != pool.mapTx.end ());
-          for (const auto& in : mit->GetTx ().vin)
-            spentTxids.insert (in.prevout.hash);
-        }
+  assert (!state->ops.empty ());
+  return state->ops.back ().outpoint;
+}
 
-      COutPoint res;
-      for (const auto& txid : candidateTxids)
-        {
-          if (spentTxids.count (txid) > 0)
-            continue;
+const CNameMemPool::PendingOperations&
+CNameMemPool::getPendingOperations (const valtype& name) const
+{
+  static const PendingOperations empty;
 
-          assert (res.IsNull ());
-          res = getNameOutput (pool, txid);
-        }
+  const NameState* state = getState (name);
+  if (state == nullptr)
+    return empty;
 
-      assert (!res.IsNull ());
-      return res;
-    }
+  return state->ops;
+}
 
-  const auto itReg = mapNameRegs.find (name);
-  if (itReg != mapNameRegs.end ())
-    return getNameOutput (pool, itReg->second);
+std::vector<valtype>
+CNameMemPool::getPendingNames () const
+{
+  std::vector<valtype> res;
+  res.reserve (names.size ());
+  for (const auto& entry : names)
+    res.push_back (entry.first);
 
-  return COutPoint ();
+  return res;
 }
 
 void
 CNameMemPool::addUnchecked (const CTxMemPoolEntry& entry)
 {
   AssertLockHeld (pool.cs);
+
+  if (!entry.isNameRegistration () && !entry.isNameUpdate ())
+    return;
+
   const uint256& txHash = entry.GetTx ().GetHash ();
+  NameState& state = names[entry.getName ()];
 
   if (entry.isNameRegistration ())
     {
-      const valtype& name = entry.getName ();
-      assert (mapNameRegs.count (name) == 0);
-      mapNameRegs.insert (std::make_pair (name, txHash));
+      assert (state.registration.IsNull ());
+      state.registration = txHash;
     }
 
-  if (entry.isNameUpdate ())
+  const auto& vout = entry.GetTx ().vout;
+  for (unsigned i = 0; i < vout.size (); ++i)
     {
-      const valtype& name = entry.getName ();
-      const auto mit = updates.find (name);
+      const CNameScriptView view(vout[i].scriptPubKey);
+      if (!view.isNameOp ())
+        continue;
 
-      if (mit == updates.end ())
-        updates.emplace (name, std::set<uint256> ({txHash}));
-      else
-        mit->second.insert (txHash);
+      const CNameScript nameOp(view);
+      PendingOperation op;
+      op.op = nameOp.getNameOp ();
+      op.outpoint = COutPoint (txHash, i);
+      op.value = nameOp.getOpValue ();
+      op.address = nameOp.getAddress ();
+
+      /* Usually the new operation spends the last pending one (or the
+         confirmed name output if there is none), so that it goes right after
+         the pending operation whose transaction it spends (or first).  But
+         when a block is disconnected, its transactions are added back after
+         mempool transactions that spend them.  In that case, restore the
+         order of the chain from the spending relations.  */
+      auto& ops = state.ops;
+      const CTransaction& tx = entry.GetTx ();
+      auto pos = ops.begin ();
+      for (auto it = ops.begin (); it != ops.end (); ++it)
+        if (SpendsFrom (tx, it->outpoint.hash))
+          pos = it + 1;
+      ops.insert (pos, std::move (op));
+
+      const auto itSpender = pool.mapNextTx.lower_bound (COutPoint (txHash, 0));
+      if (itSpender != pool.mapNextTx.end ()
+            && itSpender->first->hash == txHash)
+        SortChain (ops);
+      break;
     }
 }
 
@@ -131,23 +175,33 @@ CNameMemPool::remove (const CTxMemPoolEntry& entry)
 {
   AssertLockHeld (pool.cs);
 
+  if (!entry.isNameRegistration () && !entry.isNameUpdate ())
+    return;
+
+  const auto itName = names.find (entry.getName ());
+  assert (itName != names.end ());
+  NameState& state = itName->second;
+  const uint256& txHash = entry.GetTx ().GetHash ();
+
   if (entry.isNameRegistration ())
     {
-      const auto mit = mapNameRegs.find (entry.getName ());
-      assert (mit != mapNameRegs.end ());
-      mapNameRegs.erase (mit);
+      assert (state.registration == txHash);
+      state.registration.SetNull ();
     }
 
-  if (entry.isNameUpdate ())
+  auto& ops = state.ops;
+  const auto itOp = std::find_if (ops.begin (), ops.end (),
+                                  [&txHash] (const PendingOperation& op)
+                                  {
+                                    return op.outpoint.hash == txHash;
+                                  });
+  assert (itOp != ops.end ());
+  ops.erase (itOp);
+
+  if (ops.empty ())
     {
-      const auto itName = updates.find (entry.getName ());
-      assert (itName != updates.end ());
-      auto& txids = itName->second;
-      const auto itTxid = txids.find (entry.GetTx ().GetHash ());
-      assert (itTxid != txids.end ());
-      txids.erase (itTxid);
-      if (txids.empty ())
-        updates.erase (itName);
+      assert (state.registration.IsNull ());
+      names.erase (itName);
     }
 }
 
@@ -158,14 +212,17 @@ CNameMemPool::removeConflicts (const CTransaction& tx)
 
   for (const auto& txout : tx.vout)
     {
-      const CNameScript nameOp(txout.scriptPubKey);
-      if (nameOp.isNameOp () && nameOp.getNameOp () == OP_NAME_REGISTER)
+      const CNameScriptView view(txout.scriptPubKey);
+      if (!view.isNameOp ())
+        continue;
+
+      const CNameScript nameOp(view);
+      if (nameOp.getNameOp () == OP_NAME_REGISTER)
         {
-          const valtype& name = nameOp.getOpName ();
-          const auto mit = mapNameRegs.find (name);
-          if (mit != mapNameRegs.end ())
+          const NameState* state = getState (nameOp.getOpName ());
+          if (state != nullptr && !state->registration.IsNull ())
             {
-              const auto mit2 = pool.mapTx.find (mit->second);
+              const auto mit2 = pool.mapTx.find (state->registration);
               assert (mit2 != pool.mapTx.end ());
               pool.removeRecursive (mit2->GetTx (),
                                     MemPoolRemovalReason::NAME_CONFLICT);
@@ -180,46 +237,56 @@ CNameMemPool::check (const CCoinsView& coins) const
   AssertLockHeld (pool.cs);
 
   std::set<valtype> nameRegs;
-  std::map<valtype, unsigned> nameUpdates;
+  std::map<valtype, unsigned> nameOps;
   for (const auto& entry : pool.mapTx)
     {
+      if (!entry.isNameRegistration () && !entry.isNameUpdate ())
+        continue;
+
       const uint256 txHash = entry.GetTx ().GetHash ();
+      const valtype& name = entry.getName ();
+      ++nameOps[name];
+
+      const NameState* state = getState (name);
+      assert (state != nullptr);
+
+      const auto& ops = state->ops;
+      const auto itOp = std::find_if (ops.begin (), ops.end (),
+                                      [&txHash] (const PendingOperation& op)
+                                      {
+                                        return op.outpoint.hash == txHash;
+                                      });
+      assert (itOp != ops.end ());
+
+      const auto& txOut = entry.GetTx ().vout.at (itOp->outpoint.n);
+      const CNameScript nameOp(txOut.scriptPubKey);
+      assert (nameOp.isNameOp () && nameOp.getOpName () == name);
+      assert (nameOp.getNameOp () == itOp->op);
+      assert (nameOp.getOpValue () == itOp->value);
+      assert (nameOp.getAddress () == itOp->address);
+
+      CNameData data;
       if (entry.isNameRegistration ())
         {
-          const valtype& name = entry.getName ();
-
-          const auto mit = mapNameRegs.find (name);
-          assert (mit != mapNameRegs.end ());
-          assert (mit->second == txHash);
+          assert (state->registration == txHash);
 
           assert (nameRegs.count (name) == 0);
           nameRegs.insert (name);
 
           /* There should be no existing name.  */
-          CNameData data;
           assert (!coins.GetName (name, data));
         }
-
-      if (entry.isNameUpdate ())
-        {
-          const valtype& name = entry.getName ();
-
-          const auto mit = updates.find (name);
-          assert (mit != updates.end ());
-          assert (mit->second.count (txHash) > 0);
-
-          ++nameUpdates[name];
-
-          CNameData data;
-          if (!coins.GetName (name, data))
-            assert (registersName (name));
-        }
+      else if (!coins.GetName (name, data))
+        assert (registersName (name));
     }
 
-  assert (nameRegs.size () == mapNameRegs.size ());
-  assert (nameUpdates.size () == updates.size ());
-  for (const auto& upd : nameUpdates)
-    assert (updates.at (upd.first).size () == upd.second);
+  assert (nameOps.size () == names.size ());
+  for (const auto& entry : names)
+    {
+      assert (entry.second.ops.size () == nameOps.at (entry.first));
+      if (!entry.second.registration.IsNull ())
+        assert (nameRegs.count (entry.first) > 0);
+    }
 }
 
 bool
@@ -229,10 +296,11 @@ CNameMemPool::checkTx (const CTransaction& tx) const
 
   for (const auto& txout : tx.vout)
     {
-      const CNameScript nameOp(txout.scriptPubKey);
-      if (!nameOp.isNameOp ())
+      const CNameScriptView view(txout.scriptPubKey);
+      if (!view.isNameOp ())
         continue;
 
+      const CNameScript nameOp(view);
       switch (nameOp.getNameOp ())
         {
         case OP_NAME_REGISTER:
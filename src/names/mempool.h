@@ -7,11 +7,12 @@
 
 #include <names/common.h>
 #include <primitives/transaction.h>
+#include <script/script.h>
 #include <uint256.h>
 
-#include <map>
 #include <memory>
-#include <set>
+#include <unordered_map>
+#include <vector>
 
 class CCoinsView;
 class CTxMemPool;
@@ -36,28 +37,88 @@ static constexpr unsigned DEFAULT_NAME_CHAIN_LIMIT = 20;
 class CNameMemPool
 {
 
+public:
+
+  /**
+   * A name operation that is pending in the mempool, decoded already so that
+   * queries like name_pending do not need to look at the transactions.
+   */
+  struct PendingOperation
+  {
+
+    /** The operation (OP_NAME_REGISTER or OP_NAME_UPDATE).  */
+    opcodetype op;
+
+    /** The name output of the transaction.  */
+    COutPoint outpoint;
+
+    /** The new value of the name.  */
+    valtype value;
+
+    /** The address (script) the name is sent to.  */
+    CScript address;
+
+  };
+
+  /**
+   * The pending operations for a name, in the order of the chain of
+   * name operations (i.e. each one spends the one before it).
+   */
+  using PendingOperations = std::vector<PendingOperation>;
+
 private:
 
+  /**
+   * Everything the name mempool tracks about a single name with
+   * pending operations.
+   */
+  struct NameState
+  {
+
+    /**
+     * The transaction registering the name, or null if there is none.
+     * For any given name, at most one registering transaction is allowed in
+     * the mempool (as all others would conflict with it).
+     */
+    uint256 registration;
+
+    /**
+     * All pending operations (the registration, if any, and the updates),
+     * in the order of the chain.  Its size is the length of the chain and
+     * the last element holds the output to spend with the next update.
+     */
+    PendingOperations ops;
+
+  };
+
   /** The parent mempool object.  Used to e.g. remove conflicting tx.  */
   CTxMemPool& pool;
 
   /**
-   * Keep track of names that are registered by transactions in the pool.
-   * For any given name, at most one registering transaction is allowed in the
-   * mempool (as all others would conflict with it).
+   * Per-name state for all names with pending operations.  This is looked
+   * up for each name transaction entering the mempool, so it is a (salted)
+   * hash map rather than an ordered one.
    */
-  std::map<valtype, uint256> mapNameRegs;
+  std::unordered_map<valtype, NameState, SaltedNameHasher> names;
 
   /**
-   * Keep track of all transactions that update a given name.  For each name,
-   * this may be a whole chain of updates.  This field is used to remove the
-   * transactions from the mempool should the name expire (and the updates
-   * thus become invalid).
-   *
-   * We also use this to determine the length of chains of pending name_update
-   * operations.
+   * Returns the state for the given name, or null if it has no
+   * pending operations.
    */
-  std::map<valtype, std::set<uint256>> updates;
+  const NameState*
+  getState (const valtype& name) const
+  {
+    const auto mit = names.find (name);
+    if (mit == names.end ())
+      return nullptr;
+    return &mit->second;
+  }
+
+  /**
+   * Sorts the given pending operations of a name into the order of the
+   * chain, based on which of their transactions spend which others.
+   */
+  void SortChain (PendingOperations& ops) const;
 
 public:
 
@@ -76,7 +137,8 @@ public:
   bool
   registersName (const valtype& name) const
   {
-    return mapNameRegs.count (name) > 0;
+    const NameState* state = getState (name);
+    return state != nullptr && !state->registration.IsNull ();
   }
 
   /**
@@ -86,10 +148,10 @@ public:
   bool
   updatesName (const valtype& name) const
   {
-    const auto mit = updates.find (name);
-    if (mit == updates.end ())
+    const NameState* state = getState (name);
+    if (state == nullptr)
       return false;
-    return !mit->second.empty ();
+    return state->ops.size () > (state->registration.IsNull () ? 0 : 1);
   }
 
   /**
@@ -97,7 +159,12 @@ public:
    * In other words, this is the "length" of the chain of operations that
    * are already pending.
    */
-  unsigned pendingChainLength (const valtype& name) const;
+  unsigned
+  pendingChainLength (const valtype& name) const
+  {
+    const NameState* state = getState (name);
+    return state == nullptr ? 0 : state->ops.size ();
+  }
 
   /**
    * Returns the last outpoint of a (potential) chain of pending name operations
@@ -107,14 +174,25 @@ public:
    */
   COutPoint lastNameOutput (const valtype& name) const;
 
+  /**
+   * Returns the pending operations for the given name (which may be empty).
+   * Does not lock.
+   */
+  const PendingOperations& getPendingOperations (const valtype& name) const;
+
+  /**
+   * Returns all names that have pending operations, in no particular order.
+   * Does not lock.
+   */
+  std::vector<valtype> getPendingNames () const;
+
   /**
    * Clears all data.
    */
   void
   clear ()
   {
-    mapNameRegs.clear ();
-    updates.clear ();
+    names.clear ();
   }
 
   /**
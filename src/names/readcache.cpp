@@ -0,0 +1,153 @@
+// Copyright (c) 2019 The Xaya developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <names/readcache.h>
+
+#include <memusage.h>
+
+size_t
+NameReadCache::Shard::EntryUsage (const valtype& name, const CNameData& data)
+{
+  using Node = memusage::unordered_node<std::pair<const valtype, Entry>>;
+
+  /* A list node holds the value and two pointers.  */
+  return memusage::MallocUsage (sizeof (Node))
+          + memusage::MallocUsage (3 * sizeof (void*))
+          + memusage::DynamicUsage (name) + data.DynamicMemoryUsage ();
+}
+
+void
+NameReadCache::Shard::Erase (const EntryMap::iterator mit)
+{
+  usage -= EntryUsage (mit->first, mit->second.data);
+  lru.erase (mit->second.pos);
+  entries.erase (mit);
+}
+
+void
+NameReadCache::Shard::Evict (const size_t maxUsage)
+{
+  while (usage > maxUsage)
+    {
+      assert (!lru.empty ());
+      const auto mit = entries.find (*lru.back ());
+      assert (mit != entries.end ());
+      Erase (mit);
+    }
+}
+
+/* ************************************************************************** */
+
+NameReadCache::NameReadCache (const size_t maxUsage)
+  : maxShardUsage(maxUsage / SHARDS)
+{}
+
+NameReadCache::Shard&
+NameReadCache::GetShard (const valtype& name)
+{
+  return shards[shardHasher (name) % SHARDS];
+}
+
+void
+NameReadCache::SetMaxUsage (const size_t maxUsage)
+{
+  maxShardUsage = maxUsage / SHARDS;
+  for (auto& s : shards)
+    {
+      LOCK (s.cs);
+      s.Evict (maxShardUsage);
+    }
+}
+
+bool
+NameReadCache::Lookup (const valtype& name, CNameData& data)
+{
+  Shard& s = GetShard (name);
+  LOCK (s.cs);
+
+  const auto mit = s.entries.find (name);
+  if (mit == s.entries.end ())
+    {
+      ++s.misses;
+      return false;
+    }
+
+  ++s.hits;
+  s.lru.splice (s.lru.begin (), s.lru, mit->second.pos);
+  data = mit->second.data;
+  return true;
+}
+
+void
+NameReadCache::Insert (const valtype& name, const CNameData& data,
+                       const uint64_t gen)
+{
+  const size_t maxUsage = maxShardUsage;
+  if (Shard::EntryUsage (name, data) > maxUsage)
+    return;
+
+  Shard& s = GetShard (name);
+  LOCK (s.cs);
+
+  /* The generation is checked while holding the shard lock.  Invalidate
+     increments it before erasing names from the shards, so either we see
+     the new generation here, or our entry is erased afterwards.  */
+  if (gen != generation.load ())
+    return;
+
+  auto mit = s.entries.find (name);
+  if (mit != s.entries.end ())
+    s.Erase (mit);
+
+  mit = s.entries.emplace (name, Shard::Entry ()).first;
+  mit->second.data = data;
+  s.lru.push_front (&mit->first);
+  mit->second.pos = s.lru.begin ();
+  s.usage += Shard::EntryUsage (mit->first, mit->second.data);
+
+  s.Evict (maxUsage);
+}
+
+void
+NameReadCache::Invalidate (const CNameCache& changes)
+{
+  ++generation;
+
+  const auto invalidateName = [this] (const valtype& name)
+    {
+      Shard& s = GetShard (name);
+      LOCK (s.cs);
+
+      const auto mit = s.entries.find (name);
+      if (mit != s.entries.end ())
+        s.Erase (mit);
+    };
+
+  for (const auto& entry : changes.getEntries ())
+    invalidateName (entry.first);
+  for (const auto& name : changes.getDeleted ())
+    invalidateName (name);
+}
+
+NameReadCache::Stats
+NameReadCache::GetStats () const
+{
+  Stats res;
+  res.size = 0;
+  res.usage = 0;
+  res.maxUsage = maxShardUsage * SHARDS;
+  res.hits = 0;
+  res.misses = 0;
+
+  for (const auto& s : shards)
+    {
+      LOCK (s.cs);
+      res.size += s.entries.size ();
+      res.usage += s.usage;
+      res.hits += s.hits;
+      res.misses += s.misses;
+    }
+
+  return res;
+}
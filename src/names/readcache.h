@@ -0,0 +1,160 @@
+// Copyright (c) 2019 The Xaya developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef H_BITCOIN_NAMES_READCACHE
+#define H_BITCOIN_NAMES_READCACHE
+
+#include <names/common.h>
+#include <sync.h>
+
+#include <array>
+#include <atomic>
+#include <list>
+#include <unordered_map>
+
+/**
+ * Default for -namereadcache, the memory (in MiB) used for caching name
+ * data read from the database.
+ */
+static constexpr int64_t DEFAULT_NAME_READ_CACHE = 16;
+
+/**
+ * Cache of CNameData read from the name database, so that lookups of popular
+ * names (e. g. p/ and g/ names updated in many blocks) do not go to LevelDB
+ * and deserialise the data every time.  It sits below the coins-view
+ * hierarchy in CCoinsViewDB and only holds the state of the database itself.
+ *
+ * The cache is split into shards with their own locks and LRU lists, so that
+ * concurrent lookups (e. g. RPC calls and block validation) do not contend
+ * on a single lock.  The memory budget is split evenly between the shards.
+ *
+ * When names are changed in the database, they are invalidated.  A generation
+ * counter makes sure that reads racing with the update do not insert stale
+ * data afterwards.
+ */
+class NameReadCache
+{
+
+public:
+
+  /** Number of shards the cache is split into.  */
+  static constexpr unsigned SHARDS = 16;
+
+  /**
+   * Statistics about the cache.
+   */
+  struct Stats
+  {
+    size_t size;
+    size_t usage;
+    size_t maxUsage;
+    uint64_t hits;
+    uint64_t misses;
+  };
+
+private:
+
+  /**
+   * A single shard of the cache.  The LRU list holds pointers to the keys
+   * in the map (which are stable), most recently used first.
+   */
+  struct Shard
+  {
+
+    using LruList = std::list<const valtype*>;
+
+    struct Entry
+    {
+      CNameData data;
+      LruList::iterator pos;
+    };
+
+    using EntryMap = std::unordered_map<valtype, Entry, SaltedNameHasher>;
+
+    EntryMap entries GUARDED_BY (cs);
+    LruList lru GUARDED_BY (cs);
+
+    size_t usage GUARDED_BY (cs) = 0;
+    uint64_t hits GUARDED_BY (cs) = 0;
+    uint64_t misses GUARDED_BY (cs) = 0;
+
+    mutable CCriticalSection cs;
+
+    /** Memory used for a single entry.  */
+    static size_t EntryUsage (const valtype& name, const CNameData& data);
+
+    /** Removes the given entry.  */
+    void Erase (EntryMap::iterator mit)
+        EXCLUSIVE_LOCKS_REQUIRED (cs);
+
+    /** Evicts least-recently used entries until usage is within the limit.  */
+    void Evict (size_t maxUsage) EXCLUSIVE_LOCKS_REQUIRED (cs);
+
+  };
+
+  /** Hasher used to select the shard for a name.  */
+  const SaltedNameHasher shardHasher;
+
+  std::array<Shard, SHARDS> shards;
+
+  /** Memory budget for each shard.  */
+  std::atomic<size_t> maxShardUsage;
+
+  /**
+   * Generation counter, incremented whenever names are invalidated.
+   * Insertions are only done if the generation did not change since
+   * the data was read from the database.
+   */
+  std::atomic<uint64_t> generation{0};
+
+  Shard& GetShard (const valtype& name);
+
+public:
+
+  /**
+   * Constructs the cache with a total memory budget in bytes.  Zero
+   * disables the cache.
+   */
+  explicit NameReadCache (size_t maxUsage);
+
+  NameReadCache (const NameReadCache&) = delete;
+  void operator= (const NameReadCache&) = delete;
+
+  /**
+   * Changes the memory budget, evicting entries if needed.
+   */
+  void SetMaxUsage (size_t maxUsage);
+
+  /**
+   * Returns the current generation.  This must be queried before reading
+   * the data from the database that is passed to Insert.
+   */
+  inline uint64_t
+  GetGeneration () const
+  {
+    return generation.load ();
+  }
+
+  /**
+   * Looks up a name.  Returns false if it is not cached.
+   */
+  bool Lookup (const valtype& name, CNameData& data);
+
+  /**
+   * Adds a name's data as read from the database.  This does nothing if the
+   * generation has changed in the mean time.
+   */
+  void Insert (const valtype& name, const CNameData& data, uint64_t gen);
+
+  /**
+   * Removes all names changed in the given name cache.  To be called after
+   * the changes have been written to the database.
+   */
+  void Invalidate (const CNameCache& changes);
+
+  Stats GetStats () const;
+
+};
+
+#endif // H_BITCOIN_NAMES_READCACHE
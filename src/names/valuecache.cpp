@@ -0,0 +1,210 @@
+// Copyright (c) 2019 The Xaya developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <names/valuecache.h>
+
+#include <crypto/siphash.h>
+#include <logging.h>
+#include <memusage.h>
+#include <random.h>
+#include <util/system.h>
+
+#include <algorithm>
+#include <limits>
+
+ParsedNameValue::ParsedNameValue (const UniValue& value)
+{
+  assert (value.isObject ());
+
+  for (size_t i = 0; i < value.size (); ++i)
+    if (value.getKeys ()[i] == "cmd")
+      cmds.push_back (value.getValues ()[i]);
+
+  /* The game moves are only taken into account if the first "g" entry is
+     a non-empty object.  This matches what games have always seen.  */
+  if (!value.exists ("g"))
+    return;
+  const UniValue& g = value["g"];
+  if (!g.isObject () || g.empty ())
+    return;
+
+  for (size_t i = 0; i < value.size (); ++i)
+    {
+      if (value.getKeys ()[i] != "g")
+        continue;
+      const auto& cur = value.getValues ()[i];
+      if (!cur.isObject ())
+        continue;
+
+      for (size_t j = 0; j < cur.size (); ++j)
+        moves[cur.getKeys ()[j]] = cur.getValues ()[j];
+    }
+}
+
+namespace
+{
+
+size_t
+StringUsage (const std::string& str)
+{
+  /* Short strings are stored inline without allocation.  */
+  if (str.capacity () < sizeof (std::string))
+    return 0;
+  return memusage::MallocUsage (str.capacity () + 1);
+}
+
+size_t
+JsonUsage (const UniValue& value)
+{
+  size_t res = StringUsage (value.getValStr ());
+  if (!value.isObject () && !value.isArray ())
+    return res;
+
+  if (value.isObject ())
+    {
+      const auto& keys = value.getKeys ();
+      res += memusage::DynamicUsage (keys);
+      for (const auto& k : keys)
+        res += StringUsage (k);
+    }
+
+  const auto& values = value.getValues ();
+  res += memusage::DynamicUsage (values);
+  for (const auto& v : values)
+    res += JsonUsage (v);
+
+  return res;
+}
+
+} // anonymous namespace
+
+size_t
+ParsedNameValue::DynamicMemoryUsage () const
+{
+  size_t res = memusage::DynamicUsage (moves);
+  for (const auto& entry : moves)
+    res += StringUsage (entry.first) + JsonUsage (entry.second);
+
+  res += memusage::DynamicUsage (cmds);
+  for (const auto& c : cmds)
+    res += JsonUsage (c);
+
+  return res;
+}
+
+/* ************************************************************************** */
+
+NameValueCache::Hasher::Hasher ()
+  : k0(GetRand (std::numeric_limits<uint64_t>::max ())),
+    k1(GetRand (std::numeric_limits<uint64_t>::max ()))
+{}
+
+size_t
+NameValueCache::Hasher::operator() (const uint256& txid) const
+{
+  return SipHashUint256 (k0, k1, txid);
+}
+
+void
+NameValueCache::Evict ()
+{
+  while (usage > maxUsage)
+    {
+      assert (!order.empty ());
+      const auto mit = entries.find (order.front ());
+      assert (mit != entries.end ());
+      usage -= mit->second.usage;
+      entries.erase (mit);
+      order.pop_front ();
+    }
+}
+
+void
+NameValueCache::SetMaxUsage (const size_t maxBytes)
+{
+  LOCK (cs);
+
+  maxUsage = maxBytes;
+  Evict ();
+}
+
+NameValueCache::Entry
+NameValueCache::Lookup (const uint256& txid)
+{
+  {
+    LOCK (cs);
+    const auto mit = entries.find (txid);
+    if (mit != entries.end ())
+      {
+        ++hits;
+        return mit->second.value;
+      }
+  }
+
+  ++misses;
+  return nullptr;
+}
+
+void
+NameValueCache::Insert (const uint256& txid, Entry value)
+{
+  LOCK (cs);
+
+  if (maxUsage == 0 || entries.count (txid) > 0)
+    return;
+
+  /* Account for the hash-table node, the queue entry and the shared
+     ParsedNameValue object besides the parsed data itself.  */
+  using Node = memusage::unordered_node<std::pair<const uint256, CachedValue>>;
+  CachedValue entry;
+  entry.usage = memusage::MallocUsage (sizeof (Node)) + sizeof (uint256)
+                  + memusage::DynamicUsage (value)
+                  + value->DynamicMemoryUsage ();
+  entry.value = std::move (value);
+
+  usage += entry.usage;
+  entries.emplace (txid, std::move (entry));
+  order.push_back (txid);
+
+  Evict ();
+}
+
+NameValueCache::Stats
+NameValueCache::GetStats () const
+{
+  LOCK (cs);
+
+  Stats res;
+  res.size = entries.size ();
+  res.usage = usage;
+  res.maxUsage = maxUsage;
+  res.hits = hits;
+  res.misses = misses;
+
+  return res;
+}
+
+/* ************************************************************************** */
+
+namespace
+{
+
+NameValueCache nameValueCache;
+
+} // anonymous namespace
+
+NameValueCache&
+GetNameValueCache ()
+{
+  return nameValueCache;
+}
+
+void
+InitNameValueCache ()
+{
+  const int64_t n = std::max<int64_t> (
+      0, gArgs.GetArg ("-namevaluecache", DEFAULT_NAME_VALUE_CACHE));
+  nameValueCache.SetMaxUsage (n << 20);
+  LogPrintf ("Using up to %d MiB for name value cache\n", n);
+}
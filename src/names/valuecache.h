@@ -0,0 +1,173 @@
+// Copyright (c) 2019 The Xaya developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef H_BITCOIN_NAMES_VALUECACHE
+#define H_BITCOIN_NAMES_VALUECACHE
+
+#include <sync.h>
+#include <uint256.h>
+
+#include <univalue.h>
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Default for -namevaluecache, the memory (in MiB) used for caching parsed
+ * name values.
+ */
+static constexpr int64_t DEFAULT_NAME_VALUE_CACHE = 16;
+
+/**
+ * The value of a name operation, parsed from JSON and already split into
+ * the parts that are relevant for games.
+ */
+class ParsedNameValue
+{
+
+public:
+
+  /**
+   * The moves per game from the "g" objects of the value.  If there are
+   * multiple "g" keys, later entries for the same game override earlier
+   * ones.  This is empty if the first "g" key is not a non-empty object.
+   */
+  std::map<std::string, UniValue> moves;
+
+  /** The values of all "cmd" keys, in order.  */
+  std::vector<UniValue> cmds;
+
+  /**
+   * Splits up the given value, which must be a JSON object.
+   */
+  explicit ParsedNameValue (const UniValue& value);
+
+  /**
+   * Returns the memory used by the parsed value (including the object
+   * itself), which may be many times the size of the raw JSON for
+   * deeply nested values.
+   */
+  size_t DynamicMemoryUsage () const;
+
+};
+
+/**
+ * Cache of parsed name values keyed by txid.  The value of a name operation
+ * is parsed when the transaction is first validated (usually on acceptance
+ * to the mempool); the result is kept here, so that block validation, the
+ * game notifications and game_sendupdates do not parse it again.  Since
+ * the txid commits to the outputs, the value for a txid never changes.
+ *
+ * Values are only inserted once their transaction has been accepted to
+ * the mempool or its block connected, so that peers cannot fill the cache
+ * with junk.  The cache is bounded by its memory usage, and the oldest
+ * entries are evicted first.
+ */
+class NameValueCache
+{
+
+public:
+
+  /**
+   * Statistics about the cache.
+   */
+  struct Stats
+  {
+    size_t size;
+    size_t usage;
+    size_t maxUsage;
+    uint64_t hits;
+    uint64_t misses;
+  };
+
+private:
+
+  /**
+   * Salted hasher for the txids, so that peers cannot make us run into
+   * bad hash table behaviour by grinding txids.
+   */
+  class Hasher
+  {
+  private:
+    uint64_t k0;
+    uint64_t k1;
+  public:
+    Hasher ();
+    size_t operator() (const uint256& txid) const;
+  };
+
+  using Entry = std::shared_ptr<const ParsedNameValue>;
+
+  /** A cached value together with its accounted memory usage.  */
+  struct CachedValue
+  {
+    Entry value;
+    size_t usage;
+  };
+
+  size_t maxUsage GUARDED_BY (cs);
+  size_t usage GUARDED_BY (cs) = 0;
+
+  std::unordered_map<uint256, CachedValue, Hasher> entries GUARDED_BY (cs);
+
+  /** The txids in the order they were inserted, for eviction.  */
+  std::deque<uint256> order GUARDED_BY (cs);
+
+  std::atomic<uint64_t> hits{0};
+  std::atomic<uint64_t> misses{0};
+
+  mutable CCriticalSection cs;
+
+  /** Evicts the oldest entries until usage is within the limit.  */
+  void Evict () EXCLUSIVE_LOCKS_REQUIRED (cs);
+
+public:
+
+  explicit NameValueCache (size_t maxBytes = DEFAULT_NAME_VALUE_CACHE << 20)
+    : maxUsage(maxBytes)
+  {}
+
+  NameValueCache (const NameValueCache&) = delete;
+  void operator= (const NameValueCache&) = delete;
+
+  /**
+   * Changes the maximum memory usage in bytes, evicting entries if needed.
+   * Zero disables the cache.
+   */
+  void SetMaxUsage (size_t maxBytes);
+
+  /**
+   * Looks up the parsed value for the given txid.  Returns null if it is
+   * not cached.
+   */
+  Entry Lookup (const uint256& txid);
+
+  /**
+   * Adds the parsed value for a transaction.  This must only be called
+   * for transactions that were accepted to the mempool or are part of
+   * a connected block.
+   */
+  void Insert (const uint256& txid, Entry value);
+
+  Stats GetStats () const;
+
+};
+
+/**
+ * Returns the global name value cache.
+ */
+NameValueCache& GetNameValueCache ();
+
+/**
+ * Initialises the size of the global name value cache from -namevaluecache.
+ * To be called once in AppInitMain and the test setup.
+ */
+void InitNameValueCache ();
+
+#endif // H_BITCOIN_NAMES_VALUECACHE
@@ -29,8 +29,7 @@ static void ApplyStats(CCoinsStats &stats, CHashWriter& ss, const uint256& hash,
         ss << VARINT(output.second.out.nValue, VarIntMode::NONNEGATIVE_SIGNED);
         stats.nTransactionOutputs++;
 
-        const CNameScript nameOp(output.second.out.scriptPubKey);
-        if (nameOp.isNameOp()) {
+        if (CNameScript::isNameScript(output.second.out.scriptPubKey)) {
             stats.nNameAmount += output.second.out.nValue;
         } else {
             stats.nCoinAmount += output.second.out.nValue;
@@ -7,12 +7,149 @@
 
 #include <arith_uint256.h>
 #include <chain.h>
+#include <crypto/common.h>
 #include <powdata.h>
+#include <sync.h>
 #include <uint256.h>
 
+#include <list>
+#include <tuple>
+#include <unordered_map>
+
+namespace
+{
+
+/**
+ * Cache of GetNextWorkRequired results.  The templates for mining, the
+ * checks of headers and blocks built on them as well as the difficulty RPCs
+ * all compute the difficulty on top of the same few blocks again and again.
+ *
+ * Entries are keyed by the block hash rather than the CBlockIndex pointer.
+ * Note that the block hash does not commit to the PowData, which holds the
+ * algo and real nBits the result depends on.  Keying on the hash is only
+ * safe because mapBlockIndex holds exactly one CBlockIndex per hash (whose
+ * algo and nBits never change), so that a hash identifies the same chain of
+ * index entries until the block index is unloaded (when the cache is
+ * cleared).  Thus entries stay valid across reorgs.
+ *
+ * When the cache is full, the least recently used entry is evicted.  This
+ * keeps the few blocks around the tip that are queried repeatedly, while
+ * e.g. a header sync queries each new block only once or twice.
+ */
+class NextWorkCache
+{
+
+private:
+
+  /** Maximum number of entries in the cache.  */
+  static constexpr size_t MAX_ENTRIES = 256;
+
+  struct Key
+  {
+    uint256 hash;
+    PowAlgo algo;
+    const Consensus::Params* params;
+
+    bool
+    operator== (const Key& o) const
+    {
+      return std::tie (hash, algo, params) == std::tie (o.hash, o.algo, o.params);
+    }
+  };
+
+  struct KeyHasher
+  {
+    size_t
+    operator() (const Key& k) const
+    {
+      return ReadLE64 (k.hash.begin ()) ^ static_cast<size_t> (k.algo);
+    }
+  };
+
+  /** The entries, with the most recently used first.  */
+  using EntryList = std::list<std::pair<Key, unsigned>>;
+
+  Mutex cs;
+  EntryList recent GUARDED_BY (cs);
+  std::unordered_map<Key, EntryList::iterator, KeyHasher> entries
+      GUARDED_BY (cs);
+
+public:
+
+  bool
+  Lookup (const uint256& hash, const PowAlgo algo,
+          const Consensus::Params& params, unsigned& bits)
+  {
+    LOCK (cs);
+    const auto mit = entries.find ({hash, algo, &params});
+    if (mit == entries.end ())
+      return false;
+    recent.splice (recent.begin (), recent, mit->second);
+    bits = mit->second->second;
+    return true;
+  }
+
+  void
+  Insert (const uint256& hash, const PowAlgo algo,
+          const Consensus::Params& params, const unsigned bits)
+  {
+    LOCK (cs);
+    const Key key{hash, algo, &params};
+    if (entries.count (key) > 0)
+      return;
+
+    recent.emplace_front (key, bits);
+    entries.emplace (key, recent.begin ());
+    if (recent.size () > MAX_ENTRIES)
+      {
+        entries.erase (recent.back ().first);
+        recent.pop_back ();
+      }
+  }
+
+  void
+  Clear ()
+  {
+    LOCK (cs);
+    entries.clear ();
+    recent.clear ();
+  }
+
+};
+
+NextWorkCache nextWorkCache;
+
+} // anonymous namespace
+
 unsigned int
 GetNextWorkRequired (const PowAlgo algo, const CBlockIndex* pindexLast,
                      const Consensus::Params& params)
+{
+  /* Block indices that are not part of the block tree (e.g. in tests)
+     may not have a hash, so those are not cached.  */
+  if (pindexLast == nullptr || pindexLast->phashBlock == nullptr
+        || params.fPowNoRetargeting)
+    return CalculateNextWorkRequired (algo, pindexLast, params);
+
+  const uint256 hash = pindexLast->GetBlockHash ();
+  unsigned bits;
+  if (nextWorkCache.Lookup (hash, algo, params, bits))
+    return bits;
+
+  bits = CalculateNextWorkRequired (algo, pindexLast, params);
+  nextWorkCache.Insert (hash, algo, params, bits);
+  return bits;
+}
+
+void
+ClearNextWorkCache ()
+{
+  nextWorkCache.Clear ();
+}
+
+unsigned int
+CalculateNextWorkRequired (const PowAlgo algo, const CBlockIndex* pindexLast,
+                           const Consensus::Params& params)
 {
   const arith_uint256 bnPowLimit
       = UintToArith256 (powLimitForAlgo (algo, params));
@@ -48,12 +185,8 @@ GetNextWorkRequired (const PowAlgo algo, const CBlockIndex* pindexLast,
         pindexFirst = pindex;
 
       /* We need to step back to the last block with the given algo, but at
-         least one block.  Note that GetLastAncestorWithAlgo returns the
-         block itself if it matches.  */
-      pindex = pindex->pprev;
-      if (pindex != nullptr)
-        pindex = pindex->GetLastAncestorWithAlgo (algo);
-
+         least one block.  */
+      pindex = pindex->GetPrevWithAlgo (algo);
       if (pindex == nullptr)
         return bnPowLimit.GetCompact ();
     }
@@ -16,6 +16,20 @@ class uint256;
 
 enum class PowAlgo : uint8_t;
 
+/**
+ * Returns the nBits required for the next block of the given algo after
+ * pindexLast.  Results for recently queried blocks are cached.
+ */
 unsigned int GetNextWorkRequired(PowAlgo algo, const CBlockIndex* pindexLast, const Consensus::Params&);
 
+/**
+ * Clears the cache of GetNextWorkRequired.  This must be done when the block
+ * index is unloaded, since the cache assumes a block hash always refers to
+ * the same index entries.
+ */
+void ClearNextWorkCache();
+
+/** Computes the result of GetNextWorkRequired without using the cache.  */
+unsigned int CalculateNextWorkRequired(PowAlgo algo, const CBlockIndex* pindexLast, const Consensus::Params&);
+
 #endif // BITCOIN_POW_H
@@ -165,27 +165,43 @@ PowData::isValid (const uint256& hash, const Consensus::Params& params) const
 }
 
 bool
-PowData::checkProofOfWork (const CPureBlockHeader& hdr,
-                           const Consensus::Params& params) const
+PowData::getTarget (const Consensus::Params& params,
+                    arith_uint256& target) const
 {
-  const PowAlgo coreAlgo = getCoreAlgo ();
-
   /* The code below is CheckProofOfWork from upstream's pow.cpp.  It has been
      moved here so that powdata.cpp does not depend on pow.cpp, which is
      in the "server" library.  */
 
   bool fNegative, fOverflow;
-  arith_uint256 bnTarget;
-  bnTarget.SetCompact (getBits (), &fNegative, &fOverflow);
+  target.SetCompact (getBits (), &fNegative, &fOverflow);
 
   // Check range
-  if (fNegative || bnTarget == 0 || fOverflow
-        || bnTarget > UintToArith256 (powLimitForAlgo (coreAlgo, params)))
+  if (fNegative || target == 0 || fOverflow
+        || target > UintToArith256 (powLimitForAlgo (getCoreAlgo (), params)))
+    return false;
+
+  return true;
+}
+
+bool
+PowData::checkProofOfWork (const CPureBlockHeader& hdr,
+                           const Consensus::Params& params) const
+{
+  arith_uint256 bnTarget;
+  if (!getTarget (params, bnTarget))
     return false;
 
   // Check proof of work matches claimed amount
-  if (UintToArith256 (hdr.GetPowHash (coreAlgo)) > bnTarget)
+  return UintToArith256 (hdr.GetPowHash (getCoreAlgo ())) <= bnTarget;
+}
+
+bool
+PowData::checkPowHash (const uint256& hash,
+                       const Consensus::Params& params) const
+{
+  arith_uint256 bnTarget;
+  if (!getTarget (params, bnTarget))
     return false;
 
-  return true;
+  return UintToArith256 (hash) <= bnTarget;
 }
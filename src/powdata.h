@@ -15,6 +15,8 @@
 #include <memory>
 #include <string>
 
+class arith_uint256;
+
 namespace Consensus
 {
 class Params;
@@ -95,6 +97,12 @@ private:
 
   friend class powdata_tests::PowDataForTest;
 
+  /**
+   * Decodes the target from nBits.  Returns false if it is out of range
+   * for this data's algorithm.
+   */
+  bool getTarget (const Consensus::Params& params, arith_uint256& target) const;
+
 public:
 
   inline PowData ()
@@ -216,6 +224,13 @@ public:
   bool checkProofOfWork (const CPureBlockHeader& hdr,
                          const Consensus::Params& params) const;
 
+  /**
+   * Verifies whether the given PoW hash (computed for this data's algorithm)
+   * satisfies this data's target.
+   */
+  bool checkPowHash (const uint256& hash,
+                     const Consensus::Params& params) const;
+
 };
 
 #endif // BITCOIN_POWDATA_H
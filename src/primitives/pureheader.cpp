@@ -6,6 +6,7 @@
 #include <primitives/pureheader.h>
 
 #include <crypto/neoscrypt.h>
+#include <crypto/neoscrypt_multi.h>
 #include <hash.h>
 #include <powdata.h>
 #include <streams.h>
@@ -22,8 +23,13 @@ uint256 CPureBlockHeader::GetHash() const
 namespace
 {
 
-uint256
-GetNeoscryptHash (const CPureBlockHeader& hdr)
+/**
+ * Appends the data that is hashed by neoscrypt for the given header
+ * to the output vector.
+ */
+void
+AppendNeoscryptInput (const CPureBlockHeader& hdr,
+                      std::vector<unsigned char>& out)
 {
   std::vector<unsigned char> data;
   CVectorWriter writer(SER_GETHASH, PROTOCOL_VERSION, data, 0);
@@ -34,6 +40,16 @@ GetNeoscryptHash (const CPureBlockHeader& hdr)
      from the PoW point of view, so we can just choose to be compatible.  */
   SwapGetWorkEndianness (data);
 
+  assert (data.size () == 80);
+  out.insert (out.end (), data.begin (), data.end ());
+}
+
+uint256
+GetNeoscryptHash (const CPureBlockHeader& hdr)
+{
+  std::vector<unsigned char> data;
+  AppendNeoscryptInput (hdr, data);
+
   constexpr int profile = 0;
   uint256 hash;
   neoscrypt (&data[0], hash.begin(), profile);
@@ -56,6 +72,24 @@ uint256 CPureBlockHeader::GetPowHash (const PowAlgo algo) const
     }
 }
 
+std::vector<uint256>
+GetNeoscryptPowHashes (const std::vector<CPureBlockHeader>& hdrs)
+{
+  std::vector<unsigned char> data;
+  data.reserve (80 * hdrs.size ());
+  for (const auto& hdr : hdrs)
+    AppendNeoscryptInput (hdr, data);
+
+  std::vector<uint256> hashes(hdrs.size ());
+  std::vector<unsigned char> out(32 * hdrs.size ());
+  NeoscryptMulti (out.data (), data.data (), hdrs.size ());
+  for (size_t i = 0; i < hdrs.size (); ++i)
+    std::copy (out.begin () + 32 * i, out.begin () + 32 * (i + 1),
+               hashes[i].begin ());
+
+  return hashes;
+}
+
 void
 SwapGetWorkEndianness (std::vector<unsigned char>& data)
 {
@@ -72,6 +72,13 @@ public:
     }
 };
 
+/**
+ * Computes the neoscrypt PoW hashes of multiple headers at once.  This
+ * uses the multi-way implementation where available, and is otherwise
+ * equivalent to GetPowHash(PowAlgo::NEOSCRYPT) on each of them.
+ */
+std::vector<uint256> GetNeoscryptPowHashes (const std::vector<CPureBlockHeader>& hdrs);
+
 /**
  * Swaps the endian-ness of each 4-byte word in the given vector of bytes.
  * This is used for getwork and also for our neoscrypt PoW hash.
@@ -728,6 +728,93 @@ static bool rest_name(HTTPRequest* req, const std::string& strURIPart)
     return true; // continue to process further HTTP reqs on this cxn
 }
 
+static bool rest_names(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    if (!param.empty() && param != "/")
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid URI format");
+    if (req->GetRequestMethod() != HTTPRequest::POST)
+        return RESTERR(req, HTTP_BAD_METHOD, "Names must be sent via POST");
+
+    // The body contains one encoded name per line (encoded in the same way
+    // as for /rest/name/).  Empty lines are ignored.
+    std::vector<std::string> lines;
+    const std::string body = req->ReadBody();
+    boost::split(lines, body, boost::is_any_of("\n"));
+
+    std::vector<valtype> names;
+    for (std::string& line : lines) {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (line.empty())
+            continue;
+
+        if (names.size() >= MAX_NAME_LOOKUP_BATCH)
+            return RESTERR(req, HTTP_BAD_REQUEST, strprintf("Error: max names exceeded (max: %d)", MAX_NAME_LOOKUP_BATCH));
+
+        valtype plainName;
+        if (!DecodeName(plainName, line))
+            return RESTERR(req, HTTP_BAD_REQUEST,
+                           "Invalid encoded name: " + line);
+        names.push_back(std::move(plainName));
+    }
+
+    const auto found = LookupNames(names);
+    assert(found.size() == names.size());
+
+    switch (rf)
+    {
+    case RetFormat::BINARY:
+    case RetFormat::HEX:
+    {
+        // For each name, a byte indicating whether it was found,
+        // followed by the value if it was.
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        for (const auto& data : found) {
+            ss << (data != nullptr);
+            if (data != nullptr)
+                ss << data->getValue();
+        }
+
+        if (rf == RetFormat::BINARY) {
+            req->WriteHeader("Content-Type", "application/octet-stream");
+            req->WriteReply(HTTP_OK, ss.str());
+        } else {
+            req->WriteHeader("Content-Type", "text/plain");
+            req->WriteReply(HTTP_OK, HexStr(ss.begin(), ss.end()) + "\n");
+        }
+        return true;
+    }
+
+    case RetFormat::JSON:
+    {
+        const UniValue NO_OPTIONS(UniValue::VOBJ);
+        UniValue arr(UniValue::VARR);
+        for (size_t i = 0; i < names.size(); ++i) {
+            if (found[i] == nullptr)
+                arr.push_back(NullUniValue);
+            else
+                arr.push_back(getNameInfo(NO_OPTIONS, names[i], *found[i]));
+        }
+
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, arr.write() + "\n");
+        return true;
+    }
+
+    default:
+        return RESTERR(req, HTTP_NOT_FOUND,
+                       "output format not found (available: "
+                        + AvailableDataFormatsString() + ")");
+    }
+
+    // not reached
+    return true; // continue to process further HTTP reqs on this cxn
+}
+
 static const struct {
     const char* prefix;
     bool (*handler)(HTTPRequest* req, const std::string& strReq);
@@ -742,6 +829,7 @@ static const struct {
       {"/rest/getutxos", rest_getutxos},
       {"/rest/blockhashbyheight/", rest_blockhash_by_height},
       {"/rest/name/", rest_name},
+      {"/rest/names", rest_names},
 };
 
 void StartREST()
@@ -152,6 +152,8 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "logging", 1, "exclude" },
     { "disconnectnode", 1, "nodeid" },
     { "name_show", 1, "options" },
+    { "name_show_many", 0, "names" },
+    { "name_show_many", 1, "options" },
     { "name_history", 1, "options" },
     { "name_scan", 1, "count" },
     { "name_scan", 2, "options" },
@@ -6,6 +6,7 @@
 
 #include <chain.h>
 #include <chainparams.h>
+#include <index/gameindex.h>
 #include <logging.h>
 #include <random.h>
 #include <rpc/server.h>
@@ -38,14 +39,15 @@ GetTrackedGames ()
 }
 
 ZMQGameBlocksNotifier*
-GetGameBlocksNotifier ()
+GetGameBlocksNotifier (const std::string& game)
 {
   if (g_zmq_notification_interface == nullptr)
     throw JSONRPCError (RPC_MISC_ERROR, "ZMQ notifications are disabled");
 
-  auto* notifier = g_zmq_notification_interface->GetGameBlocksNotifier ();
+  auto* notifier = g_zmq_notification_interface->GetGameBlocksNotifier (game);
   if (notifier == nullptr)
-    throw JSONRPCError (RPC_MISC_ERROR, "-zmqpubgameblocks is not set");
+    throw JSONRPCError (RPC_MISC_ERROR,
+                        "-zmqpubgameblocks is not set for game " + game);
 
   return notifier;
 }
@@ -79,13 +81,33 @@ SendUpdatesWorker::Work::str () const
   return res.str ();
 }
 
-SendUpdatesWorker::SendUpdatesWorker ()
-  : interrupted(false)
+SendUpdatesWorker::Request::Request (Work&& wrk)
+  : w(std::move (wrk))
+{
+#if ENABLE_ZMQ
+  steps.reserve (w.detach.size () + w.attach.size ());
+  for (const auto* pindex : w.detach)
+    steps.emplace_back (ZMQGameBlocksNotifier::PREFIX_DETACH, pindex);
+  for (const auto* pindex : w.attach)
+    steps.emplace_back (ZMQGameBlocksNotifier::PREFIX_ATTACH, pindex);
+#endif // ENABLE_ZMQ
+}
+
+SendUpdatesWorker::SendUpdatesWorker (const int numThreads,
+                                      const int readAheadBlocks)
+  : interrupted(false), readAhead(std::max (readAheadBlocks, 1))
 {
   runner.reset (new std::thread ([this] ()
     {
       TraceThread ("sendupdates", [this] () { run (*this); });
     }));
+
+  for (int i = 0; i < std::max (numThreads, 1); ++i)
+    readers.emplace_back ([this, i] ()
+      {
+        const std::string name = strprintf ("sendupdates.%d", i);
+        TraceThread (name.c_str (), [this] () { runReader (*this); });
+      });
 }
 
 SendUpdatesWorker::~SendUpdatesWorker ()
@@ -93,45 +115,157 @@ SendUpdatesWorker::~SendUpdatesWorker ()
   if (runner != nullptr && runner->joinable ())
     runner->join ();
   runner.reset ();
+
+  for (auto& t : readers)
+    if (t.joinable ())
+      t.join ();
+  readers.clear ();
 }
 
 namespace
 {
 
 #if ENABLE_ZMQ
-void
-SendUpdatesOneBlock (const std::set<std::string>& trackedGames,
-                     const std::string& commandPrefix,
-                     const std::string& reqtoken,
-                     const CBlockIndex* pindex)
+/**
+ * Maximum number of steps that a reader thread claims from a request at once.
+ * Consecutive attaches are looked up from the game index together.
+ */
+constexpr size_t READ_CHUNK_SIZE = 16;
+
+/**
+ * Loads the parsed moves for a single block, either from the cache of the
+ * game's notifier or by reading it from disk.  Returns null if the block could
+ * not be read.
+ */
+std::shared_ptr<const BlockGameMoves>
+LoadBlockMoves (const std::string& game, const CBlockIndex* pindex)
 {
+  auto& cache = GetGameBlocksNotifier (game)->GetMovesCache ();
+
+  /* If we have the block's parsed moves cached already, we do not even
+     need to read it from disk.  */
+  auto data = cache.Lookup (pindex->GetBlockHash ());
+  if (data != nullptr)
+    return data;
+
   CBlock blk;
   if (!ReadBlockFromDisk (blk, pindex, Params ().GetConsensus ()))
     {
       LogPrint (BCLog::GAME, "Reading block %s failed, ignoring\n",
                 pindex->GetBlockHash ().GetHex ());
-      return;
+      return nullptr;
     }
 
-  auto* notifier = GetGameBlocksNotifier ();
-  notifier->SendBlockNotifications (trackedGames, commandPrefix, reqtoken, blk);
+  return cache.Get (blk);
 }
 #endif // ENABLE_ZMQ
 
 } // anonymous namespace
 
+void
+SendUpdatesWorker::runReader (SendUpdatesWorker& self)
+{
+#if ENABLE_ZMQ
+  while (true)
+    {
+      std::shared_ptr<Request> req;
+      size_t begin, end;
+
+      {
+        WAIT_LOCK (self.csWork, lock);
+
+        /* Claim the next chunk of steps from the first request (in service
+           order) that has steps left within its read-ahead window.  */
+        for (const auto& r : self.requests)
+          {
+            const size_t limit = std::min (r->steps.size (),
+                                           r->nextSend + self.readAhead);
+            if (r->nextRead >= limit)
+              continue;
+
+            begin = r->nextRead;
+            end = std::min (limit, begin + READ_CHUNK_SIZE);
+
+            /* Do not mix detaches and attaches in a single chunk, so that
+               attach chunks can be looked up from the game index.  */
+            for (size_t i = begin + 1; i < end; ++i)
+              if (r->steps[i].commandPrefix != r->steps[begin].commandPrefix)
+                {
+                  end = i;
+                  break;
+                }
+
+            r->nextRead = end;
+            req = r;
+            break;
+          }
+
+        if (req == nullptr)
+          {
+            if (self.interrupted && self.requests.empty ())
+              break;
+
+            self.cvWork.wait (lock);
+            continue;
+          }
+      }
+
+      /* The steps are only ever accessed by the reader that claimed them
+         until they are marked as ready, so we can load them without
+         holding the lock.  The claimed steps must be marked as ready
+         even if loading them fails, since the sender waits for them.
+         Steps without data are skipped.  */
+      std::vector<std::shared_ptr<const BlockGameMoves>> data;
+      try
+        {
+          const auto& games = req->w.trackedGames;
+          const bool useIndex
+              = req->steps[begin].commandPrefix
+                    == ZMQGameBlocksNotifier::PREFIX_ATTACH
+                  && g_gameindex != nullptr && games.size () == 1;
+          if (!useIndex
+                || !g_gameindex->LookupRange (
+                        *games.begin (), req->steps[begin].pindex->nHeight,
+                        req->steps[end - 1].pindex, data))
+            {
+              data.clear ();
+              for (size_t i = begin; i < end; ++i)
+                data.push_back (LoadBlockMoves (*games.begin (),
+                                                req->steps[i].pindex));
+            }
+        }
+      catch (const std::exception& exc)
+        {
+          LogPrintf ("Error loading blocks for sendupdates: %s\n",
+                     exc.what ());
+          data.assign (end - begin, nullptr);
+        }
+      assert (data.size () == end - begin);
+
+      WAIT_LOCK (self.csWork, lock);
+      for (size_t i = begin; i < end; ++i)
+        {
+          req->steps[i].data = std::move (data[i - begin]);
+          req->steps[i].ready = true;
+        }
+      self.cvWork.notify_all ();
+    }
+#endif // ENABLE_ZMQ
+}
+
 void
 SendUpdatesWorker::run (SendUpdatesWorker& self)
 {
 #if ENABLE_ZMQ
   while (true)
     {
-      Work w;
+      std::shared_ptr<Request> req;
+      Step* step;
 
       {
         WAIT_LOCK (self.csWork, lock);
 
-        if (self.work.empty ())
+        if (self.requests.empty ())
           {
             LogPrint (BCLog::GAME,
                       "SendUpdatesWorker queue empty, interrupted = %d\n",
@@ -146,23 +280,53 @@ SendUpdatesWorker::run (SendUpdatesWorker& self)
             continue;
           }
 
-        w = std::move (self.work.front ());
-        self.work.pop ();
+        /* Send the next step of the first request that has it ready.  Each
+           request that got a step sent is moved to the back of the list,
+           so that concurrent requests are served in a round-robin way
+           and a long request does not block shorter ones.  */
+        auto mit = self.requests.begin ();
+        for (; mit != self.requests.end (); ++mit)
+          if ((*mit)->steps[(*mit)->nextSend].ready)
+            break;
+
+        if (mit == self.requests.end ())
+          {
+            self.cvWork.wait (lock);
+            continue;
+          }
+
+        req = *mit;
+        if (req->nextSend == 0)
+          LogPrint (BCLog::GAME, "Started sending for sendupdates: %s\n",
+                    req->w.str ().c_str ());
+        step = &req->steps[req->nextSend];
+        ++req->nextSend;
+
+        self.requests.erase (mit);
+        if (req->nextSend < req->steps.size ())
+          self.requests.push_back (req);
 
-        LogPrint (BCLog::GAME, "Popped for sendupdates processing: %s\n",
-                  w.str ().c_str ());
+        /* The read-ahead window of the request has moved.  */
+        self.cvWork.notify_all ();
       }
 
-      for (const auto* pindex : w.detach)
-        SendUpdatesOneBlock (w.trackedGames,
-                             ZMQGameBlocksNotifier::PREFIX_DETACH,
-                             w.reqtoken, pindex);
-      for (const auto* pindex : w.attach)
-        SendUpdatesOneBlock (w.trackedGames,
-                             ZMQGameBlocksNotifier::PREFIX_ATTACH,
-                             w.reqtoken, pindex);
-      LogPrint (BCLog::GAME, "Finished processing sendupdates: %s\n",
-                w.str ().c_str ());
+      /* Once a step is ready, it is not touched by anyone but us anymore,
+         so that we can send it without holding the lock.  The notifications
+         go through the notifier's publishing queue, so that they are ordered
+         with the ones triggered by validation.  */
+      if (step->data != nullptr)
+        for (const auto& game : req->w.trackedGames)
+          GetGameBlocksNotifier (game)->EnqueueBlockNotifications (
+              {game}, step->commandPrefix, req->w.reqtoken, step->data);
+
+      /* Release our reference to the data immediately, so that the memory
+         used by a request stays bounded by the read-ahead and the size
+         of the publishing queue.  */
+      step->data.reset ();
+
+      if (req->nextSend == req->steps.size ())
+        LogPrint (BCLog::GAME, "Finished processing sendupdates: %s\n",
+                  req->w.str ().c_str ());
     }
 #endif // ENABLE_ZMQ
 }
@@ -188,7 +352,15 @@ SendUpdatesWorker::enqueue (Work&& w)
     }
 
   LogPrint (BCLog::GAME, "Enqueueing for sendupdates: %s\n", w.str ().c_str ());
-  work.push (std::move (w));
+  auto req = std::make_shared<Request> (std::move (w));
+  if (req->steps.empty ())
+    {
+      LogPrint (BCLog::GAME, "Finished processing sendupdates: %s\n",
+                req->w.str ().c_str ());
+      return;
+    }
+
+  requests.push_back (std::move (req));
   cvWork.notify_all ();
 }
 
@@ -329,7 +501,7 @@ game_sendupdates (const JSONRPCRequest& request)
   steps.pushKV ("attach", static_cast<int64_t> (w.attach.size ()));
   result.pushKV ("steps", steps);
 
-  GetGameBlocksNotifier ();
+  GetGameBlocksNotifier (request.params[0].get_str ());
 
   assert (g_send_updates_worker != nullptr);
   g_send_updates_worker->enqueue (std::move (w));
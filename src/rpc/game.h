@@ -8,13 +8,14 @@
 #include <sync.h>
 
 #include <condition_variable>
+#include <list>
 #include <memory>
-#include <queue>
 #include <set>
 #include <string>
 #include <thread>
 #include <vector>
 
+class BlockGameMoves;
 class CBlockIndex;
 
 /**
@@ -24,9 +25,26 @@ class CBlockIndex;
 static constexpr unsigned DEFAULT_MAX_GAME_BLOCK_ATTACHES = 1000;
 
 /**
- * The worker for game_sendupdates.  It maintains a queue of work items to
- * process and has a thread that reads the items and performs the work.  It is
- * exposed publicly so that init.cpp can start/interrupt/stop as necessary.
+ * Default value for -sendupdatesthreads, which is the number of threads
+ * that read and parse blocks for game_sendupdates.
+ */
+static constexpr int DEFAULT_SENDUPDATES_THREADS = 2;
+
+/**
+ * Default value for -sendupdatesreadahead, which is the maximum number of
+ * blocks per game_sendupdates request that are prepared ahead of the
+ * notification currently being sent.
+ */
+static constexpr int DEFAULT_SENDUPDATES_READAHEAD = 64;
+
+/**
+ * The worker for game_sendupdates.  It maintains a list of active requests
+ * and processes them as a pipeline:  A pool of reader threads loads and
+ * parses the blocks of all requests ahead of time (bounded by the read-ahead
+ * limit), while a publisher thread sends the notifications for each request
+ * in order.  Multiple requests are serviced in a round-robin fashion.  The
+ * worker is exposed publicly so that init.cpp can start/interrupt/stop
+ * as necessary.
  */
 class SendUpdatesWorker
 {
@@ -54,19 +72,75 @@ public:
 
 private:
 
-  std::queue<Work> work;
-  bool interrupted;
+  /**
+   * A single notification that should be sent for a request.
+   */
+  struct Step
+  {
+
+    /** The command prefix (attach or detach).  */
+    const char* commandPrefix;
+
+    /** The block for which to send the notification.  */
+    const CBlockIndex* pindex;
+
+    /** Set to true when the block data has been loaded (or failed to).  */
+    bool ready = false;
+
+    /** The loaded data.  May be null if loading failed.  */
+    std::shared_ptr<const BlockGameMoves> data;
+
+    Step (const char* prefix, const CBlockIndex* idx)
+      : commandPrefix(prefix), pindex(idx)
+    {}
+
+  };
+
+  /**
+   * An active request with its processing state.
+   */
+  struct Request
+  {
+
+    Work w;
+
+    /** All steps (detaches followed by attaches) in order.  */
+    std::vector<Step> steps;
+
+    /** Index of the next step to be sent by the publisher.  */
+    size_t nextSend = 0;
+
+    /** Index of the next step to be loaded by a reader.  */
+    size_t nextRead = 0;
+
+    explicit Request (Work&& wrk);
+
+  };
 
   Mutex csWork;
   std::condition_variable cvWork;
 
+  /** Active requests in the order in which they are serviced.  */
+  std::list<std::shared_ptr<Request>> requests GUARDED_BY (csWork);
+  bool interrupted GUARDED_BY (csWork);
+
+  /** Maximum number of steps per request loaded ahead of sending.  */
+  const size_t readAhead;
+
   std::unique_ptr<std::thread> runner;
+  std::vector<std::thread> readers;
 
+  /** Main function of the publisher thread.  */
   static void run (SendUpdatesWorker& self);
 
+  /** Main function of the reader threads.  */
+  static void runReader (SendUpdatesWorker& self);
+
 public:
 
-  SendUpdatesWorker ();
+  explicit SendUpdatesWorker (
+      int numThreads = DEFAULT_SENDUPDATES_THREADS,
+      int readAheadBlocks = DEFAULT_SENDUPDATES_READAHEAD);
   ~SendUpdatesWorker ();
 
   SendUpdatesWorker (const SendUpdatesWorker&) = delete;
@@ -143,6 +143,36 @@ powAlgoFromJson (const UniValue& algoJson)
     }
 }
 
+/**
+ * Searches for a nonce of the fake header that satisfies the neoscrypt PoW,
+ * like the loop for other algos in generateBlocks but trying several nonces
+ * at once with the multi-way neoscrypt implementation.
+ */
+static void MineNeoscrypt(const PowData& pow, CPureBlockHeader& hdr, uint64_t& nMaxTries)
+{
+    constexpr uint64_t BATCH_SIZE = 8;
+    constexpr uint32_t MAX_NONCE = std::numeric_limits<uint32_t>::max();
+
+    std::vector<CPureBlockHeader> batch;
+    while (nMaxTries > 0 && hdr.nNonce < MAX_NONCE && !ShutdownRequested()) {
+        const uint64_t n = std::min(std::min(BATCH_SIZE, nMaxTries), static_cast<uint64_t>(MAX_NONCE - hdr.nNonce));
+        batch.assign(n, hdr);
+        for (uint64_t i = 0; i < n; ++i) {
+            batch[i].nNonce += i;
+        }
+        const std::vector<uint256> hashes = GetNeoscryptPowHashes(batch);
+        for (uint64_t i = 0; i < n; ++i) {
+            if (pow.checkPowHash(hashes[i], Params().GetConsensus())) {
+                hdr.nNonce = batch[i].nNonce;
+                nMaxTries -= i;
+                return;
+            }
+        }
+        hdr.nNonce += n;
+        nMaxTries -= n;
+    }
+}
+
 static UniValue generateBlocks(const CScript& coinbase_script, int nGenerate, uint64_t nMaxTries, const UniValue& algoJson)
 {
     int nHeightEnd = 0;
@@ -180,6 +210,8 @@ static UniValue generateBlocks(const CScript& coinbase_script, int nGenerate, ui
             throw JSONRPCError(RPC_INTERNAL_ERROR, "Unknown PoW algo");
         }
         assert (pfakeHeader != nullptr);
+        if (algo == PowAlgo::NEOSCRYPT)
+            MineNeoscrypt(pblock->pow, *pfakeHeader, nMaxTries);
         while (nMaxTries > 0 && pfakeHeader->nNonce < std::numeric_limits<uint32_t>::max() && !pblock->pow.checkProofOfWork(*pfakeHeader, Params().GetConsensus()) && !ShutdownRequested()) {
             ++pfakeHeader->nNonce;
             --nMaxTries;
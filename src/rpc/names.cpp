@@ -9,10 +9,13 @@
 #include <key_io.h>
 #include <names/common.h>
 #include <names/main.h>
+#include <names/readcache.h>
+#include <names/valuecache.h>
 #include <primitives/transaction.h>
 #include <rpc/names.h>
 #include <rpc/server.h>
 #include <script/names.h>
+#include <txdb.h>
 #include <txmempool.h>
 #include <util/strencodings.h>
 #include <validation.h>
@@ -167,6 +170,44 @@ DecodeValueFromRPCOrThrow (const UniValue& val, const UniValue& opt)
                                         ConfiguredValueEncoding ());
 }
 
+std::vector<std::shared_ptr<const CNameData>>
+LookupNames (const std::vector<valtype>& names)
+{
+  /* Process the names in the order in which they are stored in the
+     database (by length first), so that the reads have good locality.
+     Duplicates are only looked up once.  */
+  std::vector<size_t> order(names.size ());
+  for (size_t i = 0; i < order.size (); ++i)
+    order[i] = i;
+  std::sort (order.begin (), order.end (),
+             [&names] (const size_t a, const size_t b)
+             {
+               if (names[a].size () != names[b].size ())
+                 return names[a].size () < names[b].size ();
+               return names[a] < names[b];
+             });
+
+  std::vector<std::shared_ptr<const CNameData>> res(names.size ());
+
+  LOCK (cs_main);
+  const auto& view = ::ChainstateActive ().CoinsTip ();
+  for (size_t i = 0; i < order.size (); ++i)
+    {
+      const size_t cur = order[i];
+      if (i > 0 && names[order[i - 1]] == names[cur])
+        {
+          res[cur] = res[order[i - 1]];
+          continue;
+        }
+
+      CNameData data;
+      if (view.GetName (names[cur], data))
+        res[cur] = std::make_shared<const CNameData> (std::move (data));
+    }
+
+  return res;
+}
+
 namespace
 {
 
@@ -443,15 +484,105 @@ name_show (const JSONRPCRequest& request)
 /* ************************************************************************** */
 
 UniValue
-name_history (const JSONRPCRequest& request)
+name_show_many (const JSONRPCRequest& request)
 {
   NameOptionsHelp optHelp;
   optHelp
       .withNameEncoding ()
       .withValueEncoding ();
 
+  RPCHelpMan ("name_show_many",
+      "\nLooks up the current data for multiple names at once.  This is the"
+      " same as calling name_show for each name, but all lookups are done"
+      " together.\n"
+      "\nThe result has one entry per requested name in the same order;"
+      " names that do not exist yield null.\n",
+      {
+          {"names", RPCArg::Type::ARR, RPCArg::Optional::NO,
+           strprintf ("The names to query for (at most %d)",
+                      MAX_NAME_LOOKUP_BATCH),
+              {
+                  {"name", RPCArg::Type::STR, RPCArg::Optional::OMITTED, "A name"},
+              }},
+          optHelp.buildRpcArg (),
+      },
+      RPCResult {
+        "[\n"
+        + NameInfoHelp ("  ")
+            .withHeight ()
+            .finish (",") +
+        "  ...\n"
+        "]\n"
+      },
+      RPCExamples {
+          HelpExampleCli ("name_show_many", "'[\"myname\", \"othername\"]'")
+        + HelpExampleRpc ("name_show_many", "[\"myname\", \"othername\"]")
+      }
+  ).Check (request);
+
+  RPCTypeCheck (request.params, {UniValue::VARR, UniValue::VOBJ});
+
+  if (::ChainstateActive ().IsInitialBlockDownload ())
+    throw JSONRPCError(RPC_CLIENT_IN_INITIAL_DOWNLOAD,
+                       "Xaya is downloading blocks...");
+
+  UniValue options(UniValue::VOBJ);
+  if (request.params.size () >= 2)
+    options = request.params[1].get_obj ();
+
+  const UniValue& namesArr = request.params[0].get_array ();
+  if (namesArr.size () > MAX_NAME_LOOKUP_BATCH)
+    throw JSONRPCError (RPC_INVALID_PARAMETER,
+                        strprintf ("at most %d names can be looked up at once",
+                                   MAX_NAME_LOOKUP_BATCH));
+
+  std::vector<valtype> names;
+  names.reserve (namesArr.size ());
+  for (const auto& n : namesArr.getValues ())
+    {
+      if (!n.isStr ())
+        throw JSONRPCError (RPC_TYPE_ERROR, "names must be strings");
+      names.push_back (DecodeNameFromRPCOrThrow (n, options));
+    }
+
+  const auto found = LookupNames (names);
+  assert (found.size () == names.size ());
+
+  MaybeWalletForRequest wallet(request);
+  LOCK (wallet.getLock ());
+
+  UniValue res(UniValue::VARR);
+  for (size_t i = 0; i < names.size (); ++i)
+    {
+      if (found[i] == nullptr)
+        res.push_back (NullUniValue);
+      else
+        res.push_back (getNameInfo (options, names[i], *found[i], wallet));
+    }
+
+  return res;
+}
+
+/* ************************************************************************** */
+
+UniValue
+name_history (const JSONRPCRequest& request)
+{
+  NameOptionsHelp optHelp;
+  optHelp
+      .withNameEncoding ()
+      .withValueEncoding ()
+      .withArg ("start", RPCArg::Type::NUM, "0",
+                "Skip this many entries at the beginning")
+      .withArg ("count", RPCArg::Type::NUM, "all",
+                "Return at most this many entries")
+      .withArg ("reverse", RPCArg::Type::BOOL, "false",
+                "Return the newest entries first");
+
   RPCHelpMan ("name_history",
-      "\nLooks up the current and all past data for the given name.  -namehistory must be enabled.\n",
+      "\nLooks up the current and all past data for the given name.  -namehistory must be enabled.\n"
+      "\nThe entries are returned from oldest to newest (or the other way round with reverse)."
+      "  start and count can be used to page through long histories.\n",
       {
           {"name", RPCArg::Type::STR, RPCArg::Optional::NO, "The name to query for"},
           optHelp.buildRpcArg (),
@@ -486,13 +617,45 @@ name_history (const JSONRPCRequest& request)
   const valtype name
       = DecodeNameFromRPCOrThrow (request.params[0], options);
 
-  CNameData data;
-  CNameHistory history;
+  RPCTypeCheckObj (options,
+    {
+      {"start", UniValueType (UniValue::VNUM)},
+      {"count", UniValueType (UniValue::VNUM)},
+      {"reverse", UniValueType (UniValue::VBOOL)},
+    },
+    true, false);
+
+  int64_t start = 0;
+  if (options.exists ("start"))
+    {
+      start = options["start"].get_int64 ();
+      if (start < 0)
+        throw JSONRPCError (RPC_INVALID_PARAMETER,
+                            "start must not be negative");
+    }
+
+  int64_t count = -1;
+  if (options.exists ("count"))
+    {
+      count = options["count"].get_int64 ();
+      if (count < 0)
+        throw JSONRPCError (RPC_INVALID_PARAMETER,
+                            "count must not be negative");
+    }
+
+  const bool reverse
+      = options.exists ("reverse") && options["reverse"].get_bool ();
+
+  /* The full list of entries consists of the history stack (oldest first)
+     and then the current data.  Only the requested page of it is read
+     from the database.  */
+  std::vector<CNameData> entries;
 
   {
     LOCK (cs_main);
 
     const auto& coinsTip = ::ChainstateActive ().CoinsTip ();
+    CNameData data;
     if (!coinsTip.GetName (name, data))
       {
         std::ostringstream msg;
@@ -500,17 +663,35 @@ name_history (const JSONRPCRequest& request)
         throw JSONRPCError (RPC_WALLET_ERROR, msg.str ());
       }
 
-    if (!coinsTip.GetNameHistory (name, history))
-      assert (history.empty ());
+    const int64_t historySize = coinsTip.GetNameHistorySize (name);
+    const int64_t total = historySize + 1;
+
+    int64_t end = total;
+    if (count >= 0 && start + count < total)
+      end = start + count;
+
+    for (int64_t pos = start; pos < end; ++pos)
+      {
+        const int64_t index = reverse ? total - 1 - pos : pos;
+        if (index == historySize)
+          entries.push_back (data);
+        else
+          {
+            CNameData entry;
+            if (!coinsTip.GetNameHistoryEntry (name, index, entry))
+              throw JSONRPCError (RPC_DATABASE_ERROR,
+                                  "failed to read name history");
+            entries.push_back (std::move (entry));
+          }
+      }
   }
 
   MaybeWalletForRequest wallet(request);
   LOCK (wallet.getLock ());
 
   UniValue res(UniValue::VARR);
-  for (const auto& entry : history.getData ())
+  for (const auto& entry : entries)
     res.push_back (getNameInfo (options, name, entry, wallet));
-  res.push_back (getNameInfo (options, name, data, wallet));
 
   return res;
 }
@@ -531,10 +712,19 @@ name_scan (const JSONRPCRequest& request)
       .withArg ("prefix", RPCArg::Type::STR,
                 "Filter for names with the given prefix")
       .withArg ("regexp", RPCArg::Type::STR,
-                "Filter for names matching the regexp");
+                "Filter for names matching the regexp")
+      .withArg ("withBlock", RPCArg::Type::BOOL, "false",
+                "Return an object with the block the result is for");
 
   RPCHelpMan ("name_scan",
-      "\nLists names in the database.\n",
+      "\nLists names in the database.\n"
+      "\nIf -namescanindex is enabled and a prefix is given, the index is used"
+      " to look up only matching names.  In that case, the names are returned"
+      " in byte-wise lexicographic order instead of ordered by length first.\n"
+      "\nThe scan runs on a snapshot of the name database and does not block"
+      " the processing of new blocks.  With the withBlock option, the result"
+      " is an object with fields \"hash\" and \"height\" of the block the"
+      " scan is consistent with and \"names\" holding the array below.\n",
       {
           {"start", RPCArg::Type::STR, "", "Skip initially to this name"},
           {"count", RPCArg::Type::NUM, "500", "Stop after this many names"},
@@ -582,6 +772,7 @@ name_scan (const JSONRPCRequest& request)
       {"maxConf", UniValueType (UniValue::VNUM)},
       {"prefix", UniValueType (UniValue::VSTR)},
       {"regexp", UniValueType (UniValue::VSTR)},
+      {"withBlock", UniValueType (UniValue::VBOOL)},
     },
     true, false);
 
@@ -612,36 +803,87 @@ name_scan (const JSONRPCRequest& request)
       regexp = boost::xpressive::sregex::compile (options["regexp"].get_str ());
     }
 
+  const bool withBlock
+      = options.exists ("withBlock") && options["withBlock"].get_bool ();
+
+  /* Take a snapshot of the name database together with the not-yet-flushed
+     changes in the coins cache.  Only this needs cs_main; the actual scan
+     below runs without it and sees the state as of the current tip.  */
+  std::unique_ptr<CCoinsViewDBSnapshot> dbSnapshot;
+  CNameCache cachedNames;
+  int tipHeight;
+  uint256 tipHash;
+  {
+    LOCK (cs_main);
+    const CBlockIndex* tip = ::ChainActive ().Tip ();
+    tipHeight = tip->nHeight;
+    tipHash = tip->GetBlockHash ();
+    dbSnapshot = ::ChainstateActive ().CoinsDB ().GetSnapshot ();
+    cachedNames = ::ChainstateActive ().CoinsTip ().GetNameCache ();
+  }
+
   /* Iterate over names and produce the result.  */
   UniValue res(UniValue::VARR);
+  const auto finishResult = [&] ()
+    {
+      if (!withBlock)
+        return res;
+
+      UniValue obj(UniValue::VOBJ);
+      obj.pushKV ("hash", tipHash.GetHex ());
+      obj.pushKV ("height", tipHeight);
+      obj.pushKV ("names", res);
+      return obj;
+    };
   if (count <= 0)
-    return res;
+    return finishResult ();
 
   MaybeWalletForRequest wallet(request);
-  LOCK2 (cs_main, wallet.getLock ());
+  LOCK (wallet.getLock ());
 
-  const int maxHeight = ::ChainActive ().Height () - minConf + 1;
+  const int maxHeight = tipHeight - minConf + 1;
   int minHeight = -1;
   if (maxConf >= 0)
-    minHeight = ::ChainActive ().Height () - maxConf + 1;
+    minHeight = tipHeight - maxConf + 1;
+
+  /* With the lexicographic index, all names matching the prefix are
+     in one contiguous range.  We can seek directly to its beginning
+     and stop as soon as we leave it.  */
+  const bool useScanIndex = fNameScanIndex && !prefix.empty ();
 
   valtype name;
   CNameData data;
-  const auto& coinsTip = ::ChainstateActive ().CoinsTip ();
-  std::unique_ptr<CNameIterator> iter(coinsTip.IterateNames ());
-  for (iter->seek (start); count > 0 && iter->next (name, data); )
+  std::unique_ptr<CNameIterator> iter;
+  if (useScanIndex)
+    {
+      iter.reset (cachedNames.iterateNamesLexicographic (
+          dbSnapshot->IterateNamesLexicographic ()));
+      iter->seek (std::max (start, prefix));
+    }
+  else
+    {
+      iter.reset (cachedNames.iterateNames (dbSnapshot->IterateNames ()));
+      iter->seek (start);
+    }
+
+  while (count > 0 && iter->next (name, data))
     {
+      const bool hasPrefix
+          = name.size () >= prefix.size ()
+              && std::equal (prefix.begin (), prefix.end (), name.begin ());
+      if (!hasPrefix)
+        {
+          if (useScanIndex)
+            break;
+          continue;
+        }
+
       const int height = data.getHeight ();
       if (height > maxHeight)
         continue;
       if (minHeight >= 0 && height < minHeight)
         continue;
 
-      if (name.size () < prefix.size ())
-        continue;
-      if (!std::equal (prefix.begin (), prefix.end (), name.begin ()))
-        continue;
-
       if (haveRegexp)
         {
           try
@@ -661,7 +903,7 @@ name_scan (const JSONRPCRequest& request)
       --count;
     }
 
-  return res;
+  return finishResult ();
 }
 
 /* ************************************************************************** */
@@ -676,7 +918,9 @@ name_pending (const JSONRPCRequest& request)
 
   RPCHelpMan ("name_pending",
       "\nLists unconfirmed name operations in the mempool.\n"
-      "\nIf a name is given, only check for operations on this name.\n",
+      "\nIf a name is given, only check for operations on this name.\n"
+      "\nThe operations are sorted by name, and for each name in the order"
+      " in which they are chained.\n",
       {
           {"name", RPCArg::Type::STR, RPCArg::Optional::OMITTED_NAMED_ARG, "Only look for this name"},
           optHelp.buildRpcArg (),
@@ -706,36 +950,22 @@ name_pending (const JSONRPCRequest& request)
   if (request.params.size () >= 2)
     options = request.params[1].get_obj ();
 
-  std::vector<uint256> txHashes;
-  mempool.queryHashes (txHashes);
-
   const bool hasNameFilter = !request.params[0].isNull ();
   valtype nameFilter;
   if (hasNameFilter)
     nameFilter = DecodeNameFromRPCOrThrow (request.params[0], options);
 
   UniValue arr(UniValue::VARR);
-  for (const auto& txHash : txHashes)
+  const auto addOperations
+      = [&] (const valtype& name,
+             const CNameMemPool::PendingOperations& ops)
     {
-      std::shared_ptr<const CTransaction> tx = mempool.get (txHash);
-      if (!tx)
-        continue;
-
-      for (size_t n = 0; n < tx->vout.size (); ++n)
+      for (const auto& op : ops)
         {
-          const auto& txOut = tx->vout[n];
-          const CNameScript op(txOut.scriptPubKey);
-          if (!op.isNameOp () || !op.isAnyUpdate ())
-            continue;
-          if (hasNameFilter && op.getOpName () != nameFilter)
-            continue;
-
-          UniValue obj = getNameInfo (options,
-                                      op.getOpName (), op.getOpValue (),
-                                      COutPoint (tx->GetHash (), n),
-                                      op.getAddress ());
-          addOwnershipInfo (op.getAddress (), wallet, obj);
-          switch (op.getNameOp ())
+          UniValue obj = getNameInfo (options, name, op.value, op.outpoint,
+                                      op.address);
+          addOwnershipInfo (op.address, wallet, obj);
+          switch (op.op)
             {
             case OP_NAME_REGISTER:
               obj.pushKV ("op", "name_register");
@@ -749,6 +979,20 @@ name_pending (const JSONRPCRequest& request)
 
           arr.push_back (obj);
         }
+    };
+
+  /* The name mempool keeps the decoded pending operations by name, so that
+     we neither have to look at all mempool transactions nor decode
+     their scripts here.  */
+  if (hasNameFilter)
+    addOperations (nameFilter, mempool.getPendingNameOperations (nameFilter));
+  else
+    {
+      /* The name mempool is a hash map, so sort the names explicitly.  */
+      std::vector<valtype> names = mempool.getPendingNames ();
+      std::sort (names.begin (), names.end ());
+      for (const auto& name : names)
+        addOperations (name, mempool.getPendingNameOperations (name));
     }
 
   return arr;
@@ -835,6 +1079,79 @@ namerawtransaction (const JSONRPCRequest& request)
 
 /* ************************************************************************** */
 
+UniValue
+name_valuecacheinfo (const JSONRPCRequest& request)
+{
+  RPCHelpMan ("name_valuecacheinfo",
+      "\nReturns statistics about the cache of parsed name values.\n",
+      {},
+      RPCResult {
+        "{\n"
+        "  \"size\": xxx,       (numeric) number of cached values\n"
+        "  \"usage\": xxx,      (numeric) memory used by the cached values in bytes\n"
+        "  \"maxusage\": xxx,   (numeric) maximum memory usage in bytes\n"
+        "  \"hits\": xxx,       (numeric) number of lookups that were found\n"
+        "  \"misses\": xxx,     (numeric) number of lookups that were not found\n"
+        "}\n"
+      },
+      RPCExamples {
+          HelpExampleCli ("name_valuecacheinfo", "")
+        + HelpExampleRpc ("name_valuecacheinfo", "")
+      }
+  ).Check (request);
+
+  const auto stats = GetNameValueCache ().GetStats ();
+
+  UniValue res(UniValue::VOBJ);
+  res.pushKV ("size", static_cast<uint64_t> (stats.size));
+  res.pushKV ("usage", static_cast<uint64_t> (stats.usage));
+  res.pushKV ("maxusage", static_cast<uint64_t> (stats.maxUsage));
+  res.pushKV ("hits", stats.hits);
+  res.pushKV ("misses", stats.misses);
+
+  return res;
+}
+
+UniValue
+name_readcacheinfo (const JSONRPCRequest& request)
+{
+  RPCHelpMan ("name_readcacheinfo",
+      "\nReturns statistics about the cache of name data read from the"
+      " database.\n",
+      {},
+      RPCResult {
+        "{\n"
+        "  \"size\": xxx,       (numeric) number of cached names\n"
+        "  \"usage\": xxx,      (numeric) memory used by the cached names in bytes\n"
+        "  \"maxusage\": xxx,   (numeric) maximum memory usage in bytes\n"
+        "  \"hits\": xxx,       (numeric) number of lookups that were found\n"
+        "  \"misses\": xxx,     (numeric) number of lookups that were not found\n"
+        "}\n"
+      },
+      RPCExamples {
+          HelpExampleCli ("name_readcacheinfo", "")
+        + HelpExampleRpc ("name_readcacheinfo", "")
+      }
+  ).Check (request);
+
+  NameReadCache::Stats stats;
+  {
+    LOCK (cs_main);
+    stats = ::ChainstateActive ().CoinsDB ().GetNameReadCacheStats ();
+  }
+
+  UniValue res(UniValue::VOBJ);
+  res.pushKV ("size", static_cast<uint64_t> (stats.size));
+  res.pushKV ("usage", static_cast<uint64_t> (stats.usage));
+  res.pushKV ("maxusage", static_cast<uint64_t> (stats.maxUsage));
+  res.pushKV ("hits", stats.hits);
+  res.pushKV ("misses", stats.misses);
+
+  return res;
+}
+
+/* ************************************************************************** */
+
 UniValue
 name_checkdb (const JSONRPCRequest& request)
 {
@@ -851,10 +1168,20 @@ name_checkdb (const JSONRPCRequest& request)
       }
   ).Check (request);
 
-  LOCK (cs_main);
-  auto& coinsTip = ::ChainstateActive ().CoinsTip ();
-  coinsTip.Flush ();
-  return coinsTip.ValidateNameDB ();
+  /* Flush the coins cache so that the database holds the full state, and
+     take a snapshot of it.  The (potentially long) check itself is then
+     done on the snapshot without holding cs_main.  */
+  std::unique_ptr<CCoinsViewDBSnapshot> snapshot;
+  uint256 tipHash;
+  {
+    LOCK (cs_main);
+    ::ChainstateActive ().CoinsTip ().Flush ();
+    snapshot = ::ChainstateActive ().CoinsDB ().GetSnapshot ();
+    tipHash = ::ChainActive ().Tip ()->GetBlockHash ();
+  }
+
+  LogPrintf ("Checking name database at block %s\n", tipHash.GetHex ());
+  return snapshot->ValidateNameDB ();
 }
 
 } // namespace
@@ -864,10 +1191,13 @@ static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         argNames
   //  --------------------- ------------------------  -----------------------  ----------
     { "names",              "name_show",              &name_show,              {"name","options"} },
+    { "names",              "name_show_many",         &name_show_many,         {"names","options"} },
     { "names",              "name_history",           &name_history,           {"name","options"} },
     { "names",              "name_scan",              &name_scan,              {"start","count","options"} },
     { "names",              "name_pending",           &name_pending,           {"name","options"} },
     { "names",              "name_checkdb",           &name_checkdb,           {} },
+    { "names",              "name_valuecacheinfo",    &name_valuecacheinfo,    {} },
+    { "names",              "name_readcacheinfo",     &name_readcacheinfo,     {} },
     { "rawtransactions",    "namerawtransaction",     &namerawtransaction,     {"hexstring","vout","nameop"} },
 };
 
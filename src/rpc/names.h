@@ -10,6 +10,7 @@
 #include <names/encoding.h>
 #include <rpc/util.h>
 
+#include <memory>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -49,6 +50,21 @@ valtype DecodeNameFromRPCOrThrow (const UniValue& val, const UniValue& opt);
  */
 valtype DecodeValueFromRPCOrThrow (const UniValue& val, const UniValue& opt);
 
+/**
+ * Maximum number of names that can be looked up in a single batch
+ * with name_show_many or the /rest/names endpoint.
+ */
+static constexpr size_t MAX_NAME_LOOKUP_BATCH = 1000;
+
+/**
+ * Looks up the current data of multiple names in the chain state.  All
+ * lookups are done under a single lock of cs_main, in the order in which
+ * the names are stored in the database.  The result has one entry for each
+ * requested name, which is null if the name does not exist.
+ */
+std::vector<std::shared_ptr<const CNameData>>
+LookupNames (const std::vector<valtype>& names);
+
 /**
  * Builder class for help texts describing JSON objects that share a common
  * part between multiple RPCs but also have specialised fields per RPC.
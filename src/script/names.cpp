@@ -6,52 +6,94 @@
 
 #include <uint256.h>
 
-CNameScript::CNameScript (const CScript& script)
-  : op(OP_NOP), address(script)
+namespace
+{
+
+/**
+ * Returns the data pushed by the operation between start and end, which
+ * has already been verified to be a push operation with the given opcode.
+ */
+Span<const unsigned char>
+GetPushedData (const CScript& script, const CScript::const_iterator start,
+               const CScript::const_iterator end, const opcodetype opcode)
 {
-  opcodetype nameOp;
-  CScript::const_iterator pc = script.begin ();
-  if (!script.GetOp (pc, nameOp))
+  size_t header;
+  if (opcode < OP_PUSHDATA1)
+    header = 1;
+  else if (opcode == OP_PUSHDATA1)
+    header = 2;
+  else if (opcode == OP_PUSHDATA2)
+    header = 3;
+  else
+    header = 5;
+
+  const size_t offset = (start - script.begin ()) + header;
+  const size_t size = (end - start) - header;
+  return Span<const unsigned char> (script.data () + offset, size);
+}
+
+} // anonymous namespace
+
+CNameScriptView::CNameScriptView (const CScript& s)
+  : script(&s), op(OP_NOP), addressOffset(0)
+{
+  /* Name operations are identified by their first opcode, which is a single
+     byte.  Check that first, so that ordinary scripts are rejected without
+     parsing them at all.  */
+  if (s.empty () || (s[0] != OP_NAME_REGISTER && s[0] != OP_NAME_UPDATE))
     return;
 
+  CScript::const_iterator pc = s.begin () + 1;
+  Span<const unsigned char> args[2];
+  size_t numArgs = 0;
+
   opcodetype opcode;
   while (true)
     {
-      valtype vch;
-
-      if (!script.GetOp (pc, opcode, vch))
+      const CScript::const_iterator start = pc;
+      if (!s.GetOp (pc, opcode))
         return;
       if (opcode == OP_DROP || opcode == OP_2DROP || opcode == OP_NOP)
         break;
       if (!(opcode >= 0 && opcode <= OP_PUSHDATA4))
         return;
 
-      args.push_back (vch);
+      /* Both name operations have exactly two arguments.  */
+      if (numArgs == 2)
+        return;
+      args[numArgs++] = GetPushedData (s, start, pc, opcode);
     }
+  if (numArgs != 2)
+    return;
 
   // Move the pc to after any DROP or NOP.
   while (opcode == OP_DROP || opcode == OP_2DROP || opcode == OP_NOP)
-    if (!script.GetOp (pc, opcode))
+    if (!s.GetOp (pc, opcode))
       break;
   pc--;
 
-  /* Now, we have the args and the operation.  Check if we have indeed
-     a valid name operation and valid argument counts.  Only now set the
-     op and address members, if everything is valid.  */
-  switch (nameOp)
-    {
-    case OP_NAME_REGISTER:
-    case OP_NAME_UPDATE:
-      if (args.size () != 2)
-        return;
-      break;
+  op = static_cast<opcodetype> (s[0]);
+  name = args[0];
+  value = args[1];
+  addressOffset = pc - s.begin ();
+}
 
-    default:
-      return;
-    }
+CNameScript::CNameScript (const CScript& script)
+  : CNameScript (CNameScriptView (script))
+{}
+
+CNameScript::CNameScript (const CNameScriptView& view)
+  : op(OP_NOP), address(view.getAddress ())
+{
+  if (!view.isNameOp ())
+    return;
+
+  const auto name = view.getOpName ();
+  const auto value = view.getOpValue ();
+  args.emplace_back (name.begin (), name.end ());
+  args.emplace_back (value.begin (), value.end ());
 
-  op = nameOp;
-  address = CScript (pc, script.end ());
+  op = view.getNameOp ();
 }
 
 CScript
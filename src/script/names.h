@@ -6,9 +6,105 @@
 #define H_BITCOIN_SCRIPT_NAMES
 
 #include <script/script.h>
+#include <span.h>
 
 class uint160;
 
+/**
+ * A light-weight view of a script for name operations.  It determines
+ * exactly the same as CNameScript, but does not copy the address script or
+ * the operation arguments.  Instead, the arguments are referenced as slices
+ * of the underlying script, which must outlive the view.  Scripts that do not
+ * start with a name opcode (i. e., all currency outputs) are rejected after
+ * looking only at their first byte.
+ *
+ * This is meant for hot loops that only need to find the name outputs
+ * of transactions (or look at their name).
+ */
+class CNameScriptView
+{
+
+private:
+
+  /** The underlying script.  */
+  const CScript* script;
+
+  /** The type of operation.  OP_NOP if no (valid) name op.  */
+  opcodetype op;
+
+  /** Offset of the address part in the script.  */
+  size_t addressOffset;
+
+  /** The name argument.  */
+  Span<const unsigned char> name;
+
+  /** The value argument.  */
+  Span<const unsigned char> value;
+
+public:
+
+  /**
+   * Parse a script and determine whether it is a valid name script.
+   * @param s The ordinary script to parse.  It must outlive the view.
+   */
+  explicit CNameScriptView (const CScript& s);
+
+  /**
+   * Return whether this is a (valid) name script.
+   * @return True iff this is a name operation.
+   */
+  inline bool
+  isNameOp () const
+  {
+    return op != OP_NOP;
+  }
+
+  /**
+   * Return the name operation.  Do not call if this is not a name script.
+   * @return The name operation opcode.
+   */
+  inline opcodetype
+  getNameOp () const
+  {
+    assert (isNameOp ());
+    return op;
+  }
+
+  /**
+   * Return the name operation's name as slice of the script.
+   * @return The name operation's name.
+   */
+  inline Span<const unsigned char>
+  getOpName () const
+  {
+    assert (isNameOp ());
+    return name;
+  }
+
+  /**
+   * Return the name operation's value as slice of the script.
+   * @return The name operation's value.
+   */
+  inline Span<const unsigned char>
+  getOpValue () const
+  {
+    assert (isNameOp ());
+    return value;
+  }
+
+  /**
+   * Return the non-name script.  This copies the address into a new script,
+   * and returns the full script if this is not a name operation.
+   * @return The address part.
+   */
+  inline CScript
+  getAddress () const
+  {
+    return CScript (script->begin () + addressOffset, script->end ());
+  }
+
+};
+
 /**
  * A script parsed for name operations.  This can be initialised
  * from a "standard" script, and will then determine if this is
@@ -45,6 +141,13 @@ public:
    */
   explicit CNameScript (const CScript& script);
 
+  /**
+   * Construct the name script from an already parsed view, without
+   * parsing the script again.
+   * @param view The parsed script.
+   */
+  explicit CNameScript (const CNameScriptView& view);
+
   /**
    * Return whether this is a (valid) name script.
    * @return True iff this is a name operation.
@@ -160,7 +263,7 @@ public:
   static inline bool
   isNameScript (const CScript& script)
   {
-    const CNameScript op(script);
+    const CNameScriptView op(script);
     return op.isNameOp ();
   }
 
@@ -204,7 +204,9 @@ bool CScript::IsPayToScriptHash(bool allowNames) const
                 (*this)[22] == OP_EQUAL);
 
     // Strip off a name prefix if present.
-    const CNameScript nameOp(*this);
+    const CNameScriptView nameOp(*this);
+    if (!nameOp.isNameOp())
+        return IsPayToScriptHash(false);
     return nameOp.getAddress().IsPayToScriptHash(false);
 }
 
@@ -217,7 +219,9 @@ bool CScript::IsPayToWitnessScriptHash(bool allowNames) const
                 (*this)[1] == 0x20);
 
     // Strip off a name prefix if present.
-    const CNameScript nameOp(*this);
+    const CNameScriptView nameOp(*this);
+    if (!nameOp.isNameOp())
+        return IsPayToWitnessScriptHash(false);
     return nameOp.getAddress().IsPayToWitnessScriptHash(false);
 }
 
@@ -228,8 +232,9 @@ bool CScript::IsWitnessProgram(const bool allowNames, int& version, std::vector<
     // Strip off a name prefix if present.
     if (allowNames)
       {
-        const CNameScript nameOp(*this);
-        return nameOp.getAddress().IsWitnessProgram(false, version, program);
+        const CNameScriptView nameOp(*this);
+        if (nameOp.isNameOp())
+            return nameOp.getAddress().IsWitnessProgram(false, version, program);
       }
 
     // Handle the case without name prefix.
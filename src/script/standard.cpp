@@ -91,9 +91,12 @@ txnouttype Solver(const CScript& scriptPubKey, std::vector<std::vector<unsigned
 {
     vSolutionsRet.clear();
 
-    // If we have a name script, strip the prefix
-    const CNameScript nameOp(scriptPubKey);
-    const CScript& script = nameOp.getAddress();
+    // If we have a name script, solve its address part instead.  Ordinary
+    // scripts are used as they are, without copying them.
+    const CNameScriptView nameOp(scriptPubKey);
+    if (nameOp.isNameOp())
+        return Solver(nameOp.getAddress(), vSolutionsRet);
+    const CScript& script = scriptPubKey;
 
     // Shortcut for pay-to-script-hash, which are more constrained than the other types:
     // it is always OP_HASH160 20 [20 byte hash] OP_EQUAL
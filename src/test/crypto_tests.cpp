@@ -9,6 +9,8 @@
 #include <crypto/hkdf_sha256_32.h>
 #include <crypto/hmac_sha256.h>
 #include <crypto/hmac_sha512.h>
+#include <crypto/neoscrypt.h>
+#include <crypto/neoscrypt_multi.h>
 #include <crypto/ripemd160.h>
 #include <crypto/sha1.h>
 #include <crypto/sha256.h>
@@ -749,4 +751,32 @@ BOOST_AUTO_TEST_CASE(sha256d64)
     }
 }
 
+BOOST_AUTO_TEST_CASE(neoscrypt_testvector)
+{
+    unsigned char in[80];
+    for (int i = 0; i < 80; ++i) {
+        in[i] = i;
+    }
+    unsigned char out[32];
+    neoscrypt(in, out, 0);
+    BOOST_CHECK_EQUAL(HexStr(out, out + 32), "7258961afb33fd12d00cacb8d63f4f4f52bb6917043865dd24a08f578853122d");
+}
+
+BOOST_AUTO_TEST_CASE(neoscrypt_multi)
+{
+    // Cover the 8-way, 4-way and scalar paths as well as their combinations.
+    for (int i = 0; i <= 16; ++i) {
+        unsigned char in[80 * 16];
+        unsigned char out1[32 * 16], out2[32 * 16];
+        for (int j = 0; j < 80 * i; ++j) {
+            in[j] = InsecureRandBits(8);
+        }
+        for (int j = 0; j < i; ++j) {
+            neoscrypt(in + 80 * j, out1 + 32 * j, 0);
+        }
+        NeoscryptMulti(out2, in, i);
+        BOOST_CHECK(memcmp(out1, out2, 32 * i) == 0);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -119,6 +119,47 @@ BOOST_AUTO_TEST_CASE(dbwrapper_iterator)
     }
 }
 
+BOOST_AUTO_TEST_CASE(dbwrapper_snapshot)
+{
+    // Perform tests both obfuscated and non-obfuscated.
+    for (const bool obfuscate : {false, true}) {
+        fs::path ph = GetDataDir() / (obfuscate ? "dbwrapper_snapshot_obfuscate_true" : "dbwrapper_snapshot_obfuscate_false");
+        CDBWrapper dbw(ph, (1 << 20), true, false, obfuscate);
+
+        char key = 'j';
+        uint256 in = InsecureRand256();
+        BOOST_CHECK(dbw.Write(key, in));
+
+        CDBSnapshot snapshot(dbw);
+
+        // Changes after the snapshot was taken are not visible in it.
+        char key2 = 'k';
+        uint256 in2 = InsecureRand256();
+        BOOST_CHECK(dbw.Write(key2, in2));
+        BOOST_CHECK(dbw.Write(key, in2));
+
+        uint256 res;
+        BOOST_CHECK(snapshot.Read(key, res));
+        BOOST_CHECK_EQUAL(res.ToString(), in.ToString());
+        BOOST_CHECK(!snapshot.Read(key2, res));
+        BOOST_CHECK(dbw.Read(key, res));
+        BOOST_CHECK_EQUAL(res.ToString(), in2.ToString());
+
+        std::unique_ptr<CDBIterator> it(snapshot.NewIterator());
+        it->Seek(key);
+
+        char key_res;
+        uint256 val_res;
+        BOOST_REQUIRE(it->GetKey(key_res));
+        BOOST_REQUIRE(it->GetValue(val_res));
+        BOOST_CHECK_EQUAL(key_res, key);
+        BOOST_CHECK_EQUAL(val_res.ToString(), in.ToString());
+
+        it->Next();
+        BOOST_CHECK_EQUAL(it->Valid(), false);
+    }
+}
+
 // Test that we do not obfuscation if there is existing data.
 BOOST_AUTO_TEST_CASE(existing_data_no_obfuscate)
 {
@@ -2,12 +2,14 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <arith_uint256.h>
 #include <chain.h>
 #include <chainparams.h>
 #include <consensus/params.h>
 #include <pow.h>
 #include <powdata.h>
 #include <test/setup_common.h>
+#include <validation.h>
 
 #include <boost/test/unit_test.hpp>
 
@@ -108,6 +110,7 @@ public:
     std::unique_ptr<CBlockIndex> modified(new CBlockIndex (indexNew));
     modified->pprev = tip ();
     modified->nHeight = blocks.size ();
+    modified->BuildSkip ();
     blocks.push_back (std::move (modified));
   }
 
@@ -179,6 +182,135 @@ BOOST_AUTO_TEST_CASE (difficulty_retargeting)
     }
 }
 
+BOOST_AUTO_TEST_CASE (ancestor_with_algo)
+{
+  /* Construct a chain with long stretches of a single algo (and a start
+     with only one of them) and compare the per-algo predecessor lookups
+     to walking the chain one block at a time.  */
+  TestChain chain;
+  for (unsigned len = 0; len < 1000; ++len)
+    {
+      CBlockIndex indexNew;
+      if (len < 100 || (len / 200) % 2 == 1)
+        indexNew.algo = PowAlgo::NEOSCRYPT;
+      else if (InsecureRandBool ())
+        indexNew.algo = PowAlgo::SHA256D;
+      else
+        indexNew.algo = PowAlgo::NEOSCRYPT;
+      chain.attach (indexNew);
+    }
+
+  for (const CBlockIndex* pindex = chain.tip (); pindex != nullptr;
+       pindex = pindex->pprev)
+    for (const PowAlgo algo : {PowAlgo::SHA256D, PowAlgo::NEOSCRYPT})
+      {
+        const CBlockIndex* expected = pindex->pprev;
+        while (expected != nullptr && expected->algo != algo)
+          expected = expected->pprev;
+
+        BOOST_CHECK (pindex->GetPrevWithAlgo (algo) == expected);
+        if (pindex->algo == algo)
+          BOOST_CHECK (pindex->GetLastAncestorWithAlgo (algo) == pindex);
+        else
+          BOOST_CHECK (pindex->GetLastAncestorWithAlgo (algo) == expected);
+      }
+}
+
+BOOST_AUTO_TEST_CASE (next_work_cache)
+{
+  /* Build two forks from a common base with hashes set on all blocks, so
+     that the results of GetNextWorkRequired are cached.  Check that they
+     match the uncached computation on both forks, also when queried again
+     (as e.g. after a reorg back and forth).  */
+  const Consensus::Params& params = Params ().GetConsensus ();
+
+  constexpr unsigned BASE_LENGTH = 100;
+  constexpr unsigned FORK_LENGTH = 50;
+  std::vector<uint256> hashes;
+  hashes.reserve (BASE_LENGTH + 2 * FORK_LENGTH);
+  std::vector<std::unique_ptr<CBlockIndex>> blocks;
+
+  const auto attach = [&] (CBlockIndex* pprev)
+    {
+      std::unique_ptr<CBlockIndex> index(new CBlockIndex ());
+      index->pprev = pprev;
+      index->nHeight = pprev == nullptr ? 0 : pprev->nHeight + 1;
+      index->nTime = 1000000000 + 30 * index->nHeight
+                      + InsecureRandRange (20);
+      index->algo = InsecureRandBool () ? PowAlgo::SHA256D : PowAlgo::NEOSCRYPT;
+      index->nBits = CalculateNextWorkRequired (index->algo, pprev, params);
+      hashes.push_back (InsecureRand256 ());
+      index->phashBlock = &hashes.back ();
+      index->BuildSkip ();
+      blocks.push_back (std::move (index));
+      return blocks.back ().get ();
+    };
+
+  CBlockIndex* base = nullptr;
+  for (unsigned i = 0; i < BASE_LENGTH; ++i)
+    base = attach (base);
+  CBlockIndex* forkA = base;
+  CBlockIndex* forkB = base;
+  for (unsigned i = 0; i < FORK_LENGTH; ++i)
+    {
+      forkA = attach (forkA);
+      forkB = attach (forkB);
+    }
+
+  for (unsigned rounds = 0; rounds < 2; ++rounds)
+    for (const CBlockIndex* tip : {forkA, forkB, forkA})
+      for (const CBlockIndex* pindex = tip; pindex != nullptr;
+           pindex = pindex->pprev)
+        for (const PowAlgo algo : {PowAlgo::SHA256D, PowAlgo::NEOSCRYPT})
+          BOOST_CHECK_EQUAL (GetNextWorkRequired (algo, pindex, params),
+                             CalculateNextWorkRequired (algo, pindex, params));
+}
+
+BOOST_AUTO_TEST_CASE (next_work_cache_unload)
+{
+  /* When the block index is unloaded, the same hashes may later refer to
+     newly loaded index entries (e.g. in tests, with different data).  The
+     cache must not return results for the old ones.  */
+  const Consensus::Params& params = Params ().GetConsensus ();
+
+  constexpr unsigned LENGTH = 100;
+  std::vector<uint256> hashes(LENGTH);
+  std::vector<CBlockIndex> blocks(LENGTH);
+  const auto build = [&] (const int64_t spacing)
+    {
+      for (unsigned i = 0; i < LENGTH; ++i)
+        {
+          CBlockIndex& index = blocks[i];
+          index.pprev = i == 0 ? nullptr : &blocks[i - 1];
+          index.nHeight = i;
+          index.nTime = 1000000000 + spacing * i;
+          index.algo = i % 2 == 0 ? PowAlgo::SHA256D : PowAlgo::NEOSCRYPT;
+          index.nBits = CalculateNextWorkRequired (index.algo, index.pprev,
+                                                   params);
+          hashes[i] = ArithToUint256 (arith_uint256 (i + 1));
+          index.phashBlock = &hashes[i];
+          index.BuildSkip ();
+        }
+    };
+
+  build (30);
+  const CBlockIndex* tip = &blocks.back ();
+  const unsigned before = GetNextWorkRequired (PowAlgo::NEOSCRYPT, tip, params);
+  BOOST_CHECK_EQUAL (before, CalculateNextWorkRequired (PowAlgo::NEOSCRYPT,
+                                                        tip, params));
+
+  build (10);
+  const unsigned after = CalculateNextWorkRequired (PowAlgo::NEOSCRYPT,
+                                                    tip, params);
+  BOOST_CHECK (after != before);
+  BOOST_CHECK_EQUAL (GetNextWorkRequired (PowAlgo::NEOSCRYPT, tip, params),
+                     before);
+
+  UnloadBlockIndex ();
+  BOOST_CHECK_EQUAL (GetNextWorkRequired (PowAlgo::NEOSCRYPT, tip, params),
+                     after);
+}
+
 /* ************************************************************************** */
 
 namespace
@@ -0,0 +1,158 @@
+// Copyright (c) 2019 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <consensus/validation.h>
+#include <index/gameindex.h>
+#include <names/encoding.h>
+#include <script/names.h>
+#include <script/standard.h>
+#include <test/setup_common.h>
+#include <util/time.h>
+#include <validation.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(gameindex_tests)
+
+namespace
+{
+
+/**
+ * Builds a transaction spending the given coinbase and registering a name
+ * with the given value.
+ */
+CMutableTransaction
+NameRegistration(const CTransaction& coinbase, const CKey& key,
+                 const std::string& name, const std::string& value)
+{
+    const CScript scriptPubKey = CScript() << ToByteVector(key.GetPubKey()) << OP_CHECKSIG;
+
+    CMutableTransaction mtx;
+    mtx.vin.resize(1);
+    mtx.vin[0].prevout = COutPoint(coinbase.GetHash(), 0);
+    mtx.vout.push_back(CTxOut(COIN, CNameScript::buildNameRegister(
+        scriptPubKey, DecodeName(name, NameEncoding::ASCII),
+        DecodeName(value, NameEncoding::ASCII))));
+
+    std::vector<unsigned char> vchSig;
+    const uint256 hash = SignatureHash(scriptPubKey, mtx, 0, SIGHASH_ALL, 0, SigVersion::BASE);
+    BOOST_CHECK(key.Sign(hash, vchSig));
+    vchSig.push_back(static_cast<unsigned char>(SIGHASH_ALL));
+    mtx.vin[0].scriptSig << vchSig;
+
+    return mtx;
+}
+
+void
+WaitForSync(GameIndex& index)
+{
+    constexpr int64_t timeout_ms = 10 * 1000;
+    int64_t time_start = GetTimeMillis();
+    while (!index.BlockUntilSyncedToCurrentChain()) {
+        BOOST_REQUIRE(time_start + timeout_ms > GetTimeMillis());
+        MilliSleep(100);
+    }
+}
+
+const CBlockIndex*
+GetTip()
+{
+    LOCK(cs_main);
+    return ::ChainActive().Tip();
+}
+
+} // anonymous namespace
+
+BOOST_FIXTURE_TEST_CASE(gameindex_sync_and_lookup, TestChain100Setup)
+{
+    GameIndex gameindex(1 << 20, true);
+
+    std::vector<std::shared_ptr<const BlockGameMoves>> data;
+
+    // Nothing should be found before the index is started.
+    BOOST_CHECK(!gameindex.LookupRange("a", 1, GetTip(), data));
+
+    gameindex.Start();
+    WaitForSync(gameindex);
+
+    const CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    const CBlock moveBlock = CreateAndProcessBlock(
+        {NameRegistration(*m_coinbase_txns[0], coinbaseKey, "p/domob", R"({"g":{"a":42}})")},
+        scriptPubKey);
+    const CBlock adminBlock = CreateAndProcessBlock(
+        {NameRegistration(*m_coinbase_txns[1], coinbaseKey, "g/a", R"({"cmd":"foo"})")},
+        scriptPubKey);
+    BOOST_CHECK(gameindex.BlockUntilSyncedToCurrentChain());
+
+    const CBlockIndex* tip = GetTip();
+    BOOST_REQUIRE_EQUAL(tip->GetBlockHash(), adminBlock.GetHash());
+    BOOST_REQUIRE_EQUAL(tip->nHeight, 102);
+
+    BOOST_CHECK(!gameindex.LookupRange("a", -1, tip, data));
+    BOOST_CHECK(!gameindex.LookupRange("a", 103, tip, data));
+
+    BOOST_REQUIRE(gameindex.LookupRange("a", 1, tip, data));
+    BOOST_REQUIRE_EQUAL(data.size(), 102);
+    for (int height = 1; height <= tip->nHeight; ++height) {
+        const auto& entry = *data[height - 1];
+        const CBlockIndex* pindex = tip->GetAncestor(height);
+        BOOST_CHECK_EQUAL(entry.hash, pindex->GetBlockHash());
+        BOOST_CHECK_EQUAL(entry.parent, pindex->pprev->GetBlockHash());
+        BOOST_CHECK_EQUAL(entry.timestamp, pindex->GetBlockTime());
+
+        const size_t expectedMoves = (height == 101 ? 1 : 0);
+        const size_t expectedCmds = (height == 102 ? 1 : 0);
+        BOOST_CHECK_EQUAL(entry.moves.GetMoves("a").size(), expectedMoves);
+        BOOST_CHECK_EQUAL(entry.moves.GetAdminCommands("a").size(), expectedCmds);
+    }
+
+    const auto& moveData = *data[100];
+    BOOST_CHECK_EQUAL(moveData.rngseed, moveBlock.GetRngSeed());
+    const auto& mv = moveData.moves.GetMoves("a")[0];
+    BOOST_CHECK_EQUAL(mv.tx->txid, moveBlock.vtx[1]->GetHash());
+    BOOST_CHECK_EQUAL(mv.tx->name, "domob");
+    BOOST_CHECK_EQUAL(mv.move.write(), "42");
+
+    const auto& cmd = data[101]->moves.GetAdminCommands("a")[0];
+    BOOST_CHECK_EQUAL(cmd.txid, adminBlock.vtx[1]->GetHash());
+    BOOST_CHECK_EQUAL(cmd.cmd.write(), R"("foo")");
+
+    BOOST_REQUIRE(gameindex.LookupRange("b", 101, tip, data));
+    BOOST_REQUIRE_EQUAL(data.size(), 2);
+    BOOST_CHECK(data[0]->moves.GetAllMoves().empty());
+    BOOST_CHECK(data[1]->moves.GetAllAdminCommands().empty());
+
+    // Replace the last block with one without admin commands.  The stale
+    // data must be removed from the index.
+    {
+        CValidationState state;
+        BOOST_CHECK(InvalidateBlock(state, Params(), const_cast<CBlockIndex*>(tip)));
+    }
+    const CBlock replacement = CreateAndProcessBlock({}, scriptPubKey);
+    BOOST_CHECK(gameindex.BlockUntilSyncedToCurrentChain());
+
+    const CBlockIndex* newTip = GetTip();
+    BOOST_REQUIRE_EQUAL(newTip->GetBlockHash(), replacement.GetHash());
+    BOOST_REQUIRE_EQUAL(newTip->nHeight, 102);
+
+    // Looking up the stale chain fails now.
+    BOOST_CHECK(!gameindex.LookupRange("a", 101, tip, data));
+
+    BOOST_REQUIRE(gameindex.LookupRange("a", 101, newTip, data));
+    BOOST_REQUIRE_EQUAL(data.size(), 2);
+    BOOST_CHECK_EQUAL(data[0]->moves.GetMoves("a").size(), 1);
+    BOOST_CHECK_EQUAL(data[1]->hash, replacement.GetHash());
+    BOOST_CHECK(data[1]->moves.GetAdminCommands("a").empty());
+
+    // shutdown sequence (c.f. Shutdown() in init.cpp)
+    gameindex.Stop();
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+
+    // Rest of shutdown sequence and destructors happen in ~TestingSetup()
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,348 @@
+// Copyright (c) 2019 The Xaya developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <amount.h>
+#include <key_io.h>
+#include <names/encoding.h>
+#include <names/gamemoves.h>
+#include <primitives/block.h>
+#include <primitives/transaction.h>
+#include <script/names.h>
+#include <script/standard.h>
+#include <streams.h>
+#include <test/setup_common.h>
+
+#include <univalue.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <map>
+#include <string>
+
+/* No space between BOOST_FIXTURE_TEST_SUITE and '(', so that extraction of
+   the test-suite name works with grep as done in the Makefile.  */
+BOOST_FIXTURE_TEST_SUITE(gamemoves_tests, BasicTestingSetup)
+
+namespace
+{
+
+/**
+ * Returns a P2PKH script for an address derived from the given byte.
+ */
+CScript
+Addr (const unsigned char b)
+{
+  uint160 hash;
+  *hash.begin () = b;
+  return GetScriptForDestination (PKHash (hash));
+}
+
+/**
+ * Constructs a transaction with a name update of the given name and value
+ * as well as some currency outputs.  The transaction spends the given
+ * number of (fake) inputs.
+ */
+CTransactionRef
+NameTx (const std::string& name, const std::string& value,
+        const unsigned numInputs = 1)
+{
+  CMutableTransaction mtx;
+  for (unsigned i = 0; i < numInputs; ++i)
+    {
+      uint256 prev;
+      *prev.begin () = i + 1;
+      mtx.vin.push_back (CTxIn (COutPoint (prev, i)));
+    }
+
+  mtx.vout.push_back (CTxOut (COIN, Addr (1)));
+  mtx.vout.push_back (CTxOut (COIN / 100, CNameScript::buildNameUpdate (
+      Addr (2), DecodeName (name, NameEncoding::UTF8),
+      DecodeName (value, NameEncoding::UTF8))));
+  mtx.vout.push_back (CTxOut (2 * COIN, Addr (1)));
+  mtx.vout.push_back (CTxOut (COIN, CScript () << OP_TRUE));
+
+  return MakeTransactionRef (mtx);
+}
+
+UniValue
+ParseJson (const std::string& str)
+{
+  UniValue res;
+  BOOST_CHECK (res.read (str));
+  return res;
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE (non_game_transactions)
+{
+  GameMoveIndex idx;
+
+  CMutableTransaction mtx;
+  mtx.vout.push_back (CTxOut (COIN, Addr (1)));
+  idx.AddTransaction (CTransaction (mtx));
+
+  idx.AddTransaction (*NameTx ("d/domain", R"({"g":{"a":1}})"));
+  idx.AddTransaction (*NameTx ("p/domob", R"({"x":{"a":1}})"));
+  idx.AddTransaction (*NameTx ("p/domob", R"({"g":{}})"));
+  idx.AddTransaction (*NameTx ("p/domob", R"({"g":42})"));
+
+  BOOST_CHECK (idx.GetAllMoves ().empty ());
+  BOOST_CHECK (idx.GetMoves ("a").empty ());
+  BOOST_CHECK (idx.GetAdminCommands ("domain").empty ());
+}
+
+BOOST_AUTO_TEST_CASE (moves_per_game)
+{
+  GameMoveIndex idx;
+
+  const auto tx1 = NameTx ("p/domob", R"({"g":{"a":1,"b":[2],"a":3}})", 2);
+  const auto tx2 = NameTx ("p/andy", R"({"g":{"b":"x"},"g":{"c":true}})");
+  idx.AddTransaction (*tx1);
+  idx.AddTransaction (*tx2);
+
+  BOOST_CHECK_EQUAL (idx.GetAllMoves ().size (), 3);
+
+  const auto& a = idx.GetMoves ("a");
+  BOOST_CHECK_EQUAL (a.size (), 1);
+  BOOST_CHECK_EQUAL (a[0].tx->txid, tx1->GetHash ());
+  BOOST_CHECK_EQUAL (a[0].tx->name, "domob");
+  BOOST_CHECK_EQUAL (a[0].move.write (), "3");
+
+  const auto& b = idx.GetMoves ("b");
+  BOOST_CHECK_EQUAL (b.size (), 2);
+  BOOST_CHECK_EQUAL (b[0].move.write (), "[2]");
+  BOOST_CHECK_EQUAL (b[1].move.write (), R"("x")");
+  BOOST_CHECK_EQUAL (b[1].tx->name, "andy");
+
+  const auto& c = idx.GetMoves ("c");
+  BOOST_CHECK_EQUAL (c.size (), 1);
+  BOOST_CHECK_EQUAL (c[0].tx->txid, tx2->GetHash ());
+
+  /* The transaction data is shared between the games.  */
+  BOOST_CHECK (a[0].tx == b[0].tx);
+  BOOST_CHECK (b[1].tx == c[0].tx);
+}
+
+BOOST_AUTO_TEST_CASE (move_json)
+{
+  GameMoveIndex idx;
+  const auto tx = NameTx ("p/domob", R"({"g":{"a":{"x":1}}})", 2);
+  idx.AddTransaction (*tx);
+
+  const auto& moves = idx.GetMoves ("a");
+  BOOST_REQUIRE_EQUAL (moves.size (), 1);
+
+  CTxDestination dest;
+  BOOST_CHECK (ExtractDestination (Addr (1), dest));
+  const std::string addr = EncodeDestination (dest);
+
+  uint256 prev1, prev2;
+  *prev1.begin () = 1;
+  *prev2.begin () = 2;
+
+  const UniValue expected = ParseJson (R"({
+    "txid": ")" + tx->GetHash ().GetHex () + R"(",
+    "name": "domob",
+    "inputs":
+      [
+        {"txid": ")" + prev1.GetHex () + R"(", "vout": 0},
+        {"txid": ")" + prev2.GetHex () + R"(", "vout": 1}
+      ],
+    "out": {")" + addr + R"(": 3.00000000},
+    "move": {"x": 1}
+  })");
+  BOOST_CHECK_EQUAL (moves[0].ToJson ().write (), expected.write ());
+}
+
+BOOST_AUTO_TEST_CASE (admin_commands)
+{
+  GameMoveIndex idx;
+
+  const auto tx1 = NameTx ("g/a", R"({"cmd":1,"g":{"b":2},"cmd":{"x":3}})");
+  const auto tx2 = NameTx ("g/a", R"({"foo":"bar"})");
+  const auto tx3 = NameTx ("g/b", R"({"cmd":"y"})");
+  idx.AddTransaction (*tx1);
+  idx.AddTransaction (*tx2);
+  idx.AddTransaction (*tx3);
+
+  BOOST_CHECK (idx.GetAllMoves ().empty ());
+
+  const auto& a = idx.GetAdminCommands ("a");
+  BOOST_REQUIRE_EQUAL (a.size (), 2);
+  BOOST_CHECK_EQUAL (a[0].txid, tx1->GetHash ());
+  BOOST_CHECK_EQUAL (a[0].cmd.write (), "1");
+  BOOST_CHECK_EQUAL (a[1].ToJson ().write (),
+                     ParseJson (R"({"txid":")" + tx1->GetHash ().GetHex ()
+                                  + R"(","cmd":{"x":3}})").write ());
+
+  const auto& b = idx.GetAdminCommands ("b");
+  BOOST_REQUIRE_EQUAL (b.size (), 1);
+  BOOST_CHECK_EQUAL (b[0].txid, tx3->GetHash ());
+}
+
+BOOST_AUTO_TEST_CASE (block_moves)
+{
+  CBlock block;
+  block.nTime = 1234;
+  *block.hashPrevBlock.begin () = 42;
+  block.vtx.push_back (NameTx ("p/domob", R"({"g":{"a":1}})"));
+  block.vtx.push_back (NameTx ("g/a", R"({"cmd":2})"));
+  block.pow.initFakeHeader (block);
+
+  const BlockGameMoves data(block);
+  BOOST_CHECK_EQUAL (data.hash, block.GetHash ());
+  BOOST_CHECK_EQUAL (data.parent, block.hashPrevBlock);
+  BOOST_CHECK_EQUAL (data.timestamp, 1234);
+  BOOST_CHECK_EQUAL (data.rngseed, block.GetRngSeed ());
+  BOOST_CHECK_EQUAL (data.moves.GetMoves ("a").size (), 1);
+  BOOST_CHECK_EQUAL (data.moves.GetAdminCommands ("a").size (), 1);
+}
+
+BOOST_AUTO_TEST_CASE (binary_encoding)
+{
+  CBlock block;
+  block.nTime = 1234;
+  *block.hashPrevBlock.begin () = 42;
+  block.vtx.push_back (NameTx ("p/domob", R"({"g":{"a":[1,2],"b":3}})", 2));
+  block.vtx.push_back (NameTx ("g/a", R"({"cmd":"x"})"));
+  block.pow.initFakeHeader (block);
+  const BlockGameMoves data(block);
+
+  std::vector<unsigned char> bin = {0xFF};
+  EncodeGameBlockBinary (data, 10, 1000, "a", "token", bin);
+  BOOST_CHECK_EQUAL (bin[0], 0xFF);
+
+  VectorReader reader(SER_NETWORK, PROTOCOL_VERSION, bin, 1);
+
+  uint8_t version;
+  uint256 hash, parent, rngseed;
+  uint32_t height;
+  int64_t timestamp, mediantime;
+  std::string reqtoken;
+  reader >> version >> hash >> parent >> height >> timestamp >> mediantime
+         >> rngseed >> reqtoken;
+  BOOST_CHECK_EQUAL (version, GAME_BINARY_VERSION);
+  BOOST_CHECK_EQUAL (hash, block.GetHash ());
+  BOOST_CHECK_EQUAL (parent, block.hashPrevBlock);
+  BOOST_CHECK_EQUAL (height, 10);
+  BOOST_CHECK_EQUAL (timestamp, 1234);
+  BOOST_CHECK_EQUAL (mediantime, 1000);
+  BOOST_CHECK_EQUAL (rngseed, block.GetRngSeed ());
+  BOOST_CHECK_EQUAL (reqtoken, "token");
+
+  BOOST_CHECK_EQUAL (ReadCompactSize (reader), 1);
+  const uint64_t moveLen = ReadCompactSize (reader);
+  const size_t moveStart = reader.size ();
+  GameMove mv;
+  reader >> mv;
+  BOOST_CHECK_EQUAL (moveStart - reader.size (), moveLen);
+  BOOST_CHECK_EQUAL (mv.ToJson ().write (),
+                     data.moves.GetMoves ("a")[0].ToJson ().write ());
+
+  BOOST_CHECK_EQUAL (ReadCompactSize (reader), 1);
+  ReadCompactSize (reader);
+  GameAdminCommand cmd;
+  reader >> cmd;
+  BOOST_CHECK_EQUAL (cmd.txid, block.vtx[1]->GetHash ());
+  BOOST_CHECK_EQUAL (cmd.cmd.write (), R"("x")");
+  BOOST_CHECK (reader.empty ());
+
+  /* A game without data has empty tables.  */
+  bin.clear ();
+  EncodeGameBlockBinary (data, 10, 1000, "c", "", bin);
+  BOOST_CHECK_EQUAL (bin.size (), 1 + 3 * 32 + 4 + 2 * 8 + 1 + 2);
+}
+
+BOOST_AUTO_TEST_CASE (assembled_json)
+{
+  CBlock block;
+  block.nTime = 1234;
+  *block.hashPrevBlock.begin () = 42;
+  block.vtx.push_back (NameTx ("p/dömob",
+                               R"({"g":{"a":"äöü ☃","b":{"x":"\u00e9\n"}}})",
+                               2));
+  block.vtx.push_back (NameTx ("p/x", R"({"g":{"a":[1,2]}})"));
+  block.vtx.push_back (NameTx ("g/a", R"({"cmd":{"text":"Grüße"}})"));
+  block.pow.initFakeHeader (block);
+  const BlockGameMoves data(block);
+
+  for (const std::string reqtoken : {"", "töken"})
+    {
+      UniValue blockData(UniValue::VOBJ);
+      blockData.pushKV ("hash", data.hash.GetHex ());
+      blockData.pushKV ("parent", data.parent.GetHex ());
+      blockData.pushKV ("timestamp", data.timestamp);
+      blockData.pushKV ("rngseed", data.rngseed.GetHex ());
+      blockData.pushKV ("height", 10);
+      blockData.pushKV ("mediantime", 1000);
+
+      UniValue tmpl(UniValue::VOBJ);
+      tmpl.pushKV ("block", blockData);
+      if (!reqtoken.empty ())
+        tmpl.pushKV ("reqtoken", reqtoken);
+
+      std::string jsonHeader = tmpl.write ();
+      jsonHeader.pop_back ();
+
+      std::map<const GameMoveTx*, std::string> txFragments;
+      for (const std::string game : {"a", "b", "c"})
+        {
+          UniValue moves(UniValue::VARR);
+          for (const auto& mv : data.moves.GetMoves (game))
+            moves.push_back (mv.ToJson ());
+          UniValue admin(UniValue::VARR);
+          for (const auto& cmd : data.moves.GetAdminCommands (game))
+            admin.push_back (cmd.ToJson ());
+
+          UniValue expected = tmpl;
+          expected.pushKV ("moves", moves);
+          expected.pushKV ("admin", admin);
+
+          BOOST_CHECK_EQUAL (AssembleGameBlockJson (jsonHeader, data, game,
+                                                    txFragments),
+                             expected.write ());
+        }
+
+      /* The first transaction has moves for both games, but its part is
+         only rendered once.  */
+      BOOST_CHECK_EQUAL (txFragments.size (), 2);
+    }
+}
+
+BOOST_AUTO_TEST_CASE (cache)
+{
+  std::vector<CBlock> blocks(3);
+  for (unsigned i = 0; i < blocks.size (); ++i)
+    {
+      blocks[i].nTime = i;
+      blocks[i].vtx.push_back (NameTx ("p/domob", R"({"g":{"a":1}})"));
+      blocks[i].pow.initFakeHeader (blocks[i]);
+    }
+
+  BlockGameMovesCache cache(2);
+  BOOST_CHECK (cache.Lookup (blocks[0].GetHash ()) == nullptr);
+
+  const auto data0 = cache.Get (blocks[0]);
+  BOOST_CHECK_EQUAL (data0->hash, blocks[0].GetHash ());
+  BOOST_CHECK (cache.Get (blocks[0]) == data0);
+  BOOST_CHECK (cache.Lookup (blocks[0].GetHash ()) == data0);
+
+  const auto data1 = cache.Get (blocks[1]);
+  BOOST_CHECK_EQUAL (cache.GetSize (), 2);
+
+  /* Block 0 has been used more recently than block 1, so that the latter
+     gets evicted when adding the third block.  */
+  BOOST_CHECK (cache.Lookup (blocks[0].GetHash ()) == data0);
+  cache.Get (blocks[2]);
+  BOOST_CHECK_EQUAL (cache.GetSize (), 2);
+  BOOST_CHECK (cache.Lookup (blocks[1].GetHash ()) == nullptr);
+  BOOST_CHECK (cache.Lookup (blocks[0].GetHash ()) == data0);
+  BOOST_CHECK (cache.Lookup (blocks[2].GetHash ()) != nullptr);
+
+  /* Evicted data is still valid for users holding a reference.  */
+  BOOST_CHECK_EQUAL (data1->moves.GetMoves ("a").size (), 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,92 @@
+// Copyright (c) 2019 The Xaya developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <clientversion.h>
+#include <headercache.h>
+#include <powdata.h>
+#include <primitives/block.h>
+#include <streams.h>
+#include <test/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+
+BOOST_FIXTURE_TEST_SUITE(headercache_tests, BasicTestingSetup)
+
+namespace {
+
+CBlockHeader MakeHeader(const uint32_t nonce)
+{
+    CBlockHeader header;
+    header.nVersion = 1;
+    header.nTime = 1234;
+    header.nNonce = nonce;
+    header.pow.setCoreAlgo(PowAlgo::NEOSCRYPT);
+    header.pow.setBits(0x207fffff);
+    header.pow.initFakeHeader(header).nNonce = 42;
+    return header;
+}
+
+std::vector<unsigned char> Serialize(const CBlockHeader& header)
+{
+    std::vector<unsigned char> res;
+    CVectorWriter(SER_DISK, CLIENT_VERSION, res, 0, header);
+    return res;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(lookup)
+{
+    BlockHeaderCache cache(1 << 20);
+    const CBlockHeader header = MakeHeader(1);
+
+    CBlockHeader found;
+    BOOST_CHECK(!cache.Lookup(header.GetHash(), found));
+
+    cache.Insert(header);
+    BOOST_CHECK_EQUAL(cache.Size(), 1);
+    BOOST_CHECK(cache.Lookup(header.GetHash(), found));
+    BOOST_CHECK(Serialize(found) == Serialize(header));
+    BOOST_CHECK(found.pow.getFakeHeader().nNonce == 42);
+
+    cache.Insert(header);
+    BOOST_CHECK_EQUAL(cache.Size(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(eviction)
+{
+    BlockHeaderCache cache(1 << 20);
+    const CBlockHeader h1 = MakeHeader(1);
+    const CBlockHeader h2 = MakeHeader(2);
+    const CBlockHeader h3 = MakeHeader(3);
+
+    cache.Insert(h1);
+    const size_t entryUsage = cache.DynamicMemoryUsage();
+    cache.Insert(h2);
+    cache.Insert(h3);
+    BOOST_CHECK_EQUAL(cache.Size(), 3);
+    BOOST_CHECK_EQUAL(cache.DynamicMemoryUsage(), 3 * entryUsage);
+
+    /* Looking up h1 makes h2 the least recently used one.  */
+    CBlockHeader found;
+    BOOST_CHECK(cache.Lookup(h1.GetHash(), found));
+    cache.SetMaxUsage(2 * entryUsage);
+    BOOST_CHECK_EQUAL(cache.Size(), 2);
+    BOOST_CHECK(cache.Lookup(h1.GetHash(), found));
+    BOOST_CHECK(!cache.Lookup(h2.GetHash(), found));
+    BOOST_CHECK(cache.Lookup(h3.GetHash(), found));
+
+    cache.Insert(h2);
+    BOOST_CHECK_EQUAL(cache.Size(), 2);
+    BOOST_CHECK(!cache.Lookup(h1.GetHash(), found));
+
+    cache.SetMaxUsage(0);
+    BOOST_CHECK_EQUAL(cache.Size(), 0);
+    cache.Insert(h1);
+    BOOST_CHECK_EQUAL(cache.Size(), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -190,6 +190,124 @@ BOOST_FIXTURE_TEST_CASE (pendingChainLength_lastNameOutput,
   BOOST_CHECK_EQUAL (mempool.pendingNameChainLength (Name ("chain")), 3);
 }
 
+BOOST_FIXTURE_TEST_CASE (lastNameOutput_reorg, NameMempoolTestSetup)
+{
+  /* A block with the first two updates of a chain is disconnected, while the
+     third update (spending the second) stays in the mempool.  The first two
+     are then added back after it, and the last output must still be the
+     one of the third update.  */
+
+  CMutableTransaction mtx;
+  mtx.vout.push_back (CTxOut (COIN, UpdateScript (ADDR, "chain", "a")));
+  const CTransaction chain1(mtx);
+
+  mtx.vout.clear ();
+  mtx.vout.push_back (CTxOut (COIN, ADDR));
+  mtx.vout.push_back (CTxOut (COIN, UpdateScript (ADDR, "chain", "b")));
+  mtx.vin.push_back (CTxIn (COutPoint (chain1.GetHash (), 0)));
+  const CTransaction chain2(mtx);
+
+  mtx.vout.clear ();
+  mtx.vout.push_back (CTxOut (COIN, UpdateScript (ADDR, "chain", "c")));
+  mtx.vin.clear ();
+  mtx.vin.push_back (CTxIn (COutPoint (chain2.GetHash (), 1)));
+  const CTransaction chain3(mtx);
+
+  mempool.addUnchecked (Entry (chain3));
+  BOOST_CHECK (mempool.lastNameOutput (Name ("chain"))
+                  == COutPoint (chain3.GetHash (), 0));
+
+  mempool.addUnchecked (Entry (chain1));
+  BOOST_CHECK (mempool.lastNameOutput (Name ("chain"))
+                  == COutPoint (chain3.GetHash (), 0));
+
+  mempool.addUnchecked (Entry (chain2));
+  BOOST_CHECK (mempool.lastNameOutput (Name ("chain"))
+                  == COutPoint (chain3.GetHash (), 0));
+  BOOST_CHECK_EQUAL (mempool.pendingNameChainLength (Name ("chain")), 3);
+}
+
+BOOST_FIXTURE_TEST_CASE (pending_operations, NameMempoolTestSetup)
+{
+  CMutableTransaction mtx;
+  mtx.vout.push_back (CTxOut (COIN, ADDR));
+  mtx.vout.push_back (CTxOut (COIN, RegisterScript (ADDR, "chain", "x")));
+  const CTransaction chain1(mtx);
+
+  mtx.vout.clear ();
+  mtx.vout.push_back (CTxOut (COIN, UpdateScript (OTHER_ADDR, "chain", "y")));
+  mtx.vin.push_back (CTxIn (COutPoint (chain1.GetHash (), 1)));
+  const CTransaction chain2(mtx);
+
+  const auto txOther = Tx (UpdateScript (ADDR, "other", "z"));
+
+  mempool.addUnchecked (Entry (chain1));
+  mempool.addUnchecked (Entry (txOther));
+  mempool.addUnchecked (Entry (chain2));
+
+  BOOST_CHECK (mempool.getPendingNameOperations (Name ("none")).empty ());
+
+  const auto& ops = mempool.getPendingNameOperations (Name ("chain"));
+  BOOST_CHECK_EQUAL (ops.size (), 2);
+  BOOST_CHECK_EQUAL (ops[0].op, OP_NAME_REGISTER);
+  BOOST_CHECK (ops[0].outpoint == COutPoint (chain1.GetHash (), 1));
+  BOOST_CHECK (ops[0].value == Name ("x"));
+  BOOST_CHECK (ops[0].address == ADDR);
+  BOOST_CHECK_EQUAL (ops[1].op, OP_NAME_UPDATE);
+  BOOST_CHECK (ops[1].outpoint == COutPoint (chain2.GetHash (), 0));
+  BOOST_CHECK (ops[1].value == Name ("y"));
+  BOOST_CHECK (ops[1].address == OTHER_ADDR);
+
+  BOOST_CHECK_EQUAL (mempool.getPendingNames ().size (), 2);
+
+  mempool.removeRecursive (txOther, MemPoolRemovalReason::EXPIRY);
+  BOOST_CHECK (mempool.getPendingNameOperations (Name ("other")).empty ());
+  BOOST_CHECK_EQUAL (mempool.getPendingNames ().size (), 1);
+
+  mempool.removeRecursive (chain1, MemPoolRemovalReason::EXPIRY);
+  BOOST_CHECK (mempool.getPendingNames ().empty ());
+
+  /* When transactions are added back from a disconnected block, they may
+     be added after the ones spending them.  The operations are still
+     returned in the order of the chain.  This is the case for a longer
+     chain as well, where the disconnected block contained the first two
+     operations and the third one stayed in the mempool.  */
+  mtx.vout.clear ();
+  mtx.vout.push_back (CTxOut (COIN, UpdateScript (ADDR, "chain", "z")));
+  mtx.vin.clear ();
+  mtx.vin.push_back (CTxIn (COutPoint (chain2.GetHash (), 0)));
+  const CTransaction chain3(mtx);
+
+  mempool.addUnchecked (Entry (chain3));
+  mempool.addUnchecked (Entry (chain1));
+  mempool.addUnchecked (Entry (chain2));
+  const auto& reordered = mempool.getPendingNameOperations (Name ("chain"));
+  BOOST_CHECK_EQUAL (reordered.size (), 3);
+  BOOST_CHECK (reordered[0].outpoint.hash == chain1.GetHash ());
+  BOOST_CHECK (reordered[1].outpoint.hash == chain2.GetHash ());
+  BOOST_CHECK (reordered[2].outpoint.hash == chain3.GetHash ());
+  BOOST_CHECK (reordered[2].value == Name ("z"));
+
+  /* The same if the first operation is already in the mempool when the
+     last one is added, i.e. the missing one is in the middle.  The links
+     from chain2 to chain3 are not known to the mempool (that would be done
+     by UpdateTransactionsFromBlock), so remove chain3 explicitly.  */
+  mempool.removeRecursive (chain1, MemPoolRemovalReason::EXPIRY);
+  mempool.removeRecursive (chain3, MemPoolRemovalReason::EXPIRY);
+  BOOST_CHECK (mempool.getPendingNames ().empty ());
+
+  mempool.addUnchecked (Entry (chain1));
+  mempool.addUnchecked (Entry (chain3));
+  mempool.addUnchecked (Entry (chain2));
+  const auto& middle = mempool.getPendingNameOperations (Name ("chain"));
+  BOOST_CHECK_EQUAL (middle.size (), 3);
+  BOOST_CHECK (middle[0].outpoint.hash == chain1.GetHash ());
+  BOOST_CHECK (middle[1].outpoint.hash == chain2.GetHash ());
+  BOOST_CHECK (middle[2].outpoint.hash == chain3.GetHash ());
+  BOOST_CHECK (mempool.lastNameOutput (Name ("chain"))
+                  == COutPoint (chain3.GetHash (), 0));
+}
+
 BOOST_FIXTURE_TEST_CASE (name_register, NameMempoolTestSetup)
 {
   const auto tx1 = Tx (RegisterScript (ADDR, "foo", "x"));
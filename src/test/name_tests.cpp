@@ -8,6 +8,8 @@
 #include <key_io.h>
 #include <names/encoding.h>
 #include <names/main.h>
+#include <names/readcache.h>
+#include <names/valuecache.h>
 #include <policy/policy.h>
 #include <policy/settings.h>
 #include <primitives/transaction.h>
@@ -24,6 +26,7 @@
 
 #include <cassert>
 #include <list>
+#include <map>
 #include <memory>
 #include <stdexcept>
 
@@ -94,6 +97,32 @@ CheckNameTransaction (const CMutableTransaction& mtx, const unsigned nHeight,
   return CheckNameTransaction (tx, nHeight, view, state);
 }
 
+/**
+ * Enables the name history while it is in scope, and restores the previous
+ * setting when it goes out of scope (also if the test case throws).
+ */
+class NameHistoryEnabler
+{
+
+private:
+
+  const bool oldValue;
+
+public:
+
+  NameHistoryEnabler ()
+    : oldValue(fNameHistory)
+  {
+    fNameHistory = true;
+  }
+
+  ~NameHistoryEnabler ()
+  {
+    fNameHistory = oldValue;
+  }
+
+};
+
 } // anonymous namespace
 
 /* ************************************************************************** */
@@ -128,6 +157,71 @@ BOOST_AUTO_TEST_CASE (name_scripts)
   BOOST_CHECK (opUpdate.getOpValue () == value);
 }
 
+BOOST_AUTO_TEST_CASE (name_script_view)
+{
+  const CScript addr = getTestAddress ();
+  const CNameScriptView viewNone(addr);
+  BOOST_CHECK (!viewNone.isNameOp ());
+  BOOST_CHECK (viewNone.getAddress () == addr);
+
+  const valtype name = DecodeName ("x/my-cool-name", NameEncoding::ASCII);
+  const valtype value = ValueOfLength (300);
+
+  const CScript script = CNameScript::buildNameUpdate (addr, name, value);
+  const CNameScriptView view(script);
+  BOOST_CHECK (view.isNameOp ());
+  BOOST_CHECK (view.getNameOp () == OP_NAME_UPDATE);
+  BOOST_CHECK (view.getAddress () == addr);
+  const auto viewName = view.getOpName ();
+  const auto viewValue = view.getOpValue ();
+  BOOST_CHECK (valtype (viewName.begin (), viewName.end ()) == name);
+  BOOST_CHECK (valtype (viewValue.begin (), viewValue.end ()) == value);
+
+  const CNameScript fromView(view);
+  BOOST_CHECK (fromView.getNameOp () == OP_NAME_UPDATE);
+  BOOST_CHECK (fromView.getAddress () == addr);
+  BOOST_CHECK (fromView.getOpName () == name);
+  BOOST_CHECK (fromView.getOpValue () == value);
+
+  const CNameScript fromViewNone(viewNone);
+  BOOST_CHECK (!fromViewNone.isNameOp ());
+  BOOST_CHECK (fromViewNone.getAddress () == addr);
+
+  /* Check the view (and CNameScript, which is based on it) also on scripts
+     that are not valid name operations.  */
+  const std::vector<std::pair<CScript, bool>> tests = {
+    {CScript (), false},
+    {CScript () << OP_NAME_UPDATE, false},
+    {CScript () << OP_NAME_UPDATE << name << OP_2DROP << OP_DROP, false},
+    {CScript () << OP_NAME_UPDATE << name << value << name << OP_2DROP, false},
+    {CScript () << OP_NAME_UPDATE << name << value << OP_DUP, false},
+    {CScript () << OP_NAME_REGISTER << name << value << OP_2DROP, true},
+    {CScript () << OP_NAME_REGISTER << name << value << OP_NOP, true},
+    {CScript () << OP_3 << name << value << OP_2DROP << OP_DROP, false},
+    {CScript () << name << value << OP_2DROP << OP_DROP, false},
+  };
+  for (const auto& t : tests)
+    {
+      const CNameScript op(t.first);
+      const CNameScriptView v(t.first);
+      BOOST_CHECK_EQUAL (v.isNameOp (), t.second);
+      BOOST_CHECK_EQUAL (op.isNameOp (), t.second);
+      BOOST_CHECK (op.getAddress () == v.getAddress ());
+      if (!t.second)
+        {
+          BOOST_CHECK (v.getAddress () == t.first);
+          continue;
+        }
+
+      const auto n = v.getOpName ();
+      const auto val = v.getOpValue ();
+      BOOST_CHECK (op.getOpName () == valtype (n.begin (), n.end ()));
+      BOOST_CHECK (op.getOpValue () == valtype (val.begin (), val.end ()));
+      BOOST_CHECK (valtype (n.begin (), n.end ()) == name);
+      BOOST_CHECK (valtype (val.begin (), val.end ()) == value);
+    }
+}
+
 /* ************************************************************************** */
 
 BOOST_AUTO_TEST_CASE (name_database)
@@ -206,6 +300,12 @@ public:
     return new Iterator ();
   }
 
+  CNameIterator*
+  IterateNamesLexicographic () const
+  {
+    return new Iterator ();
+  }
+
 };
 
 /**
@@ -248,8 +348,9 @@ private:
   /**
    * Verify consistency of the given view with the expected data.
    * @param view The view to check against data.
+   * @param lex Whether to check lexicographic instead of length-first order.
    */
-  void verify (const CCoinsView& view) const;
+  void verify (const CCoinsView& view, bool lex) const;
 
   /**
    * Get a new CNameData object for testing purposes.  This also
@@ -263,10 +364,16 @@ private:
    * list in the way they appeared.
    * @param view The view to iterate over.
    * @param start The start name.
+   * @param lex Whether to iterate in lexicographic order.
    * @return The resulting entry list.
    */
   static EntryList getNamesFromView (const CCoinsView& view,
-                                     const valtype& start);
+                                     const valtype& start, bool lex);
+
+  /**
+   * Return a new iterator for the view in the given order.
+   */
+  static CNameIterator* iterateView (const CCoinsView& view, bool lex);
 
   /**
    * Return all names that are produced by the given iterator.
@@ -331,18 +438,25 @@ NameIterationTester::getNextData ()
 }
 
 void
-NameIterationTester::verify (const CCoinsView& view) const
+NameIterationTester::verify (const CCoinsView& view, const bool lex) const
 {
   /* Try out everything with all names as "start".  This thoroughly checks
      that also the start implementation is correct.  It also checks using
      a single iterator and seeking vs using a fresh iterator.  */
 
   valtype start;
-  EntryList remaining(data.begin (), data.end ());
+  EntryList remaining;
+  if (lex)
+    {
+      const std::map<valtype, CNameData> sorted(data.begin (), data.end ());
+      remaining.assign (sorted.begin (), sorted.end ());
+    }
+  else
+    remaining.assign (data.begin (), data.end ());
 
   /* Seek the iterator to the end first for "maximum confusion".  This ensures
      that seeking to valtype() works.  */
-  std::unique_ptr<CNameIterator> iter(view.IterateNames ());
+  std::unique_ptr<CNameIterator> iter(iterateView (view, lex));
   const valtype end = DecodeName ("zzzzzzzzzzzzzzzz", NameEncoding::ASCII);
   {
     valtype name;
@@ -354,7 +468,7 @@ NameIterationTester::verify (const CCoinsView& view) const
 
   while (true)
     {
-      EntryList got = getNamesFromView (view, start);
+      EntryList got = getNamesFromView (view, start, lex);
       BOOST_CHECK (got == remaining);
 
       iter->seek (start);
@@ -377,7 +491,8 @@ NameIterationTester::verify (const CCoinsView& view) const
 void
 NameIterationTester::verify ()
 {
-  verify (hybrid);
+  for (const bool lex : {false, true})
+    verify (hybrid, lex);
 
   /* Flush calls BatchWrite internally, and for that to work, we need to have
      a non-zero block hash.  Just set the block hash based on our counter.  */
@@ -386,20 +501,31 @@ NameIterationTester::verify ()
   hybrid.SetBestBlock (dummyBlockHash);
 
   hybrid.Flush ();
-  verify (db);
-  verify (cache);
+  for (const bool lex : {false, true})
+    {
+      verify (db, lex);
+      verify (cache, lex);
+    }
 }
 
 NameIterationTester::EntryList
 NameIterationTester::getNamesFromView (const CCoinsView& view,
-                                       const valtype& start)
+                                       const valtype& start, const bool lex)
 {
-  std::unique_ptr<CNameIterator> iter(view.IterateNames ());
+  std::unique_ptr<CNameIterator> iter(iterateView (view, lex));
   iter->seek (start);
 
   return getNamesFromIterator (*iter);
 }
 
+CNameIterator*
+NameIterationTester::iterateView (const CCoinsView& view, const bool lex)
+{
+  if (lex)
+    return view.IterateNamesLexicographic ();
+  return view.IterateNames ();
+}
+
 NameIterationTester::EntryList
 NameIterationTester::getNamesFromIterator (CNameIterator& iter)
 {
@@ -453,6 +579,10 @@ NameIterationTester::remove (const std::string& n)
 
 BOOST_AUTO_TEST_CASE (name_iteration)
 {
+  /* Enable the lexicographic index, so that it is written and can be
+     checked as well.  The test database starts out empty.  */
+  fNameScanIndex = true;
+
   NameIterationTester tester(::ChainstateActive ().CoinsDB ());
 
   tester.verify ();
@@ -474,6 +604,8 @@ BOOST_AUTO_TEST_CASE (name_iteration)
   tester.add ("x/b");
   tester.update ("x/b");
   tester.update ("x/aa");
+
+  fNameScanIndex = false;
 }
 
 /* ************************************************************************** */
@@ -579,6 +711,176 @@ BOOST_AUTO_TEST_CASE (is_value_valid)
   BOOST_CHECK (!IsValueValid (DecodeName ("42", NameEncoding::ASCII), state));
 }
 
+BOOST_AUTO_TEST_CASE (parsed_name_value)
+{
+  UniValue value;
+  BOOST_CHECK (value.read (R"({
+    "cmd": 1,
+    "g": {"a": 1, "b": 2},
+    "cmd": {"x": true},
+    "g": {"b": 3, "c": 4},
+    "g": 42
+  })"));
+
+  const ParsedNameValue parsed(value);
+  BOOST_CHECK_EQUAL (parsed.cmds.size (), 2);
+  BOOST_CHECK_EQUAL (parsed.cmds[0].write (), "1");
+  BOOST_CHECK_EQUAL (parsed.cmds[1].write (), R"({"x":true})");
+  BOOST_CHECK_EQUAL (parsed.moves.size (), 3);
+  BOOST_CHECK_EQUAL (parsed.moves.at ("a").write (), "1");
+  BOOST_CHECK_EQUAL (parsed.moves.at ("b").write (), "3");
+  BOOST_CHECK_EQUAL (parsed.moves.at ("c").write (), "4");
+
+  /* Moves are ignored unless the first "g" is a non-empty object.  */
+  BOOST_CHECK (value.read (R"({"g": {}, "g": {"a": 1}})"));
+  BOOST_CHECK (ParsedNameValue (value).moves.empty ());
+  BOOST_CHECK (value.read (R"({"g": 1, "g": {"a": 1}})"));
+  BOOST_CHECK (ParsedNameValue (value).moves.empty ());
+}
+
+BOOST_AUTO_TEST_CASE (name_value_cache)
+{
+  UniValue value;
+  BOOST_CHECK (value.read (R"({"g": {"a": 1}})"));
+  const auto parsed = std::make_shared<const ParsedNameValue> (value);
+
+  const uint256 txid1 = uint256S ("01");
+  const uint256 txid2 = uint256S ("02");
+  const uint256 txid3 = uint256S ("03");
+
+  /* Find out how much memory a single entry takes, and size the cache
+     so that it holds exactly two of them.  */
+  NameValueCache cache(1 << 20);
+  cache.Insert (txid1, parsed);
+  const size_t entryUsage = cache.GetStats ().usage;
+  BOOST_CHECK (entryUsage > parsed->DynamicMemoryUsage ());
+  cache.SetMaxUsage (2 * entryUsage);
+  BOOST_CHECK_EQUAL (cache.GetStats ().size, 1);
+
+  BOOST_CHECK (cache.Lookup (txid1) == parsed);
+  cache.Insert (txid2, parsed);
+  BOOST_CHECK (cache.Lookup (txid1) == parsed);
+  BOOST_CHECK (cache.Lookup (txid2) == parsed);
+
+  /* The oldest entry is evicted first.  */
+  cache.Insert (txid3, parsed);
+  BOOST_CHECK (cache.Lookup (txid1) == nullptr);
+  BOOST_CHECK (cache.Lookup (txid3) == parsed);
+
+  auto stats = cache.GetStats ();
+  BOOST_CHECK_EQUAL (stats.size, 2);
+  BOOST_CHECK_EQUAL (stats.usage, 2 * entryUsage);
+  BOOST_CHECK_EQUAL (stats.maxUsage, 2 * entryUsage);
+  BOOST_CHECK_EQUAL (stats.hits, 4);
+  BOOST_CHECK_EQUAL (stats.misses, 1);
+
+  /* Deeply nested values take a lot more memory than their JSON, and
+     are accounted for as such.  */
+  BOOST_CHECK (value.read (R"({"g": {"a": [[[[[[[[[[[[[[[[1]]]]]]]]]]]]]]]]}})"));
+  const ParsedNameValue nested(value);
+  BOOST_CHECK (nested.DynamicMemoryUsage () > 16 * sizeof (UniValue));
+
+  /* Size zero disables the cache.  */
+  cache.SetMaxUsage (0);
+  cache.Insert (txid1, parsed);
+  stats = cache.GetStats ();
+  BOOST_CHECK_EQUAL (stats.size, 0);
+  BOOST_CHECK (cache.Lookup (txid1) == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE (name_read_cache)
+{
+  const CScript addr = getTestAddress ();
+  const auto makeData = [&addr] (const valtype& name, const unsigned h)
+    {
+      const valtype value = DecodeName (val ("value"), NameEncoding::ASCII);
+      const CScript scr = CNameScript::buildNameUpdate (addr, name, value);
+      CNameData data;
+      data.fromScript (h, COutPoint (uint256 (), 0), CNameScript (scr));
+      return data;
+    };
+
+  const valtype name1 = DecodeName ("x/name1", NameEncoding::ASCII);
+  const valtype name2 = DecodeName ("x/name2", NameEncoding::ASCII);
+  const CNameData data1 = makeData (name1, 10);
+  const CNameData data2 = makeData (name2, 20);
+
+  NameReadCache cache(1 << 20);
+  CNameData data;
+
+  BOOST_CHECK (!cache.Lookup (name1, data));
+  cache.Insert (name1, data1, cache.GetGeneration ());
+  BOOST_CHECK (cache.Lookup (name1, data));
+  BOOST_CHECK (data == data1);
+
+  /* Changed names are invalidated, and data read before the invalidation
+     is not inserted anymore.  */
+  const uint64_t gen = cache.GetGeneration ();
+  CNameCache changes;
+  changes.set (name1, data2);
+  cache.Invalidate (changes);
+  BOOST_CHECK (!cache.Lookup (name1, data));
+  cache.Insert (name2, data2, gen);
+  BOOST_CHECK (!cache.Lookup (name2, data));
+  cache.Insert (name2, data2, cache.GetGeneration ());
+  BOOST_CHECK (cache.Lookup (name2, data));
+  BOOST_CHECK (data == data2);
+
+  auto stats = cache.GetStats ();
+  BOOST_CHECK_EQUAL (stats.size, 1);
+  BOOST_CHECK_EQUAL (stats.hits, 2);
+  BOOST_CHECK_EQUAL (stats.misses, 3);
+
+  /* With a small budget, least-recently used entries are evicted.  */
+  cache.SetMaxUsage (NameReadCache::SHARDS * 1000);
+  valtype last;
+  for (unsigned i = 0; i < 1000; ++i)
+    {
+      last = DecodeName ("x/" + std::to_string (i), NameEncoding::ASCII);
+      cache.Insert (last, makeData (last, i), cache.GetGeneration ());
+    }
+  stats = cache.GetStats ();
+  BOOST_CHECK (stats.size > 0 && stats.size < 1000);
+  BOOST_CHECK (stats.usage <= stats.maxUsage);
+  BOOST_CHECK (cache.Lookup (last, data));
+
+  /* Zero disables the cache.  */
+  cache.SetMaxUsage (0);
+  cache.Insert (name1, data1, cache.GetGeneration ());
+  stats = cache.GetStats ();
+  BOOST_CHECK_EQUAL (stats.size, 0);
+  BOOST_CHECK_EQUAL (stats.usage, 0);
+
+  /* Updates written to the coins DB are visible through cached reads.  */
+  CCoinsViewDB& db = ::ChainstateActive ().CoinsDB ();
+  {
+    CCoinsViewCache view(&db);
+    view.SetName (name1, data1, false);
+    view.SetBestBlock (uint256S ("01"));
+    BOOST_CHECK (view.Flush ());
+  }
+  BOOST_CHECK (db.GetName (name1, data));
+  BOOST_CHECK (db.GetName (name1, data));
+  BOOST_CHECK (data == data1);
+  const uint64_t hits = db.GetNameReadCacheStats ().hits;
+  BOOST_CHECK (hits > 0);
+  {
+    CCoinsViewCache view(&db);
+    view.SetName (name1, data2, false);
+    view.SetBestBlock (uint256S ("02"));
+    BOOST_CHECK (view.Flush ());
+  }
+  BOOST_CHECK (db.GetName (name1, data));
+  BOOST_CHECK (data == data2);
+  {
+    CCoinsViewCache view(&db);
+    view.DeleteName (name1);
+    view.SetBestBlock (uint256S ("03"));
+    BOOST_CHECK (view.Flush ());
+  }
+  BOOST_CHECK (!db.GetName (name1, data));
+}
+
 BOOST_AUTO_TEST_CASE (name_tx_verification)
 {
   const valtype name1 = DecodeName ("x/test-name-1", NameEncoding::ASCII);
@@ -629,6 +931,17 @@ BOOST_AUTO_TEST_CASE (name_tx_verification)
   mtx = CMutableTransaction (baseTx);
   mtx.vout.push_back (CTxOut (COIN, scrRegister));
   BOOST_CHECK (CheckNameTransaction (mtx, 200000, view, state));
+
+  /* Checking does not fill the name value cache, but returns the parsed
+     value for the caller to cache once the transaction is accepted.  */
+  {
+    const CTransaction tx(mtx);
+    std::shared_ptr<const ParsedNameValue> parsed;
+    BOOST_CHECK (CheckNameTransaction (tx, 200000, view, state, &parsed));
+    BOOST_CHECK (parsed != nullptr);
+    BOOST_CHECK (GetNameValueCache ().Lookup (tx.GetHash ()) == nullptr);
+  }
+
   mtx.vout.push_back (CTxOut (COIN, scrRegister));
   BOOST_CHECK (!CheckNameTransaction (mtx, 200000, view, state));
 
@@ -720,7 +1033,7 @@ BOOST_AUTO_TEST_CASE (name_tx_verification)
 BOOST_AUTO_TEST_CASE (name_updates_undo)
 {
   /* Enable name history to test this on the go.  */
-  fNameHistory = true;
+  NameHistoryEnabler history;
 
   const valtype name = DecodeName ("x/db-test-name", NameEncoding::ASCII);
   const valtype value1 = DecodeName (val ("old-value"), NameEncoding::ASCII);
@@ -731,7 +1044,6 @@ BOOST_AUTO_TEST_CASE (name_updates_undo)
   CCoinsViewCache view(&dummyView);
   CBlockUndo undo;
   CNameData data;
-  CNameHistory history;
 
   const CScript scrRegister
     = CNameScript::buildNameRegister (addr, name, value1);
@@ -747,7 +1059,7 @@ BOOST_AUTO_TEST_CASE (name_updates_undo)
   BOOST_CHECK (data.getHeight () == 200);
   BOOST_CHECK (data.getValue () == value1);
   BOOST_CHECK (data.getAddress () == addr);
-  BOOST_CHECK (!view.GetNameHistory (name, history));
+  BOOST_CHECK_EQUAL (view.GetNameHistorySize (name), 0);
   BOOST_CHECK (undo.vnameundo.size () == 1);
   const CNameData firstData = data;
 
@@ -758,9 +1070,10 @@ BOOST_AUTO_TEST_CASE (name_updates_undo)
   BOOST_CHECK (data.getHeight () == 300);
   BOOST_CHECK (data.getValue () == value2);
   BOOST_CHECK (data.getAddress () == addr);
-  BOOST_CHECK (view.GetNameHistory (name, history));
-  BOOST_CHECK (history.getData ().size () == 1);
-  BOOST_CHECK (history.getData ().back () == firstData);
+  BOOST_CHECK_EQUAL (view.GetNameHistorySize (name), 1);
+  BOOST_CHECK (view.GetNameHistoryEntry (name, 0, data));
+  BOOST_CHECK (data == firstData);
+  BOOST_CHECK (!view.GetNameHistoryEntry (name, 1, data));
   BOOST_CHECK (undo.vnameundo.size () == 2);
 
   undo.vnameundo.back ().apply (view);
@@ -768,16 +1081,358 @@ BOOST_AUTO_TEST_CASE (name_updates_undo)
   BOOST_CHECK (data.getHeight () == 200);
   BOOST_CHECK (data.getValue () == value1);
   BOOST_CHECK (data.getAddress () == addr);
-  BOOST_CHECK (!view.GetNameHistory (name, history) || history.empty ());
+  BOOST_CHECK_EQUAL (view.GetNameHistorySize (name), 0);
   undo.vnameundo.pop_back ();
 
   undo.vnameundo.back ().apply (view);
   BOOST_CHECK (!view.GetName (name, data));
-  BOOST_CHECK (!view.GetNameHistory (name, history) || history.empty ());
+  BOOST_CHECK_EQUAL (view.GetNameHistorySize (name), 0);
   undo.vnameundo.pop_back ();
   BOOST_CHECK (undo.vnameundo.empty ());
 }
 
+BOOST_AUTO_TEST_CASE (name_db_validation)
+{
+  const valtype name = DecodeName ("x/db-test-name", NameEncoding::ASCII);
+  const valtype value = DecodeName (val ("value"), NameEncoding::ASCII);
+  const CScript addr = getTestAddress ();
+  const CScript scrRegister
+    = CNameScript::buildNameRegister (addr, name, value);
+  const CScript scrUpdate = CNameScript::buildNameUpdate (addr, name, value);
+
+  CCoinsViewCache& view = ::ChainstateActive ().CoinsTip ();
+
+  const COutPoint outp1 = addTestCoin (scrRegister, 100, view);
+  CNameData data;
+  data.fromScript (100, outp1, CNameScript (scrRegister));
+  view.SetName (name, data, false);
+  BOOST_CHECK (ValidateNames (view, {name}));
+  BOOST_CHECK (view.Flush ());
+  BOOST_CHECK (view.ValidateNameDB ());
+
+  /* A second name output in the UTXO set is only found by the full check,
+     since the name's own record is still consistent.  */
+  const COutPoint outp2 = addTestCoin (scrUpdate, 101, view);
+  BOOST_CHECK (view.Flush ());
+  BOOST_CHECK (ValidateNames (view, {name}));
+  BOOST_CHECK (!view.ValidateNameDB ());
+
+  data.fromScript (101, outp2, CNameScript (scrUpdate));
+  view.SetName (name, data, false);
+  BOOST_CHECK (view.Flush ());
+  BOOST_CHECK (ValidateNames (view, {name}));
+  BOOST_CHECK (!view.ValidateNameDB ());
+
+  BOOST_CHECK (view.SpendCoin (outp1));
+  BOOST_CHECK (view.Flush ());
+  BOOST_CHECK (view.ValidateNameDB ());
+
+  /* The name's record points to a spent output.  */
+  BOOST_CHECK (view.SpendCoin (outp2));
+  BOOST_CHECK (!ValidateNames (view, {name}));
+  BOOST_CHECK (view.Flush ());
+  BOOST_CHECK (!view.ValidateNameDB ());
+}
+
+BOOST_AUTO_TEST_CASE (name_db_incremental_check)
+{
+  const valtype touched = DecodeName ("x/touched", NameEncoding::ASCII);
+  const valtype untouched = DecodeName ("x/untouched", NameEncoding::ASCII);
+  const valtype value = DecodeName (val ("value"), NameEncoding::ASCII);
+  const CScript addr = getTestAddress ();
+
+  CCoinsViewCache& view = ::ChainstateActive ().CoinsTip ();
+
+  std::map<valtype, COutPoint> outpoints;
+  for (const auto& name : {touched, untouched})
+    {
+      const CScript scr = CNameScript::buildNameRegister (addr, name, value);
+      outpoints[name] = addTestCoin (scr, 100, view);
+      CNameData data;
+      data.fromScript (100, outpoints[name], CNameScript (scr));
+      view.SetName (name, data, false);
+    }
+
+  CBlockUndo undo;
+  undo.vnameundo.emplace_back ();
+  undo.vnameundo.back ().fromOldState (touched, view);
+
+  LOCK (cs_main);
+
+  /* Without the incremental check, no names are recorded.  */
+  MarkNamesForCheck (undo);
+  BOOST_CHECK (view.SpendCoin (outpoints[touched]));
+  BOOST_CHECK (ValidateMarkedNames (view));
+  BOOST_CHECK (!ValidateNames (view, {touched}));
+
+  fCheckNameDBIncremental = true;
+
+  /* The touched name's record points to a spent output.  This is caught
+     through the cache, i.e. without flushing and a full ValidateNameDB.  */
+  MarkNamesForCheck (undo);
+  BOOST_CHECK (!ValidateMarkedNames (view));
+
+  /* The check clears the recorded names.  Corruption of a name that was
+     not touched is not found by the incremental check.  */
+  BOOST_CHECK (ValidateMarkedNames (view));
+  BOOST_CHECK (view.SpendCoin (outpoints[untouched]));
+  BOOST_CHECK (ValidateMarkedNames (view));
+  BOOST_CHECK (!ValidateNames (view, {untouched}));
+
+  fCheckNameDBIncremental = false;
+}
+
+BOOST_AUTO_TEST_CASE (name_history_layers)
+{
+  NameHistoryEnabler history;
+
+  const valtype name = DecodeName ("x/history", NameEncoding::ASCII);
+  const CScript addr = getTestAddress ();
+
+  std::vector<CNameData> entries;
+  for (unsigned i = 0; i < 5; ++i)
+    {
+      const valtype value = DecodeName (val ("value " + std::to_string (i)),
+                                        NameEncoding::ASCII);
+      const CScript scr = CNameScript::buildNameUpdate (addr, name, value);
+      CNameData data;
+      data.fromScript (100 + i, COutPoint (uint256 (), i), CNameScript (scr));
+      entries.push_back (data);
+    }
+
+  /* Checks that the history in the view matches the given entries.  */
+  const auto checkHistory = [&] (const CCoinsView& view, const size_t n)
+    {
+      BOOST_CHECK_EQUAL (view.GetNameHistorySize (name), n);
+      for (size_t i = 0; i < n; ++i)
+        {
+          CNameData data;
+          BOOST_CHECK (view.GetNameHistoryEntry (name, i, data));
+          BOOST_CHECK (data == entries[i]);
+        }
+      CNameData data;
+      BOOST_CHECK (!view.GetNameHistoryEntry (name, n, data));
+    };
+
+  CCoinsViewDB& db = ::ChainstateActive ().CoinsDB ();
+  CCoinsViewCache base(&db);
+
+  /* Build up the history in a child cache and flush it through.  */
+  {
+    CCoinsViewCache child(&base);
+    child.SetName (name, entries[0], false);
+    for (unsigned i = 1; i < 4; ++i)
+      child.SetName (name, entries[i], false);
+    checkHistory (child, 3);
+    BOOST_CHECK (child.Flush ());
+  }
+  checkHistory (base, 3);
+  base.SetBestBlock (uint256S ("01"));
+  BOOST_CHECK (base.Flush ());
+  checkHistory (db, 3);
+
+  /* Pop two entries and push one again in a child.  */
+  {
+    CCoinsViewCache child(&base);
+    child.SetName (name, entries[2], true);
+    child.SetName (name, entries[1], true);
+    checkHistory (child, 1);
+    child.SetName (name, entries[4], false);
+    BOOST_CHECK_EQUAL (child.GetNameHistorySize (name), 2);
+    CNameData data;
+    BOOST_CHECK (child.GetNameHistoryEntry (name, 1, data));
+    BOOST_CHECK (data == entries[1]);
+    BOOST_CHECK (child.Flush ());
+  }
+  BOOST_CHECK_EQUAL (base.GetNameHistorySize (name), 2);
+  checkHistory (db, 3);
+
+  base.SetBestBlock (uint256S ("02"));
+  BOOST_CHECK (base.Flush ());
+  checkHistory (db, 2);
+
+  /* Undo everything.  */
+  base.SetName (name, entries[1], true);
+  base.SetName (name, entries[0], true);
+  checkHistory (base, 0);
+  base.SetBestBlock (uint256S ("03"));
+  BOOST_CHECK (base.Flush ());
+  checkHistory (db, 0);
+}
+
+BOOST_AUTO_TEST_CASE (name_history_upgrade)
+{
+  NameHistoryEnabler history;
+
+  const valtype name1 = DecodeName ("x/name1", NameEncoding::ASCII);
+  const valtype name2 = DecodeName ("x/name2", NameEncoding::ASCII);
+  const valtype empty = DecodeName ("x/empty", NameEncoding::ASCII);
+  const CScript addr = getTestAddress ();
+
+  std::vector<CNameData> entries;
+  for (unsigned i = 0; i < 3; ++i)
+    {
+      const valtype value = DecodeName (val ("value " + std::to_string (i)),
+                                        NameEncoding::ASCII);
+      const CScript scr = CNameScript::buildNameUpdate (addr, name1, value);
+      CNameData data;
+      data.fromScript (100 + i, COutPoint (uint256 (), i), CNameScript (scr));
+      entries.push_back (data);
+    }
+
+  /* Write records in the old format, where the whole history stack of
+     a name is a single vector keyed by 'h' and the name.  */
+  const fs::path path = GetDataDir () / "name_history_upgrade";
+  {
+    CDBWrapper db(path, 1 << 20, false, true, true);
+    CDBBatch batch(db);
+    batch.Write (std::make_pair ('h', name1), entries);
+    batch.Write (std::make_pair ('h', name2),
+                 std::vector<CNameData> {entries[0]});
+    batch.Write (std::make_pair ('h', empty), std::vector<CNameData> ());
+    BOOST_CHECK (db.WriteBatch (batch));
+  }
+
+  {
+    CCoinsViewDB view(path, 1 << 20, false, false);
+    BOOST_CHECK (view.UpgradeNameHistory ());
+
+    BOOST_CHECK_EQUAL (view.GetNameHistorySize (name1), entries.size ());
+    for (unsigned i = 0; i < entries.size (); ++i)
+      {
+        CNameData data;
+        BOOST_CHECK (view.GetNameHistoryEntry (name1, i, data));
+        BOOST_CHECK (data == entries[i]);
+      }
+
+    BOOST_CHECK_EQUAL (view.GetNameHistorySize (name2), 1);
+    CNameData data;
+    BOOST_CHECK (view.GetNameHistoryEntry (name2, 0, data));
+    BOOST_CHECK (data == entries[0]);
+    BOOST_CHECK (!view.GetNameHistoryEntry (name2, 1, data));
+
+    BOOST_CHECK_EQUAL (view.GetNameHistorySize (empty), 0);
+    BOOST_CHECK (!view.GetNameHistoryEntry (empty, 0, data));
+
+    /* A second upgrade is a no-op.  */
+    BOOST_CHECK (view.UpgradeNameHistory ());
+    BOOST_CHECK_EQUAL (view.GetNameHistorySize (name1), entries.size ());
+  }
+
+  /* Check the raw keys:  There are no old records left, and exactly
+     one size record ('y') per non-empty history and one entry record ('Y')
+     per history entry.  */
+  CDBWrapper db(path, 1 << 20, false, false, true);
+  std::map<char, unsigned> counts;
+  std::unique_ptr<CDBIterator> cursor(db.NewIterator ());
+  for (cursor->SeekToFirst (); cursor->Valid (); cursor->Next ())
+    {
+      std::pair<char, valtype> key;
+      if (cursor->GetKey (key))
+        ++counts[key.first];
+    }
+  BOOST_CHECK_EQUAL (counts['h'], 0);
+  BOOST_CHECK_EQUAL (counts['y'], 2);
+  BOOST_CHECK_EQUAL (counts['Y'], entries.size () + 1);
+}
+
+BOOST_AUTO_TEST_CASE (name_cache_memory)
+{
+  NameHistoryEnabler history;
+
+  const valtype name1 = DecodeName ("x/name1", NameEncoding::ASCII);
+  const valtype name2 = DecodeName ("x/name2", NameEncoding::ASCII);
+  const CScript addr = getTestAddress ();
+
+  std::vector<CNameData> data;
+  for (unsigned i = 0; i < 4; ++i)
+    {
+      const valtype value
+          = DecodeName (val ("value " + std::string (10 * i, 'x')),
+                        NameEncoding::ASCII);
+      const CScript scr = CNameScript::buildNameUpdate (addr, name1, value);
+      CNameData cur;
+      cur.fromScript (100 + i, COutPoint (uint256 (), i), CNameScript (scr));
+      data.push_back (cur);
+    }
+
+  /* Entries and deleted marks are accounted such that the usage only
+     depends on the resulting state, not on how it was reached.  */
+  CNameCache cache;
+  BOOST_CHECK_EQUAL (cache.DynamicMemoryUsage (), 0);
+
+  cache.set (name1, data[0]);
+  cache.set (name2, data[1]);
+  cache.set (name1, data[3]);
+  {
+    CNameCache expected;
+    expected.set (name1, data[3]);
+    expected.set (name2, data[1]);
+    BOOST_CHECK_EQUAL (cache.DynamicMemoryUsage (),
+                       expected.DynamicMemoryUsage ());
+    BOOST_CHECK (cache.DynamicMemoryUsage () > 0);
+  }
+
+  cache.remove (name1);
+  cache.remove (name1);
+  {
+    CNameCache expected;
+    expected.set (name2, data[1]);
+    expected.remove (name1);
+    BOOST_CHECK_EQUAL (cache.DynamicMemoryUsage (),
+                       expected.DynamicMemoryUsage ());
+  }
+
+  cache.clear ();
+  BOOST_CHECK (cache.empty ());
+  BOOST_CHECK_EQUAL (cache.DynamicMemoryUsage (), 0);
+
+  /* Pushing history entries increases the usage, popping them releases
+     at least the entry's own data again.  */
+  cache.set (name1, data[3]);
+  const size_t withoutHistory = cache.DynamicMemoryUsage ();
+  cache.pushHistory (name1, 5, data[0]);
+  cache.pushHistory (name1, 6, data[1]);
+  const size_t withHistory = cache.DynamicMemoryUsage ();
+  BOOST_CHECK (withHistory > withoutHistory);
+  cache.popHistory (name1, 7);
+  BOOST_CHECK (cache.DynamicMemoryUsage () < withHistory);
+  BOOST_CHECK (cache.DynamicMemoryUsage () > withoutHistory);
+
+  /* Apply a child on top that pops below our pushed entries and pushes
+     new ones.  */
+  CNameCache child;
+  child.popHistory (name1, 6);
+  child.popHistory (name1, 5);
+  child.pushHistory (name1, 4, data[2]);
+  child.pushHistory (name1, 5, data[3]);
+  cache.apply (child);
+
+  const auto* change = cache.getHistory (name1);
+  BOOST_CHECK (change != nullptr);
+  BOOST_CHECK_EQUAL (change->size, 6);
+  BOOST_CHECK_EQUAL (change->maxSize, 7);
+  BOOST_CHECK_EQUAL (change->entries.size (), 2);
+  BOOST_CHECK (change->getEntry (3) == nullptr);
+  BOOST_CHECK (*change->getEntry (4) == data[2]);
+  BOOST_CHECK (*change->getEntry (5) == data[3]);
+  BOOST_CHECK (change->getEntry (6) == nullptr);
+
+  const size_t usage = cache.DynamicMemoryUsage ();
+  cache.popHistory (name1, 6);
+  cache.popHistory (name1, 5);
+  BOOST_CHECK (cache.DynamicMemoryUsage () < usage);
+
+  cache.clear ();
+  BOOST_CHECK_EQUAL (cache.DynamicMemoryUsage (), 0);
+
+  /* The name cache is included in the coins cache's usage.  */
+  CCoinsViewCache view(&::ChainstateActive ().CoinsTip ());
+  const size_t viewUsage = view.DynamicMemoryUsage ();
+  view.SetName (name1, data[0], false);
+  BOOST_CHECK (view.DynamicMemoryUsage () > viewUsage);
+}
+
 /* ************************************************************************** */
 
 BOOST_AUTO_TEST_CASE (encoding_to_from_string)
@@ -138,6 +138,7 @@ BOOST_AUTO_TEST_CASE(GetBlockProofEquivalentTime_test)
           blocks[i].algo = PowAlgo::SHA256D;
         else
           blocks[i].algo = PowAlgo::NEOSCRYPT;
+        blocks[i].BuildSkip();
         blocks[i].nChainWork = i ? blocks[i - 1].nChainWork + GetBlockProof(blocks[i - 1]) : arith_uint256(0);
     }
 
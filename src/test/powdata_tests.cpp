@@ -13,6 +13,7 @@
 #include <test/setup_common.h>
 #include <uint256.h>
 #include <util/strencodings.h>
+#include <validation.h>
 
 #include <boost/test/unit_test.hpp>
 
@@ -275,6 +276,61 @@ BOOST_FIXTURE_TEST_CASE (fakeHeader_pow, ValidationSetup)
   BOOST_CHECK (pow.isValid (hash, params));
 }
 
+BOOST_FIXTURE_TEST_CASE (fakeHeader_powCache, ValidationSetup)
+{
+  /* The PoW cache must not confuse headers that differ only in their
+     PowData, since the block hash does not commit to it.  */
+  block.pow.setCoreAlgo (PowAlgo::NEOSCRYPT);
+  block.pow.setBits (bitsRegtest);
+  auto& fakeHeader = block.pow.initFakeHeader (block);
+
+  MineHeader (fakeHeader, block.pow, params, true);
+  BOOST_CHECK (CheckProofOfWork (block, params));
+  BOOST_CHECK (CheckProofOfWork (block, params));
+
+  MineHeader (fakeHeader, block.pow, params, false);
+  BOOST_CHECK (!CheckProofOfWork (block, params));
+  BOOST_CHECK (!CheckProofOfWork (block, params));
+
+  MineHeader (fakeHeader, block.pow, params, true);
+  BOOST_CHECK (CheckProofOfWork (block, params));
+}
+
+BOOST_FIXTURE_TEST_CASE (precheckHeadersPow, ValidationSetup)
+{
+  /* An invalid header stops the pre-check, so that headers after its batch
+     are not hashed at all.  */
+  std::vector<CBlockHeader> headers;
+  for (unsigned i = 0; i < 3 * POW_PRECHECK_BATCH; ++i)
+    {
+      CBlockHeader hdr;
+      hdr.nTime = 1000 + i;
+      hdr.pow.setCoreAlgo (PowAlgo::NEOSCRYPT);
+      hdr.pow.setBits (bitsRegtest);
+      auto& fakeHeader = hdr.pow.initFakeHeader (hdr);
+      MineHeader (fakeHeader, hdr.pow, params, true);
+      headers.push_back (hdr);
+    }
+  BOOST_CHECK_EQUAL (PrecheckHeadersPow (headers, params), headers.size ());
+
+  const unsigned bad = POW_PRECHECK_BATCH + 2;
+  for (auto& hdr : headers)
+    ++hdr.nTime;
+  for (auto& hdr : headers)
+    {
+      auto& fakeHeader = hdr.pow.initFakeHeader (hdr);
+      MineHeader (fakeHeader, hdr.pow, params, &hdr != &headers[bad]);
+    }
+  BOOST_CHECK_EQUAL (PrecheckHeadersPow (headers, params),
+                     2 * POW_PRECHECK_BATCH);
+
+  /* A header that fails the cheap checks is not even hashed.  */
+  auto& fakeHeader = headers[bad].pow.initFakeHeader (headers[bad]);
+  MineHeader (fakeHeader, headers[bad].pow, params, true);
+  ++headers[bad].nTime;
+  BOOST_CHECK_EQUAL (PrecheckHeadersPow (headers, params), bad);
+}
+
 /* Tests for validation of a merge-mined PoW.  */
 
 BOOST_FIXTURE_TEST_CASE (auxpow_unset, ValidationSetupSha)
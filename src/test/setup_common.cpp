@@ -9,9 +9,12 @@
 #include <consensus/consensus.h>
 #include <consensus/params.h>
 #include <consensus/validation.h>
+#include <crypto/neoscrypt_multi.h>
 #include <crypto/sha256.h>
+#include <headercache.h>
 #include <init.h>
 #include <miner.h>
+#include <names/valuecache.h>
 #include <net.h>
 #include <noui.h>
 #include <pow.h>
@@ -52,11 +55,15 @@ BasicTestingSetup::BasicTestingSetup(const std::string& chainName)
     InitLogging();
     LogInstance().StartLogging();
     SHA256AutoDetect();
+    NeoscryptAutoDetect();
     ECC_Start();
     SetupEnvironment();
     SetupNetworking();
     InitSignatureCache();
     InitScriptExecutionCache();
+    InitPowCache();
+    InitNameValueCache();
+    InitHeaderCache();
     fCheckBlockIndex = true;
     static bool noui_connected = false;
     if (!noui_connected) {
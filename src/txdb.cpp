@@ -12,6 +12,7 @@
 #include <shutdown.h>
 #include <ui_interface.h>
 #include <uint256.h>
+#include <util/memory.h>
 #include <util/system.h>
 #include <util/translation.h>
 #include <util/vector.h>
@@ -19,6 +20,9 @@
 
 #include <stdint.h>
 
+#include <atomic>
+#include <thread>
+
 #include <boost/thread.hpp>
 
 static const char DB_COIN = 'C';
@@ -28,6 +32,9 @@ static const char DB_BLOCK_INDEX = 'b';
 
 static const char DB_NAME = 'n';
 static const char DB_NAME_HISTORY = 'h';
+static const char DB_NAME_HISTORY_SIZE = 'y';
+static const char DB_NAME_HISTORY_ENTRY = 'Y';
+static const char DB_NAME_SCAN = 'N';
 
 static const char DB_BEST_BLOCK = 'B';
 static const char DB_HEAD_BLOCKS = 'H';
@@ -57,9 +64,60 @@ struct CoinEntry {
     }
 };
 
+/**
+ * Key of the lexicographic name index.  Unlike DB_NAME, the name is
+ * written without a length prefix, so that LevelDB orders the entries
+ * byte-wise lexicographically.
+ */
+struct NameScanEntry {
+    valtype* name;
+    char key;
+    explicit NameScanEntry(const valtype* ptr) : name(const_cast<valtype*>(ptr)), key(DB_NAME_SCAN) {}
+
+    template<typename Stream>
+    void Serialize(Stream &s) const {
+        s << key;
+        s.write(reinterpret_cast<const char*>(name->data()), name->size());
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        s >> key;
+        name->resize(s.size());
+        s.read(reinterpret_cast<char*>(name->data()), name->size());
+    }
+};
+
+/**
+ * Key of an entry in a name's history stack.  The index is written in
+ * big-endian, so that the entries of a name are ordered by index.
+ */
+struct NameHistoryEntry {
+    valtype* name;
+    uint32_t index;
+    char key;
+    NameHistoryEntry(const valtype* ptr, uint32_t i) : name(const_cast<valtype*>(ptr)), index(i), key(DB_NAME_HISTORY_ENTRY) {}
+
+    template<typename Stream>
+    void Serialize(Stream &s) const {
+        s << key;
+        s << *name;
+        ser_writedata32be(s, index);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        s >> key;
+        s >> *name;
+        index = ser_readdata32be(s);
+    }
+};
+
 }
 
-CCoinsViewDB::CCoinsViewDB(fs::path ldb_path, size_t nCacheSize, bool fMemory, bool fWipe) : db(ldb_path, nCacheSize, fMemory, fWipe, true)
+CCoinsViewDB::CCoinsViewDB(fs::path ldb_path, size_t nCacheSize, bool fMemory, bool fWipe)
+    : db(ldb_path, nCacheSize, fMemory, fWipe, true),
+      nameReadCache(std::max<int64_t>(0, gArgs.GetArg("-namereadcache", DEFAULT_NAME_READ_CACHE)) << 20)
 {
 }
 
@@ -87,12 +145,28 @@ std::vector<uint256> CCoinsViewDB::GetHeadBlocks() const {
 }
 
 bool CCoinsViewDB::GetName(const valtype &name, CNameData& data) const {
-    return db.Read(std::make_pair(DB_NAME, name), data);
+    if (nameReadCache.Lookup(name, data))
+        return true;
+
+    const uint64_t generation = nameReadCache.GetGeneration();
+    if (!db.Read(std::make_pair(DB_NAME, name), data))
+        return false;
+
+    nameReadCache.Insert(name, data, generation);
+    return true;
+}
+
+uint32_t CCoinsViewDB::GetNameHistorySize(const valtype &name) const {
+    assert (fNameHistory);
+    uint32_t size;
+    if (!db.Read(std::make_pair(DB_NAME_HISTORY_SIZE, name), size))
+        return 0;
+    return size;
 }
 
-bool CCoinsViewDB::GetNameHistory(const valtype &name, CNameHistory& data) const {
+bool CCoinsViewDB::GetNameHistoryEntry(const valtype &name, uint32_t index, CNameData& data) const {
     assert (fNameHistory);
-    return db.Read(std::make_pair(DB_NAME_HISTORY, name), data);
+    return db.Read(NameHistoryEntry(&name, index), data);
 }
 
 class CDbNameIterator : public CNameIterator
@@ -100,16 +174,26 @@ class CDbNameIterator : public CNameIterator
 
 private:
 
+    /**
+     * The database snapshot iterated over.  It is also used to look up
+     * the data for names in the lexicographic index.
+     */
+    std::shared_ptr<const CDBSnapshot> snapshot;
+
     /** The backing LevelDB iterator.  */
     std::unique_ptr<CDBIterator> iter;
 
+    /** Whether to iterate the lexicographic index instead of DB_NAME.  */
+    const bool lexicographic;
+
 public:
 
     /**
-     * Construct a new name iterator for the database.
-     * @param db The database to create the iterator for.
+     * Construct a new name iterator for a database snapshot.
+     * @param s The snapshot to create the iterator for.
+     * @param lex Whether to iterate in lexicographic order.
      */
-    CDbNameIterator(const CDBWrapper& db);
+    CDbNameIterator(std::shared_ptr<const CDBSnapshot> s, bool lex);
 
     /* Implement iterator methods.  */
     void seek (const valtype& start);
@@ -117,20 +201,37 @@ public:
 
 };
 
-CDbNameIterator::CDbNameIterator(const CDBWrapper& db)
-    : iter(const_cast<CDBWrapper*>(&db)->NewIterator())
+CDbNameIterator::CDbNameIterator(std::shared_ptr<const CDBSnapshot> s, const bool lex)
+    : snapshot(std::move(s)), iter(snapshot->NewIterator()),
+      lexicographic(lex)
 {
     seek(valtype());
 }
 
 void CDbNameIterator::seek(const valtype& start) {
-    iter->Seek(std::make_pair(DB_NAME, start));
+    if (lexicographic)
+        iter->Seek(NameScanEntry(&start));
+    else
+        iter->Seek(std::make_pair(DB_NAME, start));
 }
 
 bool CDbNameIterator::next(valtype& name, CNameData& data) {
     if (!iter->Valid())
         return false;
 
+    if (lexicographic) {
+        NameScanEntry key(&name);
+        if (!iter->GetKey(key) || key.key != DB_NAME_SCAN)
+            return false;
+
+        if (!snapshot->Read(std::make_pair(DB_NAME, name), data))
+            return error("%s : name %s in scan index but not in DB",
+                         __func__, EncodeNameForMessage(name));
+
+        iter->Next ();
+        return true;
+    }
+
     std::pair<char, valtype> key;
     if (!iter->GetKey(key) || key.first != DB_NAME)
         return false;
@@ -144,7 +245,41 @@ bool CDbNameIterator::next(valtype& name, CNameData& data) {
 }
 
 CNameIterator* CCoinsViewDB::IterateNames() const {
-    return new CDbNameIterator(db);
+    return new CDbNameIterator(std::make_shared<CDBSnapshot>(db), false);
+}
+
+CNameIterator* CCoinsViewDB::IterateNamesLexicographic() const {
+    assert(fNameScanIndex);
+    return new CDbNameIterator(std::make_shared<CDBSnapshot>(db), true);
+}
+
+std::unique_ptr<CCoinsViewDBSnapshot> CCoinsViewDB::GetSnapshot() const {
+    return MakeUnique<CCoinsViewDBSnapshot>(db);
+}
+
+CCoinsViewDBSnapshot::CCoinsViewDBSnapshot(const CDBWrapper& db)
+    : snapshot(std::make_shared<CDBSnapshot>(db))
+{
+}
+
+uint256 CCoinsViewDBSnapshot::GetBestBlock() const {
+    uint256 hashBestChain;
+    if (!snapshot->Read(DB_BEST_BLOCK, hashBestChain))
+        return uint256();
+    return hashBestChain;
+}
+
+bool CCoinsViewDBSnapshot::GetName(const valtype &name, CNameData& data) const {
+    return snapshot->Read(std::make_pair(DB_NAME, name), data);
+}
+
+CNameIterator* CCoinsViewDBSnapshot::IterateNames() const {
+    return new CDbNameIterator(snapshot, false);
+}
+
+CNameIterator* CCoinsViewDBSnapshot::IterateNamesLexicographic() const {
+    assert(fNameScanIndex);
+    return new CDbNameIterator(snapshot, true);
 }
 
 bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, const CNameCache &names) {
@@ -206,6 +341,7 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, con
 
     LogPrint(BCLog::COINDB, "Writing final batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
     bool ret = db.WriteBatch(batch);
+    nameReadCache.Invalidate(names);
     LogPrint(BCLog::COINDB, "Committed %u changed transaction outputs (out of %u) to coin database...\n", (unsigned int)changed, (unsigned int)count);
     return ret;
 }
@@ -305,131 +441,335 @@ bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockF
 
 bool CCoinsViewDB::ValidateNameDB() const
 {
-    /* It seems that there are no "const iterators" for LevelDB.  Since we
-       only need read operations on it, use a const-cast to get around
-       that restriction.  */
-    std::unique_ptr<CDBIterator> pcursor(const_cast<CDBWrapper*>(&db)->NewIterator());
-    pcursor->SeekToFirst();
+    return CCoinsViewDBSnapshot(db).ValidateNameDB();
+}
+
+namespace {
+
+/**
+ * Consistency check of the name database in a snapshot.  The work is split
+ * into independent tasks (ranges of the UTXO set, the name records, the
+ * name history and the scan index), which are run by a pool of threads.
+ *
+ * The check streams over the database and never keeps the set of all
+ * names in memory:  Each name output in the UTXO set is looked up in
+ * the name records and must be the output recorded there for its name.
+ * Since no two outputs can match the same record, it is then enough to
+ * compare the number of name outputs and name records at the end.
+ */
+class NameDBChecker
+{
+private:
+    //! Number of ranges the UTXO set is split into (by first txid byte).
+    static constexpr unsigned COIN_PARTITIONS = 16;
+    //! The tasks other than the UTXO ranges.
+    enum OtherTask { TASK_NAMES, TASK_HISTORY, TASK_SCAN_INDEX, OTHER_TASKS };
+    //! Total number of tasks.
+    static constexpr unsigned NUM_TASKS = OTHER_TASKS + COIN_PARTITIONS;
+
+    const CDBSnapshot& snapshot;
+
+    std::atomic<bool> failed{false};
+    std::atomic<unsigned> nextTask{0};
+    std::atomic<unsigned> coinPartitionsDone{0};
+
+    std::atomic<uint64_t> nameOutputs{0};
+    std::atomic<uint64_t> names{0};
+    std::atomic<uint64_t> namesWithHistory{0};
+    std::atomic<uint64_t> scanEntries{0};
+
+    //! Returns whether the cursor is at a record of the given type.
+    static bool AtType(CDBIterator& cursor, char type);
+
+    bool CheckCoins(unsigned partition);
+    bool CheckNames();
+    bool CheckHistory();
+    bool CheckScanIndex();
+
+    //! Runs tasks until all are done or one of them failed.
+    void Work();
+
+public:
+    explicit NameDBChecker(const CDBSnapshot& s) : snapshot(s) {}
 
-    /* Loop over the total database and read interesting
-       things to memory.  We later use that to check
-       everything against each other.  */
+    bool Run();
+};
+
+bool NameDBChecker::AtType(CDBIterator& cursor, const char type)
+{
+    char chType = 0;
+    return cursor.Valid() && cursor.GetKey(chType) && chType == type;
+}
+
+bool NameDBChecker::CheckCoins(const unsigned partition)
+{
+    const unsigned begin = partition * 256 / COIN_PARTITIONS;
+    const unsigned end = (partition + 1) * 256 / COIN_PARTITIONS;
 
-    std::set<valtype> namesInDB;
-    std::set<valtype> namesInUTXO;
-    std::set<valtype> namesWithHistory;
+    COutPoint outpoint;
+    *outpoint.hash.begin() = begin;
+    outpoint.n = 0;
 
-    for (; pcursor->Valid(); pcursor->Next())
+    std::unique_ptr<CDBIterator> pcursor(snapshot.NewIterator());
+    for (pcursor->Seek(CoinEntry(&outpoint)); !failed && AtType(*pcursor, DB_COIN); pcursor->Next())
     {
         boost::this_thread::interruption_point();
-        char chType;
-        if (!pcursor->GetKey(chType))
+        CoinEntry entry(&outpoint);
+        if (!pcursor->GetKey(entry))
+            return error("%s : failed to read coin key", __func__);
+        if (*outpoint.hash.begin() >= end)
+            break;
+
+        Coin coin;
+        if (!pcursor->GetValue(coin))
+            return error("%s : failed to read coin", __func__);
+        if (coin.out.IsNull())
             continue;
 
-        switch (chType)
-        {
-        case DB_COIN:
-        {
-            Coin coin;
-            if (!pcursor->GetValue(coin))
-                return error("%s : failed to read coin", __func__);
+        const CNameScriptView nameOp(coin.out.scriptPubKey);
+        if (!nameOp.isNameOp())
+            continue;
+        const valtype name(nameOp.getOpName().begin(), nameOp.getOpName().end());
 
-            if (!coin.out.IsNull())
-            {
-                const CNameScript nameOp(coin.out.scriptPubKey);
-                if (nameOp.isNameOp() && nameOp.isAnyUpdate())
-                {
-                    const valtype& name = nameOp.getOpName();
-                    if (namesInUTXO.count(name) > 0)
-                        return error("%s : name %s duplicated in UTXO set",
-                                     __func__, EncodeNameForMessage(name));
-                    namesInUTXO.insert(nameOp.getOpName());
-                }
-            }
-            break;
-        }
+        CNameData data;
+        if (!snapshot.Read(std::make_pair(DB_NAME, name), data))
+            return error("%s : name '%s' in UTXO set but not DB",
+                         __func__, EncodeNameForMessage(name));
+        if (data.getUpdateOutpoint() != outpoint)
+            return error("%s : name '%s' duplicated in UTXO set or its"
+                         " DB entry is outdated",
+                         __func__, EncodeNameForMessage(name));
+        ++nameOutputs;
+    }
 
-        case DB_NAME:
-        {
-            std::pair<char, valtype> key;
-            if (!pcursor->GetKey(key) || key.first != DB_NAME)
-                return error("%s : failed to read DB_NAME key", __func__);
-            const valtype& name = key.second;
+    // report max. every 10% step
+    const unsigned done = ++coinPartitionsDone;
+    const unsigned percentageDone = done * 100 / COIN_PARTITIONS;
+    if (percentageDone / 10 != (done - 1) * 100 / COIN_PARTITIONS / 10)
+        LogPrintf("Checking name database... [%d%%]\n", percentageDone);
 
-            CNameData data;
-            if (!pcursor->GetValue(data))
-                return error("%s : failed to read name value", __func__);
+    return true;
+}
 
-            assert(namesInDB.count(name) == 0);
-            namesInDB.insert(name);
-            break;
-        }
+bool NameDBChecker::CheckNames()
+{
+    std::unique_ptr<CDBIterator> pcursor(snapshot.NewIterator());
+    for (pcursor->Seek(DB_NAME); !failed && AtType(*pcursor, DB_NAME); pcursor->Next())
+    {
+        boost::this_thread::interruption_point();
+        CNameData data;
+        if (!pcursor->GetValue(data))
+            return error("%s : failed to read name value", __func__);
+        ++names;
+    }
+
+    return true;
+}
+
+bool NameDBChecker::CheckHistory()
+{
+    std::unique_ptr<CDBIterator> pcursor(snapshot.NewIterator());
+    pcursor->Seek(DB_NAME_HISTORY);
+    if (AtType(*pcursor, DB_NAME_HISTORY))
+        return error("%s : name history in the old format", __func__);
+
+    /* The size records and the entries are both keyed by the serialised
+       name, so they are in the same order.  Walk them in lockstep, which
+       also finds entries without a matching size record.  */
+    std::unique_ptr<CDBIterator> entries(snapshot.NewIterator());
+    entries->Seek(DB_NAME_HISTORY_ENTRY);
+
+    for (pcursor->Seek(DB_NAME_HISTORY_SIZE); !failed && AtType(*pcursor, DB_NAME_HISTORY_SIZE); pcursor->Next())
+    {
+        boost::this_thread::interruption_point();
+        if (!fNameHistory)
+            return error("%s : name_history entries in DB, but"
+                         " -namehistory not set", __func__);
+
+        std::pair<char, valtype> key;
+        if (!pcursor->GetKey(key))
+            return error("%s : failed to read DB_NAME_HISTORY_SIZE key",
+                         __func__);
+        const valtype& name = key.second;
+
+        uint32_t size;
+        if (!pcursor->GetValue(size))
+            return error("%s : failed to read name history size",
+                         __func__);
+        if (size == 0)
+            return error("%s : name '%s' has an empty history record",
+                         __func__, EncodeNameForMessage(name));
+
+        CNameData data;
+        if (!snapshot.Read(std::make_pair(DB_NAME, name), data))
+            return error("%s : history entry for name '%s' not in main DB",
+                         __func__, EncodeNameForMessage(name));
 
-        case DB_NAME_HISTORY:
+        for (uint32_t i = 0; i < size; ++i, entries->Next())
         {
-            std::pair<char, valtype> key;
-            if (!pcursor->GetKey(key) || key.first != DB_NAME_HISTORY)
-                return error("%s : failed to read DB_NAME_HISTORY key",
-                             __func__);
-            const valtype& name = key.second;
-
-            if (namesWithHistory.count(name) > 0)
-                return error("%s : name %s has duplicate history",
-                             __func__, EncodeNameForMessage(name));
-            namesWithHistory.insert(name);
-            break;
+            valtype entryName;
+            NameHistoryEntry entryKey(&entryName, 0);
+            if (!AtType(*entries, DB_NAME_HISTORY_ENTRY)
+                    || !entries->GetKey(entryKey)
+                    || entryName != name || entryKey.index != i)
+                return error("%s : history entries for name '%s' do not match"
+                             " its size", __func__, EncodeNameForMessage(name));
         }
 
-        default:
-            break;
-        }
+        ++namesWithHistory;
     }
 
-    /* Now verify the collected data.  */
+    if (!failed && AtType(*entries, DB_NAME_HISTORY_ENTRY))
+        return error("%s : name history entries without a size record",
+                     __func__);
 
-    for (const auto& name : namesInDB)
-        if (namesInUTXO.count(name) == 0)
-            return error("%s : name '%s' in DB but not UTXO set",
-                         __func__, EncodeNameForMessage(name));
-    for (const auto& name : namesInUTXO)
-        if (namesInDB.count(name) == 0)
-            return error("%s : name '%s' in UTXO set but not DB",
+    return true;
+}
+
+bool NameDBChecker::CheckScanIndex()
+{
+    std::unique_ptr<CDBIterator> pcursor(snapshot.NewIterator());
+    for (pcursor->Seek(DB_NAME_SCAN); !failed && AtType(*pcursor, DB_NAME_SCAN); pcursor->Next())
+    {
+        boost::this_thread::interruption_point();
+        if (!fNameScanIndex)
+            return error("%s : name scan index entries in DB, but"
+                         " -namescanindex not set", __func__);
+
+        valtype name;
+        NameScanEntry key(&name);
+        if (!pcursor->GetKey(key))
+            return error("%s : failed to read DB_NAME_SCAN key", __func__);
+
+        CNameData data;
+        if (!snapshot.Read(std::make_pair(DB_NAME, name), data))
+            return error("%s : name '%s' in scan index but not in DB",
                          __func__, EncodeNameForMessage(name));
+        ++scanEntries;
+    }
+
+    return true;
+}
 
-    if (fNameHistory)
+void NameDBChecker::Work()
+{
+    while (!failed)
     {
-        for (const auto& name : namesWithHistory)
-            if (namesInDB.count(name) == 0)
-                return error("%s : history entry for name '%s' not in main DB",
-                             __func__, EncodeNameForMessage(name));
-    } else if (!namesWithHistory.empty ())
-        return error("%s : name_history entries in DB, but"
-                     " -namehistory not set", __func__);
+        const unsigned task = nextTask++;
+        if (task >= NUM_TASKS)
+            return;
+
+        bool ok;
+        try {
+            switch (task)
+            {
+            case TASK_NAMES:
+                ok = CheckNames();
+                break;
+            case TASK_HISTORY:
+                ok = CheckHistory();
+                break;
+            case TASK_SCAN_INDEX:
+                ok = CheckScanIndex();
+                break;
+            default:
+                ok = CheckCoins(task - OTHER_TASKS);
+                break;
+            }
+        } catch (const std::exception& e) {
+            ok = error("%s : %s", __func__, e.what());
+        }
+
+        if (!ok)
+            failed = true;
+    }
+}
+
+bool NameDBChecker::Run()
+{
+    unsigned numThreads = std::max(GetNumCores(), 1);
+    if (numThreads > NUM_TASKS)
+        numThreads = NUM_TASKS;
+
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < numThreads; ++i)
+        threads.emplace_back([this, i] ()
+          {
+            const std::string name = strprintf("namecheck.%d", i);
+            TraceThread(name.c_str(), [this] () { Work(); });
+          });
+    /* The calling thread is the only one that can be interrupted.  If it is,
+       stop the other workers as well before passing on the interruption.  */
+    try {
+        Work();
+    } catch (const boost::thread_interrupted&) {
+        failed = true;
+        for (auto& t : threads)
+            t.join();
+        throw;
+    }
+    for (auto& t : threads)
+        t.join();
+
+    if (failed)
+        return false;
+
+    if (nameOutputs != names)
+        return error("%s : %u names in DB but %u in UTXO set",
+                     __func__, names.load(), nameOutputs.load());
+    if (fNameScanIndex && scanEntries != names)
+        return error("%s : name scan index does not match the name DB",
+                     __func__);
 
-    LogPrintf("Checked name database, %u names.\n", namesInDB.size());
-    LogPrintf("Names with history: %u\n", namesWithHistory.size());
+    LogPrintf("Checked name database, %u names.\n", names.load());
+    LogPrintf("Names with history: %u\n", namesWithHistory.load());
 
     return true;
 }
 
+} // namespace
+
+bool CCoinsViewDBSnapshot::ValidateNameDB() const
+{
+    return NameDBChecker(*snapshot).Run();
+}
+
 void
 CNameCache::writeBatch (CDBBatch& batch) const
 {
   for (EntryMap::const_iterator i = entries.begin ();
        i != entries.end (); ++i)
-    batch.Write (std::make_pair (DB_NAME, i->first), i->second);
+    {
+      batch.Write (std::make_pair (DB_NAME, i->first), i->second);
+      if (fNameScanIndex)
+        batch.Write (NameScanEntry (&i->first), '\0');
+    }
 
   for (std::set<valtype>::const_iterator i = deleted.begin ();
        i != deleted.end (); ++i)
-    batch.Erase (std::make_pair (DB_NAME, *i));
+    {
+      batch.Erase (std::make_pair (DB_NAME, *i));
+      if (fNameScanIndex)
+        batch.Erase (NameScanEntry (&*i));
+    }
 
   assert (fNameHistory || history.empty ());
-  for (std::map<valtype, CNameHistory>::const_iterator i = history.begin ();
-       i != history.end (); ++i)
-    if (i->second.empty ())
-      batch.Erase (std::make_pair (DB_NAME_HISTORY, i->first));
-    else
-      batch.Write (std::make_pair (DB_NAME_HISTORY, i->first), i->second);
+  for (const auto& h : history)
+    {
+      const valtype& name = h.first;
+      const HistoryChange& change = h.second;
+
+      if (change.size == 0)
+        batch.Erase (std::make_pair (DB_NAME_HISTORY_SIZE, name));
+      else
+        batch.Write (std::make_pair (DB_NAME_HISTORY_SIZE, name), change.size);
+
+      uint32_t index = change.size - change.entries.size ();
+      for (const auto& e : change.entries)
+        batch.Write (NameHistoryEntry (&name, index++), e);
+      for (uint32_t i = change.size; i < change.maxSize; ++i)
+        batch.Erase (NameHistoryEntry (&name, i));
+    }
 }
 
 bool CBlockTreeDB::WriteFlag(const std::string &name, bool fValue) {
@@ -613,3 +953,56 @@ bool CCoinsViewDB::Upgrade() {
     LogPrintf("[%s].\n", ShutdownRequested() ? "CANCELLED" : "DONE");
     return !ShutdownRequested();
 }
+
+bool CCoinsViewDB::UpgradeNameHistory() {
+    std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
+    pcursor->Seek(std::make_pair(DB_NAME_HISTORY, valtype()));
+    /* Seek lands on whatever key follows, so check that there actually
+       is a record in the old format before doing anything.  */
+    std::pair<char, valtype> key;
+    if (!pcursor->Valid() || !pcursor->GetKey(key) || key.first != DB_NAME_HISTORY) {
+        return true;
+    }
+
+    int64_t count = 0;
+    LogPrintf("Upgrading name history database...\n");
+    size_t batch_size = 1 << 24;
+    CDBBatch batch(db);
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        if (ShutdownRequested()) {
+            break;
+        }
+        if (!pcursor->GetKey(key) || key.first != DB_NAME_HISTORY) {
+            break;
+        }
+
+        /* The old format is the serialised stack of all entries.  */
+        std::vector<CNameData> entries;
+        if (!pcursor->GetValue(entries)) {
+            return error("%s: cannot parse name history record", __func__);
+        }
+        const valtype& name = key.second;
+        for (uint32_t i = 0; i < entries.size(); ++i) {
+            batch.Write(NameHistoryEntry(&name, i), entries[i]);
+        }
+        if (!entries.empty()) {
+            batch.Write(std::make_pair(DB_NAME_HISTORY_SIZE, name), static_cast<uint32_t>(entries.size()));
+        }
+        batch.Erase(key);
+        ++count;
+
+        if (batch.SizeEstimate() > batch_size) {
+            if (!db.WriteBatch(batch)) {
+                return error("%s: failed to write name history batch", __func__);
+            }
+            batch.Clear();
+        }
+        pcursor->Next();
+    }
+    if (!db.WriteBatch(batch)) {
+        return error("%s: failed to write name history batch", __func__);
+    }
+    LogPrintf("Upgraded name history for %d names [%s].\n", count, ShutdownRequested() ? "CANCELLED" : "DONE");
+    return !ShutdownRequested();
+}
@@ -9,6 +9,7 @@
 #include <coins.h>
 #include <dbwrapper.h>
 #include <chain.h>
+#include <names/readcache.h>
 #include <primitives/block.h>
 
 #include <memory>
@@ -18,6 +19,7 @@
 
 class CBlockIndex;
 class CCoinsViewDBCursor;
+class CCoinsViewDBSnapshot;
 class uint256;
 
 //! No need to periodic flush if at least this much space still available.
@@ -36,6 +38,8 @@ static const int64_t nMaxBlockDBCache = 2;
 // Unlike for the UTXO database, for the txindex scenario the leveldb cache make
 // a meaningful difference: https://github.com/bitcoin/bitcoin/pull/8273#issuecomment-229601991
 static const int64_t nMaxTxIndexCache = 1024;
+//! Max memory allocated to the game index database cache (MiB)
+static const int64_t nMaxGameIndexCache = 1024;
 //! Max memory allocated to all block filter index caches combined in MiB.
 static const int64_t max_filter_index_cache = 1024;
 //! Max memory allocated to coin DB specific cache (MiB)
@@ -46,6 +50,8 @@ class CCoinsViewDB final : public CCoinsView
 {
 protected:
     CDBWrapper db;
+    //! Cache of name data read from the database.
+    mutable NameReadCache nameReadCache;
 public:
     /**
      * @param[in] ldb_path    Location in the filesystem where leveldb data will be stored.
@@ -57,15 +63,44 @@ public:
     uint256 GetBestBlock() const override;
     std::vector<uint256> GetHeadBlocks() const override;
     bool GetName(const valtype &name, CNameData &data) const override;
-    bool GetNameHistory(const valtype &name, CNameHistory &data) const override;
+    uint32_t GetNameHistorySize(const valtype &name) const override;
+    bool GetNameHistoryEntry(const valtype &name, uint32_t index, CNameData &data) const override;
     CNameIterator* IterateNames() const override;
+    CNameIterator* IterateNamesLexicographic() const override;
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, const CNameCache &names) override;
     CCoinsViewCursor *Cursor() const override;
     bool ValidateNameDB() const override;
 
     //! Attempt to update from an older database format. Returns whether an error occurred.
     bool Upgrade();
+    //! Convert name history stacks stored as single records to one record per entry.
+    bool UpgradeNameHistory();
     size_t EstimateSize() const override;
+
+    //! Take a consistent snapshot of the current database state.
+    std::unique_ptr<CCoinsViewDBSnapshot> GetSnapshot() const;
+
+    //! Statistics about the cache of name data read from the database.
+    NameReadCache::Stats GetNameReadCacheStats() const { return nameReadCache.GetStats(); }
+};
+
+/**
+ * Read-only view of the name data in a snapshot of the coin database.
+ * Later changes to the database are not visible through it, so that
+ * long-running name scans and checks can use it without holding cs_main.
+ */
+class CCoinsViewDBSnapshot final : public CCoinsView
+{
+private:
+    std::shared_ptr<const CDBSnapshot> snapshot;
+public:
+    explicit CCoinsViewDBSnapshot(const CDBWrapper& db);
+
+    uint256 GetBestBlock() const override;
+    bool GetName(const valtype &name, CNameData &data) const override;
+    CNameIterator* IterateNames() const override;
+    CNameIterator* IterateNamesLexicographic() const override;
+    bool ValidateNameDB() const override;
 };
 
 /** Specialization of CCoinsViewCursor to iterate over a CCoinsViewDB */
@@ -38,12 +38,12 @@ CTxMemPoolEntry::CTxMemPoolEntry(const CTransactionRef& _tx, const CAmount& _nFe
 
     for (const auto& txOut : _tx->vout)
     {
-        const CNameScript curNameOp(txOut.scriptPubKey);
+        const CNameScriptView curNameOp(txOut.scriptPubKey);
         if (!curNameOp.isNameOp())
             continue;
 
         assert(!nameOp.isNameOp());
-        nameOp = curNameOp;
+        nameOp = CNameScript(curNameOp);
     }
 }
 
@@ -746,6 +746,20 @@ public:
         return names.lastNameOutput(name);
     }
 
+    const CNameMemPool::PendingOperations&
+    getPendingNameOperations(const valtype& name) const
+    {
+        AssertLockHeld(cs);
+        return names.getPendingOperations(name);
+    }
+
+    std::vector<valtype>
+    getPendingNames() const
+    {
+        AssertLockHeld(cs);
+        return names.getPendingNames();
+    }
+
     /**
      * Check if a tx can be added to it according to name criteria.
      * (The non-name criteria are checked in main.cpp and not here, we
@@ -17,9 +17,11 @@
 #include <cuckoocache.h>
 #include <flatfile.h>
 #include <hash.h>
+#include <headercache.h>
 #include <index/txindex.h>
 #include <names/main.h>
 #include <names/mempool.h>
+#include <names/valuecache.h>
 #include <policy/fees.h>
 #include <policy/policy.h>
 #include <policy/settings.h>
@@ -476,6 +478,7 @@ private:
         CAmount m_modified_fees;
         CAmount m_conflicting_fees;
         size_t m_conflicting_size;
+        std::shared_ptr<const ParsedNameValue> m_name_value;
 
         const CTransactionRef& m_ptx;
         const uint256& m_hash;
@@ -667,8 +670,12 @@ bool MemPoolAccept::PreChecks(ATMPArgs& args, Workspace& ws)
        tx validation done below (in CheckInputs) will not be correct.  */
     for (const auto& txout : tx.vout)
     {
-        const CNameScript nameOp(txout.scriptPubKey);
-        if (nameOp.isNameOp() && nameOp.isAnyUpdate())
+        const CNameScriptView view(txout.scriptPubKey);
+        if (!view.isNameOp())
+            continue;
+
+        const CNameScript nameOp(view);
+        if (nameOp.isAnyUpdate())
         {
             const valtype& name = nameOp.getOpName();
             CNameData data;
@@ -691,7 +698,7 @@ bool MemPoolAccept::PreChecks(ATMPArgs& args, Workspace& ws)
         return state.Invalid(ValidationInvalidReason::TX_PREMATURE_SPEND, false, REJECT_NONSTANDARD, "non-BIP68-final");
 
     CAmount nFees = 0;
-    if (!Consensus::CheckTxInputs(tx, state, m_view, GetSpendHeight(m_view), nFees)) {
+    if (!Consensus::CheckTxInputs(tx, state, m_view, GetSpendHeight(m_view), nFees, &ws.m_name_value)) {
         return error("%s: Consensus::CheckTxInputs: %s, %s", __func__, tx.GetHash().ToString(), FormatStateMessage(state));
     }
 
@@ -1033,6 +1040,11 @@ bool MemPoolAccept::Finalize(ATMPArgs& args, Workspace& ws)
         if (!m_pool.exists(hash))
             return state.Invalid(ValidationInvalidReason::TX_MEMPOOL_POLICY, false, REJECT_INSUFFICIENTFEE, "mempool full");
     }
+
+    /* Now that the transaction is accepted, cache its parsed name value.  */
+    if (ws.m_name_value != nullptr)
+        GetNameValueCache().Insert(hash, std::move(ws.m_name_value));
+
     return true;
 }
 
@@ -1142,10 +1154,61 @@ bool GetTransaction(const uint256& hash, CTransactionRef& txOut, const Consensus
 // CBlock and CBlockIndex
 //
 
+/**
+ * Cache of headers with valid PoW.  Entries are a salted hash of the full
+ * header including its PowData, since the block hash alone does not commit
+ * to the PoW.  Unlike the script-execution cache, it is also used without
+ * cs_main (by the PoW check threads), so it has its own lock.
+ *
+ * Only neoscrypt headers are cached:  For the other algorithms, hashing the
+ * full header (including e.g. the auxpow) for the lookup costs about as much
+ * as the PoW check itself.
+ */
+static CuckooCache::cache<uint256, SignatureCacheHasher> powCache;
+static uint256 powCacheNonce(GetRandHash());
+static boost::shared_mutex cs_powcache;
+/** Whether InitPowCache has been called; e.g. the benchmarks do not.  */
+static bool powCacheReady GUARDED_BY(cs_powcache) = false;
+
+void InitPowCache() {
+    // nMaxCacheSize is unsigned. If -maxpowcachesize is set to zero,
+    // setup_bytes creates the minimum possible cache (2 elements).
+    size_t nMaxCacheSize = std::min(std::max((int64_t)0, gArgs.GetArg("-maxpowcachesize", DEFAULT_MAX_POW_CACHE_SIZE)), MAX_MAX_SIG_CACHE_SIZE) * ((size_t) 1 << 20);
+    boost::unique_lock<boost::shared_mutex> lock(cs_powcache);
+    size_t nElems = powCache.setup_bytes(nMaxCacheSize);
+    powCacheReady = true;
+    LogPrintf("Using %zu MiB out of %zu requested for header PoW cache, able to store %zu elements\n",
+            (nElems*sizeof(uint256)) >>20, nMaxCacheSize>>20, nElems);
+}
+
+static uint256 GetPowCacheEntry(const CBlockHeader& block)
+{
+    CHashWriter hasher(SER_GETHASH, 0);
+    hasher << powCacheNonce << block;
+    return hasher.GetHash();
+}
+
 bool CheckProofOfWork(const CBlockHeader& block, const Consensus::Params& params)
 {
+    if (block.pow.getCoreAlgo() != PowAlgo::NEOSCRYPT) {
+        if (!block.pow.isValid (block.GetHash(), params))
+            return error("%s : proof of work failed", __func__);
+        return true;
+    }
+
+    const uint256 entry = GetPowCacheEntry(block);
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_powcache);
+        if (powCacheReady && powCache.contains(entry, false))
+            return true;
+    }
+
     if (!block.pow.isValid (block.GetHash(), params))
         return error("%s : proof of work failed", __func__);
+
+    boost::unique_lock<boost::shared_mutex> lock(cs_powcache);
+    if (powCacheReady)
+        powCache.insert(entry);
     return true;
 }
 
@@ -1227,7 +1290,12 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus
 
 bool ReadBlockHeaderFromDisk(CBlockHeader& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams)
 {
-    return ReadBlockOrHeader(block, pindex, consensusParams);
+    if (g_header_cache.Lookup(pindex->GetBlockHash(), block))
+        return true;
+    if (!ReadBlockOrHeader(block, pindex, consensusParams))
+        return false;
+    g_header_cache.Insert(block);
+    return true;
 }
 
 bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const FlatFilePos& pos, const CMessageHeader::MessageStartChars& message_start)
@@ -1783,6 +1851,7 @@ DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockI
     for (nameUndoIter = blockUndo.vnameundo.rbegin ();
          nameUndoIter != blockUndo.vnameundo.rend (); ++nameUndoIter)
       nameUndoIter->apply (view);
+    MarkNamesForCheck (blockUndo);
 
     // move best block pointer to prevout block
     view.SetBestBlock(pindex->pprev->GetBlockHash());
@@ -2026,6 +2095,9 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     blockundo.vtxundo.reserve(block.vtx.size() - 1);
     std::vector<PrecomputedTransactionData> txdata;
     txdata.reserve(block.vtx.size()); // Required so that pointers to individual PrecomputedTransactionData don't get invalidated
+    /* Name values parsed while checking the transactions, to be cached
+       only once the block is connected.  */
+    std::vector<std::pair<uint256, std::shared_ptr<const ParsedNameValue>>> nameValues;
     for (unsigned int i = 0; i < block.vtx.size(); i++)
     {
         const CTransaction &tx = *(block.vtx[i]);
@@ -2035,7 +2107,8 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
         if (!tx.IsCoinBase())
         {
             CAmount txfee = 0;
-            if (!Consensus::CheckTxInputs(tx, state, view, pindex->nHeight, txfee)) {
+            std::shared_ptr<const ParsedNameValue> nameValue;
+            if (!Consensus::CheckTxInputs(tx, state, view, pindex->nHeight, txfee, &nameValue)) {
                 if (!IsBlockReason(state.GetReason())) {
                     // CheckTxInputs may return MISSING_INPUTS or
                     // PREMATURE_SPEND but we can't return that, as it's not
@@ -2046,6 +2119,8 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
                 }
                 return error("%s: Consensus::CheckTxInputs: %s, %s", __func__, tx.GetHash().ToString(), FormatStateMessage(state));
             }
+            if (nameValue != nullptr)
+                nameValues.emplace_back(tx.GetHash(), std::move(nameValue));
             nFees += txfee;
             if (!MoneyRange(nFees)) {
                 return state.Invalid(ValidationInvalidReason::CONSENSUS, error("%s: accumulated fee in the block out of range.", __func__),
@@ -2129,6 +2204,9 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     /* Skip this step for the genesis block.  */
     if (!isGenesis && !WriteUndoDataForBlock(blockundo, state, pindex, chainparams))
         return false;
+    MarkNamesForCheck(blockundo);
+    for (auto& entry : nameValues)
+        GetNameValueCache().Insert(entry.first, std::move(entry.second));
 
     if (!pindex->IsValid(BLOCK_VALID_SCRIPTS)) {
         pindex->RaiseValidity(BLOCK_VALID_SCRIPTS);
@@ -3572,8 +3650,10 @@ bool BlockManager::AcceptBlockHeader(const CBlockHeader& block, CValidationState
             }
         }
     }
-    if (pindex == nullptr)
+    if (pindex == nullptr) {
         pindex = AddToBlockIndex(block);
+        g_header_cache.Insert(block);
+    }
 
     if (ppindex)
         *ppindex = pindex;
@@ -3581,10 +3661,67 @@ bool BlockManager::AcceptBlockHeader(const CBlockHeader& block, CValidationState
     return true;
 }
 
+/* Besides hashing several headers at once, this bounds the work an invalid
+   header can cause:  Headers after it are not hashed here, and the serial
+   acceptance stops at it as well.  Only neoscrypt headers are cached; the
+   pre-check stops at any other header and leaves it to the serial check.  */
+size_t PrecheckHeadersPow(const std::vector<CBlockHeader>& headers, const Consensus::Params& params)
+{
+    if (headers.size() < 2)
+        return 0;
+
+    size_t hashed = 0;
+    std::vector<const CBlockHeader*> batch;
+    std::vector<CPureBlockHeader> fakeHeaders;
+    auto it = headers.begin();
+    while (it != headers.end()) {
+        /* Collect the next batch of unknown headers, up to the first one
+           that can be rejected without hashing.  */
+        batch.clear();
+        fakeHeaders.clear();
+        bool stop = false;
+        {
+            LOCK(cs_main);
+            for (; it != headers.end() && batch.size() < POW_PRECHECK_BATCH; ++it) {
+                const uint256 hash = it->GetHash();
+                if (LookupBlockIndex(hash) != nullptr)
+                    continue;
+                const PowData& pow = it->pow;
+                if (pow.getCoreAlgo() != PowAlgo::NEOSCRYPT || pow.isMergeMined()
+                        || pow.getFakeHeader().hashMerkleRoot != hash) {
+                    stop = true;
+                    break;
+                }
+                batch.push_back(&*it);
+                fakeHeaders.push_back(pow.getFakeHeader());
+            }
+        }
+        if (batch.empty())
+            break;
+
+        const std::vector<uint256> powHashes = GetNeoscryptPowHashes(fakeHeaders);
+        hashed += batch.size();
+        for (size_t i = 0; i < batch.size(); ++i) {
+            if (!batch[i]->pow.checkPowHash(powHashes[i], params))
+                return hashed;
+            const uint256 entry = GetPowCacheEntry(*batch[i]);
+            boost::unique_lock<boost::shared_mutex> lock(cs_powcache);
+            if (powCacheReady)
+                powCache.insert(entry);
+        }
+        if (stop)
+            break;
+    }
+
+    return hashed;
+}
+
 // Exposed wrapper for AcceptBlockHeader
+
 bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex, CBlockHeader *first_invalid)
 {
     if (first_invalid != nullptr) first_invalid->SetNull();
+    PrecheckHeadersPow(headers, chainparams.GetConsensus());
     {
         LOCK(cs_main);
         for (const CBlockHeader& header : headers) {
@@ -4101,6 +4238,8 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams) EXCLUSIVE_LOCKS_RE
     // Check whether we have the name history
     pblocktree->ReadFlag("namehistory", fNameHistory);
     LogPrintf("LoadBlockIndexDB(): name history %s\n", fNameHistory ? "enabled" : "disabled");
+    pblocktree->ReadFlag("namescanindex", fNameScanIndex);
+    LogPrintf("LoadBlockIndexDB(): name scan index %s\n", fNameScanIndex ? "enabled" : "disabled");
 
     return true;
 }
@@ -4504,6 +4643,7 @@ void UnloadBlockIndex()
     for (int b = 0; b < VERSIONBITS_NUM_BITS; b++) {
         warningcache[b].clear();
     }
+    ClearNextWorkCache();
     fHavePruned = false;
 
     ::ChainstateActive().UnloadBlockIndex();
@@ -4529,6 +4669,8 @@ bool LoadBlockIndex(const CChainParams& chainparams)
         LogPrintf("Initializing databases...\n");
         fNameHistory = gArgs.GetBoolArg("-namehistory", false);
         pblocktree->WriteFlag("namehistory", fNameHistory);
+        fNameScanIndex = gArgs.GetBoolArg("-namescanindex", DEFAULT_NAMESCANINDEX);
+        pblocktree->WriteFlag("namescanindex", fNameScanIndex);
     }
     return true;
 }
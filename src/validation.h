@@ -80,6 +80,8 @@ static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
 static const int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** -maxpowcachesize default (MiB) for the cache of verified header PoW */
+static const int64_t DEFAULT_MAX_POW_CACHE_SIZE = 4;
 /** Number of blocks that can be requested at any given time from a single peer. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
@@ -373,6 +375,20 @@ public:
 /** Initializes the script-execution cache */
 void InitScriptExecutionCache();
 
+/** Initializes the cache of verified header PoW */
+void InitPowCache();
+
+/** Number of neoscrypt headers hashed at once by PrecheckHeadersPow */
+static const size_t POW_PRECHECK_BATCH = 8;
+
+/**
+ * Verifies the neoscrypt PoW of the given new headers in batches with the
+ * multi-way implementation, and adds the valid ones to the PoW cache before
+ * they are accepted one by one.  Stops (silently) at the first invalid header,
+ * which is reported when it is accepted.  Returns the number of headers hashed.
+ */
+size_t PrecheckHeadersPow(const std::vector<CBlockHeader>& headers, const Consensus::Params& params);
+
 
 /** Functions for disk access for blocks */
 bool ReadBlockFromDisk(CBlock& block, const FlatFilePos& pos, const Consensus::Params& consensusParams);
@@ -411,6 +427,8 @@ std::vector<unsigned char> GenerateCoinbaseCommitment(CBlock& block, const CBloc
 
 /**
  * Check proof-of-work of a block header, taking auxpow into account.
+ * Valid results are kept in a cache, so that headers seen again
+ * (e.g. re-announced or read back from disk) are not checked again.
  * @param block The block header.
  * @param params Consensus parameters.
  * @return True iff the PoW is correct.
@@ -285,7 +285,7 @@ name_list (const JSONRPCRequest& request)
       int nOut = -1;
       for (unsigned i = 0; i < tx.tx->vout.size (); ++i)
         {
-          const CNameScript cur(tx.tx->vout[i].scriptPubKey);
+          const CNameScriptView cur(tx.tx->vout[i].scriptPubKey);
           if (cur.isNameOp ())
             {
               if (nOut != -1)
@@ -293,7 +293,7 @@ name_list (const JSONRPCRequest& request)
                            " name outputs");
               else
                 {
-                  nameOp = cur;
+                  nameOp = CNameScript (cur);
                   nOut = i;
                 }
             }
@@ -21,17 +21,17 @@ bool CZMQAbstractNotifier::NotifyTransaction(const CTransaction &/*transaction*/
     return true;
 }
 
-bool CZMQAbstractNotifier::NotifyBlockAttached(const CBlock& /*block*/)
+bool CZMQAbstractNotifier::NotifyBlockAttached(const std::shared_ptr<const CBlock>& /*block*/)
 {
     return true;
 }
 
-bool CZMQAbstractNotifier::NotifyBlockDetached(const CBlock& /*block*/)
+bool CZMQAbstractNotifier::NotifyBlockDetached(const std::shared_ptr<const CBlock>& /*block*/)
 {
     return true;
 }
 
-bool CZMQAbstractNotifier::NotifyPendingTx(const CTransaction& transaction)
+bool CZMQAbstractNotifier::NotifyPendingTx(const CTransactionRef& /*transaction*/)
 {
     return true;
 }
@@ -8,6 +8,7 @@
 #include <zmq/zmqconfig.h>
 
 #include <functional>
+#include <memory>
 
 class CBlock;
 class CBlockIndex;
@@ -48,13 +49,13 @@ public:
 
     /* Block attach and detach notifications are used for the game
        interface in Xaya.  */
-    virtual bool NotifyBlockAttached(const CBlock& block);
-    virtual bool NotifyBlockDetached(const CBlock& block);
+    virtual bool NotifyBlockAttached(const std::shared_ptr<const CBlock>& block);
+    virtual bool NotifyBlockDetached(const std::shared_ptr<const CBlock>& block);
 
     /* Notification for transactions that are now pending (in the mempool).
        The difference to NotifyTransaction is that the latter is called also
        when transactions are confirmed.  */
-    virtual bool NotifyPendingTx(const CTransaction& transaction);
+    virtual bool NotifyPendingTx(const CTransactionRef& transaction);
 
 protected:
     void *psocket;
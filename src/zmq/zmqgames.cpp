@@ -4,21 +4,19 @@
 
 #include <zmq/zmqgames.h>
 
-#include <amount.h>
 #include <chain.h>
-#include <core_io.h>
-#include <key_io.h>
-#include <logging.h>
-#include <names/common.h>
-#include <names/encoding.h>
+#include <names/valuecache.h>
 #include <primitives/block.h>
 #include <primitives/transaction.h>
 #include <script/names.h>
-#include <script/standard.h>
+#include <util/strencodings.h>
+#include <util/system.h>
+#include <util/time.h>
 #include <validation.h>
 
 #include <univalue.h>
 
+#include <chrono>
 #include <map>
 #include <sstream>
 
@@ -26,6 +24,7 @@ const char* ZMQGameBlocksNotifier::PREFIX_ATTACH = "game-block-attach";
 const char* ZMQGameBlocksNotifier::PREFIX_DETACH = "game-block-detach";
 
 const char* ZMQGamePendingNotifier::PREFIX_MOVE = "game-pending-move";
+const char* ZMQGamePendingNotifier::PREFIX_BATCH = "game-pending-batch";
 
 UniValue
 TrackedGames::Get () const
@@ -53,292 +52,304 @@ TrackedGames::Remove (const std::string& game)
   games.erase (game);
 }
 
-bool
-ZMQGameNotifier::SendMessage (const std::string& command,
-                              const UniValue& data)
-{
-  const std::string dataStr = data.write ();
-  return CZMQAbstractPublishNotifier::SendMessage (
-      command.c_str (), dataStr.c_str (), dataStr.size ());
-}
+/* ************************************************************************** */
 
-namespace
+ZMQGamePublishQueue::ZMQGamePublishQueue (const size_t n, const Policy p,
+                                          const int64_t delay)
+  : maxSize(n), policy(p), delayMillis(delay)
 {
+  assert (maxSize > 0);
+  publisher.reset (new std::thread ([this] ()
+    {
+      TraceThread ("zmqgamepub", [this] () { Run (); });
+    }));
+}
 
-/**
- * Helper class that analyses a single transaction and extracts the data
- * from it that is relevant for the ZMQ game notifications.
- */
-class TransactionData
+ZMQGamePublishQueue::~ZMQGamePublishQueue ()
 {
-
-private:
-
-  /**
-   * Type for the map that holds moves for each game.  Note that a single
-   * transaction may contain multiple moves for a single game, namely if
-   * it has duplicate JSON keys in the "g" object, or multiple "g" entries.
-   * In those cases, we want to always store/send the last of them.
-   */
-  using MovePerGame = std::map<std::string, UniValue>;
-
-  /** Move data for each game.  */
-  MovePerGame moves;
-
-  /** Set to true if this is an admin command.  */
-  bool isAdmin = false;
-  /** Game ID for which this is an admin command.  */
-  std::string adminGame;
-  /**
-   * The array of admin command data (if any).  There can be multiple entries
-   * if the move had duplicate "cmd" fields.
-   */
-  std::vector<UniValue> adminCmds;
-
-public:
-
-  /**
-   * Construct this by analysing a given transaction.
-   */
-  explicit TransactionData (const CTransaction& tx);
-
-  TransactionData () = delete;
-  TransactionData (const TransactionData&) = delete;
-  void operator= (const TransactionData&) = delete;
-
-  const MovePerGame&
-  GetMovesPerGame () const
-  {
-    return moves;
-  }
-
-  bool
-  IsAdminCommand () const
-  {
-    return isAdmin;
-  }
-
-  const std::string&
-  GetAdminGame () const
   {
-    assert (isAdmin);
-    return adminGame;
+    LOCK (cs);
+    stopping = true;
+    cv.notify_all ();
   }
 
-  const std::vector<UniValue>&
-  GetAdminCommands () const
-  {
-    assert (isAdmin);
-    return adminCmds;
-  }
-
-};
+  if (publisher->joinable ())
+    publisher->join ();
+  publisher.reset ();
+}
 
-TransactionData::TransactionData (const CTransaction& tx)
+bool
+ZMQGamePublishQueue::ParsePolicy (const std::string& str, Policy& p)
 {
-  /* Determine if this is a name update at all; if it isn't, then there
-     is nothing to do for this transaction.  */
-  CNameScript nameOp;
-  for (const auto& out : tx.vout)
+  if (str == "block")
     {
-      nameOp = CNameScript (out.scriptPubKey);
-      if (nameOp.isNameOp ())
-        break;
+      p = Policy::BLOCK;
+      return true;
     }
-  if (!nameOp.isNameOp () || !nameOp.isAnyUpdate ())
-    return;
-
-  /* Parse the value JSON.  */
-  const std::string valueStr = EncodeName (nameOp.getOpValue (),
-                                           NameEncoding::UTF8);
-  UniValue value;
-  if (!value.read (valueStr) || !value.isObject ())
+  if (str == "drop")
     {
-      /* This shouldn't actually happen, as the consensus rules check for
-         these conditions for name updates.  But if it does happen, we just
-         ignore it for here.  */
-      LogPrintf ("%s: invalid value ignored\n", __func__);
-      return;
+      p = Policy::DROP;
+      return true;
     }
 
-  /* Special case:  Handle admin commands.  */
-  const std::string name = EncodeName (nameOp.getOpName (), NameEncoding::UTF8);
-  if (name.substr (0, 2) == "g/")
-    {
-      isAdmin = true;
-      adminGame = name.substr (2);
-      assert (adminCmds.empty ());
+  return false;
+}
 
-      for (size_t i = 0; i < value.size (); ++i)
-        if (value.getKeys ()[i] == "cmd")
-          adminCmds.push_back (value.getValues ()[i]);
+ZMQGamePublishQueue::Stats
+ZMQGamePublishQueue::GetStats () const
+{
+  LOCK (cs);
 
-      return;
-    }
-  assert (!isAdmin);
+  Stats res;
+  res.size = queue.size ();
+  res.maxSize = maxSize;
+  res.peak = peak;
+  res.published = published;
+  res.dropped = dropped;
+  res.policy = policy;
 
-  /* Otherwise, we are only interested in p/ names.  */
-  if (name.substr (0, 2) != "p/")
-    return;
+  return res;
+}
 
-  /* See if there are actually games mentioned in the update's value.  */
-  if (!value.exists ("g"))
-    return;
-  const UniValue& g = value["g"];
-  if (!g.isObject () || g.empty ())
-    return;
+void
+ZMQGamePublishQueue::Enqueue (ZMQGameNotifier& notifier, Job&& job,
+                              std::set<std::string>&& dropTopics)
+{
+  WAIT_LOCK (cs, lock);
+
+  if (queue.size () >= maxSize)
+    switch (policy)
+      {
+      case Policy::BLOCK:
+        cv.wait (lock, [this] ()
+          {
+            AssertLockHeld (cs);
+            return queue.size () < maxSize || stopping;
+          });
+        if (stopping)
+          return;
+        break;
 
-  /* Prepare a template object that is the same for all games.  */
-  UniValue tmpl(UniValue::VOBJ);
-  tmpl.pushKV ("txid", tx.GetHash ().GetHex ());
-  tmpl.pushKV ("name", name.substr (2));
+      case Policy::DROP:
+        {
+          LogPrint (BCLog::ZMQ,
+                    "zmq: Game queue full, dropping notification for %s\n",
+                    notifier.GetType ());
+          ++dropped;
+
+          /* Remember the gap until the notifier's next job is queued.  All
+             drops in between are merged into it.  */
+          auto& topics = gaps[&notifier];
+          topics.insert (dropTopics.begin (), dropTopics.end ());
+          return;
+        }
+      }
 
-  UniValue inputs(UniValue::VARR);
-  for (const auto& in : tx.vin)
+  Entry entry{&notifier, std::move (job), false, {}};
+  const auto mit = gaps.find (&notifier);
+  if (mit != gaps.end ())
     {
-      UniValue cur(UniValue::VOBJ);
-      cur.pushKV ("txid", in.prevout.hash.GetHex ());
-      cur.pushKV ("vout", static_cast<int> (in.prevout.n));
-      inputs.push_back (cur);
+      entry.gap = true;
+      entry.gapTopics = std::move (mit->second);
+      gaps.erase (mit);
     }
-  tmpl.pushKV ("inputs", inputs);
 
-  std::map<std::string, CAmount> outAmounts;
-  for (const auto& out : tx.vout)
-    {
-      const CNameScript nameOp(out.scriptPubKey);
-      if (nameOp.isNameOp ())
-        continue;
+  queue.push_back (std::move (entry));
+  peak = std::max (peak, queue.size ());
+  cv.notify_all ();
+}
 
-      CTxDestination dest;
-      if (!ExtractDestination (out.scriptPubKey, dest))
-        continue;
+void
+ZMQGamePublishQueue::Flush ()
+{
+  WAIT_LOCK (cs, lock);
+  cv.wait (lock, [this] ()
+    {
+      AssertLockHeld (cs);
+      return queue.empty () && processing == 0;
+    });
+}
 
-      const std::string addr = EncodeDestination (dest);
-      outAmounts[addr] += out.nValue;
-    }
+void
+ZMQGamePublishQueue::Remove (ZMQGameNotifier& notifier)
+{
+  Flush ();
 
-  UniValue out(UniValue::VOBJ);
-  for (const auto& entry : outAmounts)
-    out.pushKV (entry.first, ValueFromAmount (entry.second));
-  tmpl.pushKV ("out", out);
+  LOCK (cs);
+  gaps.erase (&notifier);
+}
 
-  /* Fill the per-game moves into the template.  */
-  for (size_t i = 0; i < value.size (); ++i)
+void
+ZMQGamePublishQueue::Run ()
+{
+  while (true)
     {
-      if (value.getKeys ()[i] != "g")
-        continue;
-      const auto& g = value.getValues ()[i];
-      if (!g.isObject ())
-        continue;
+      Entry entry;
+      {
+        WAIT_LOCK (cs, lock);
+        if (queue.empty ())
+          {
+            if (stopping)
+              break;
+            cv.wait (lock);
+            continue;
+          }
+
+        entry = std::move (queue.front ());
+        queue.pop_front ();
+        ++processing;
+        cv.notify_all ();
+      }
 
-      for (size_t j = 0; j < g.size (); ++j)
+      if (delayMillis > 0)
+        MilliSleep (delayMillis);
+
+      ZMQGameNotifier& notifier = *entry.notifier;
+      if (entry.gap)
+        notifier.SkipSequenceNumbers (entry.gapTopics);
+      if (!notifier.failed && !entry.job ())
         {
-          UniValue obj = tmpl;
-          obj.pushKV ("move", g.getValues ()[j]);
-
-          const std::string& game = g.getKeys ()[j];
-          auto mit = moves.find (game);
-          if (mit == moves.end ())
-            moves.emplace (game, obj);
-          else
-            mit->second = obj;
+          LogPrint (BCLog::ZMQ, "zmq: Publishing for %s failed\n",
+                    notifier.GetType ());
+          notifier.failed = true;
         }
+
+      LOCK (cs);
+      --processing;
+      ++published;
+      cv.notify_all ();
     }
 }
 
-} // anonymous namespace
+/* ************************************************************************** */
 
 bool
-ZMQGameBlocksNotifier::SendBlockNotifications (
-    const std::set<std::string>& games, const std::string& commandPrefix,
-    const std::string& reqtoken, const CBlock& block)
+ZMQGameNotifier::Enqueue (Job&& job, std::set<std::string>&& dropTopics)
 {
-  /* Start with an empty array of moves and commands for each game.  */
-  std::map<std::string, UniValue> perGameMoves;
-  std::map<std::string, UniValue> perGameAdminCmds;
-  for (const auto& game : games)
-    {
-      perGameMoves[game] = UniValue (UniValue::VARR);
-      perGameAdminCmds[game] = UniValue (UniValue::VARR);
-    }
+  if (failed)
+    return false;
 
-  /* Add relevant moves and admin commands for each game from all the
-     transactions to our arrays.  */
-  for (const auto& tx : block.vtx)
-    {
-      const TransactionData data(*tx);
+  if (publishQueue == nullptr)
+    return job ();
 
-      for (const auto& entry : data.GetMovesPerGame ())
-        {
-          auto mit = perGameMoves.find (entry.first);
-          if (mit == perGameMoves.end ())
-            continue;
+  publishQueue->Enqueue (*this, std::move (job), std::move (dropTopics));
+  return true;
+}
 
-          assert (games.count (entry.first) > 0);
-          assert (mit->second.isArray ());
-          mit->second.push_back (entry.second);
-        }
+void
+ZMQGameNotifier::FlushQueue ()
+{
+  if (publishQueue != nullptr)
+    publishQueue->Flush ();
+}
 
-      if (data.IsAdminCommand ())
-        {
-          const auto& adminGame = data.GetAdminGame ();
-          auto mit = perGameAdminCmds.find (adminGame);
-          if (mit == perGameAdminCmds.end ())
-            continue;
+void
+ZMQGameNotifier::Shutdown ()
+{
+  /* Make sure that all queued notifications are still sent (and no job
+     refers to this notifier anymore) before the socket is closed.  */
+  if (publishQueue != nullptr)
+    publishQueue->Remove (*this);
+  CZMQAbstractPublishNotifier::Shutdown ();
+}
 
-          assert (games.count (adminGame) > 0);
-          assert (mit->second.isArray ());
+bool
+ZMQGameNotifier::SendMessage (const std::string& command,
+                              const UniValue& data)
+{
+  return SendMessage (command, data.write ());
+}
 
-          for (const auto& cmd : data.GetAdminCommands ())
-            {
-              UniValue cmdJson(UniValue::VOBJ);
-              cmdJson.pushKV ("txid", tx->GetHash ().GetHex ());
-              cmdJson.pushKV ("cmd", cmd);
-              mit->second.push_back (cmdJson);
-            }
-        }
+bool
+ZMQGameNotifier::SendMessage (const std::string& command, std::string&& data)
+{
+  return CZMQAbstractPublishNotifier::SendMessage (command.c_str (),
+                                                   std::move (data));
+}
+
+bool
+ZMQGameNotifier::SendMessage (const std::string& command,
+                              std::vector<unsigned char>&& data)
+{
+  return CZMQAbstractPublishNotifier::SendMessage (command.c_str (),
+                                                   std::move (data));
+}
+
+bool
+ZMQGameBlocksNotifier::SendBlockNotifications (
+    const std::set<std::string>& games, const std::string& commandPrefix,
+    const std::string& reqtoken, const BlockGameMoves& block)
+{
+  /* Notifications nobody is subscribed to are not built, but their sequence
+     numbers are advanced nevertheless (like for dropped notifications).  */
+  if (!HasAnySubscriber (games, commandPrefix))
+    {
+      SkipSequenceNumbers (GetTopics (games, commandPrefix));
+      return true;
     }
 
   /* Prepare the template object that is the same for each game.  */
   UniValue blockData(UniValue::VOBJ);
-  const uint256& blkHash = block.GetHash ();
-  blockData.pushKV ("hash", blkHash.GetHex ());
-  if (!block.hashPrevBlock.IsNull ())
-    blockData.pushKV ("parent", block.hashPrevBlock.GetHex ());
-  blockData.pushKV ("timestamp", block.GetBlockTime ());
-  blockData.pushKV ("rngseed", block.GetRngSeed ().GetHex ());
-
+  blockData.pushKV ("hash", block.hash.GetHex ());
+  if (!block.parent.IsNull ())
+    blockData.pushKV ("parent", block.parent.GetHex ());
+  blockData.pushKV ("timestamp", block.timestamp);
+  blockData.pushKV ("rngseed", block.rngseed.GetHex ());
+
+  int height;
+  int64_t mediantime;
   {
     LOCK (cs_main);
-    const CBlockIndex* pindex = LookupBlockIndex (blkHash);
+    const CBlockIndex* pindex = LookupBlockIndex (block.hash);
     assert (pindex != nullptr);
-    blockData.pushKV ("height", pindex->nHeight);
-    blockData.pushKV ("mediantime", pindex->GetMedianTimePast ());
+    height = pindex->nHeight;
+    mediantime = pindex->GetMedianTimePast ();
   }
+  blockData.pushKV ("height", height);
+  blockData.pushKV ("mediantime", mediantime);
 
   UniValue tmpl(UniValue::VOBJ);
   tmpl.pushKV ("block", blockData);
   if (!reqtoken.empty ())
     tmpl.pushKV ("reqtoken", reqtoken);
 
-  /* Send notifications for all games with the moves merged into the
-     template object.  */
+  /* Everything that is shared between games is rendered exactly once:  The
+     template object (without its closing brace, so that the per-game fields
+     can be appended) and the transaction part of moves, which is the same
+     for all games a transaction has moves for.  The per-game messages are
+     then assembled from these fragments.  */
+  std::string jsonHeader = tmpl.write ();
+  assert (!jsonHeader.empty () && jsonHeader.back () == '}');
+  jsonHeader.pop_back ();
+
+  std::vector<unsigned char> binHeader;
+  if (sendBinary)
+    EncodeGameBlockBinaryHeader (block, height, mediantime, reqtoken,
+                                 binHeader);
+
+  std::map<const GameMoveTx*, std::string> txFragments;
   for (const auto& game : games)
     {
-      auto mitMv = perGameMoves.find (game);
-      assert (mitMv != perGameMoves.end ());
-      assert (mitMv->second.isArray ());
-
-      auto mitCmd = perGameAdminCmds.find (game);
-      assert (mitCmd != perGameAdminCmds.end ());
-      assert (mitCmd->second.isArray ());
+      const std::string jsonTopic = commandPrefix + " json " + game;
+      if (!HasSubscriber (jsonTopic))
+        SkipSequenceNumbers ({jsonTopic});
+      else if (!SendMessage (jsonTopic,
+                             AssembleGameBlockJson (jsonHeader, block, game,
+                                                    txFragments)))
+        return false;
 
-      UniValue data = tmpl;
-      data.pushKV ("moves", mitMv->second);
-      data.pushKV ("admin", mitCmd->second);
+      if (!sendBinary)
+        continue;
 
-      if (!SendMessage (commandPrefix + " json " + game, data))
+      const std::string binTopic = commandPrefix + " bin " + game;
+      if (!HasSubscriber (binTopic))
+        {
+          SkipSequenceNumbers ({binTopic});
+          continue;
+        }
+      std::vector<unsigned char> bin = binHeader;
+      EncodeGameBlockBinaryGameData (block, game, bin);
+      if (!SendMessage (binTopic, std::move (bin)))
         return false;
     }
 
@@ -346,36 +357,357 @@ ZMQGameBlocksNotifier::SendBlockNotifications (
 }
 
 bool
-ZMQGameBlocksNotifier::NotifyBlockAttached (const CBlock& block)
+ZMQGameBlocksNotifier::ParseGameEndpoint (const std::string& str,
+                                          std::string& game,
+                                          std::string& address)
+{
+  const size_t sep = str.find ('=');
+  if (sep == std::string::npos || sep == 0 || sep + 1 == str.size ())
+    return false;
+
+  game = str.substr (0, sep);
+  address = str.substr (sep + 1);
+  return true;
+}
+
+bool
+ZMQGameBlocksNotifier::HandlesGame (const std::string& game) const
 {
-  LOCK (trackedGames.cs);
-  return SendBlockNotifications (trackedGames.games, PREFIX_ATTACH, "", block);
+  if (!onlyGames.empty ())
+    return onlyGames.count (game) > 0;
+  return excludedGames.count (game) == 0;
 }
 
 bool
-ZMQGameBlocksNotifier::NotifyBlockDetached (const CBlock& block)
+ZMQGameBlocksNotifier::HasAnySubscriber (const std::set<std::string>& games,
+                                         const std::string& commandPrefix)
+{
+  for (const auto& game : games)
+    {
+      if (HasSubscriber (commandPrefix + " json " + game))
+        return true;
+      if (sendBinary && HasSubscriber (commandPrefix + " bin " + game))
+        return true;
+    }
+
+  return false;
+}
+
+std::set<std::string>
+ZMQGameBlocksNotifier::GetTopics (const std::set<std::string>& games,
+                                  const std::string& commandPrefix) const
 {
-  LOCK (trackedGames.cs);
-  return SendBlockNotifications (trackedGames.games, PREFIX_DETACH, "", block);
+  std::set<std::string> topics;
+  for (const auto& game : games)
+    {
+      topics.insert (commandPrefix + " json " + game);
+      if (sendBinary)
+        topics.insert (commandPrefix + " bin " + game);
+    }
+
+  return topics;
 }
 
 bool
-ZMQGamePendingNotifier::NotifyPendingTx (const CTransaction& tx)
+ZMQGameBlocksNotifier::EnqueueBlockNotifications (
+    const std::shared_ptr<const CBlock>& block, const char* commandPrefix)
 {
-  const TransactionData data(tx);
+  std::set<std::string> games;
+  {
+    LOCK (trackedGames.cs);
+    for (const auto& g : trackedGames.games)
+      if (HandlesGame (g))
+        games.insert (g);
+  }
+  if (games.empty ())
+    return true;
 
-  LOCK (trackedGames.cs);
-  for (const auto& entry : data.GetMovesPerGame ())
+  /* Parsing the block (if it is not cached yet) and building the
+     notifications is done on the publisher thread.  */
+  return Enqueue ([this, block, commandPrefix, games] ()
     {
-      if (trackedGames.games.count (entry.first) == 0)
-        continue;
+      /* If nobody is subscribed, we do not even need to parse the block.  */
+      if (!HasAnySubscriber (games, commandPrefix))
+        {
+          SkipSequenceNumbers (GetTopics (games, commandPrefix));
+          return true;
+        }
+
+      const auto data = movesCache->Get (*block);
+      return SendBlockNotifications (games, commandPrefix, "", *data);
+    }, GetTopics (games, commandPrefix));
+}
 
-      std::ostringstream cmd;
-      cmd << PREFIX_MOVE << " json " << entry.first;
+bool
+ZMQGameBlocksNotifier::EnqueueBlockNotifications (
+    const std::set<std::string>& games, const std::string& commandPrefix,
+    const std::string& reqtoken, std::shared_ptr<const BlockGameMoves> block)
+{
+  return Enqueue ([this, games, commandPrefix, reqtoken, block] ()
+    {
+      return SendBlockNotifications (games, commandPrefix, reqtoken, *block);
+    }, GetTopics (games, commandPrefix));
+}
 
-      if (!SendMessage (cmd.str (), entry.second))
-        return false;
+bool
+ZMQGameBlocksNotifier::NotifyBlockAttached (
+    const std::shared_ptr<const CBlock>& block)
+{
+  return EnqueueBlockNotifications (block, PREFIX_ATTACH);
+}
+
+bool
+ZMQGameBlocksNotifier::NotifyBlockDetached (
+    const std::shared_ptr<const CBlock>& block)
+{
+  return EnqueueBlockNotifications (block, PREFIX_DETACH);
+}
+
+bool
+ZMQGamePendingNotifier::ParseBatchOptions (const std::string& str,
+                                           int64_t& millis, size_t& maxMoves)
+{
+  const size_t comma = str.find (',');
+  if (comma == std::string::npos)
+    return false;
+
+  int64_t ms, num;
+  if (!ParseInt64 (str.substr (0, comma), &ms)
+        || !ParseInt64 (str.substr (comma + 1), &num))
+    return false;
+  if (ms <= 0 || num <= 0)
+    return false;
+
+  millis = ms;
+  maxMoves = num;
+  return true;
+}
+
+void
+ZMQGamePendingNotifier::SetBatchOptions (const int64_t millis,
+                                         const size_t maxMoves)
+{
+  assert (flusher == nullptr);
+  batchMillis = millis;
+  batchMax = maxMoves;
+}
+
+bool
+ZMQGamePendingNotifier::Initialize (void* pcontext)
+{
+  if (!ZMQGameNotifier::Initialize (pcontext))
+    return false;
+
+  if (batchMax > 0)
+    {
+      assert (flusher == nullptr);
+      flusher.reset (new std::thread ([this] ()
+        {
+          TraceThread ("zmqbatch", [this] () { RunFlusher (); });
+        }));
     }
 
   return true;
 }
+
+void
+ZMQGamePendingNotifier::Shutdown ()
+{
+  /* First process all queued transactions, then send out what is left
+     in the batches before the socket gets closed.  */
+  FlushQueue ();
+
+  if (flusher != nullptr)
+    {
+      {
+        LOCK (csBatches);
+        stopFlushing = true;
+        cvBatches.notify_all ();
+      }
+      if (flusher->joinable ())
+        flusher->join ();
+      flusher.reset ();
+    }
+
+  std::vector<std::pair<std::string, uint64_t>> left;
+  {
+    LOCK (csBatches);
+    for (const auto& entry : batches)
+      left.emplace_back (entry.first, entry.second.first);
+  }
+  for (const auto& entry : left)
+    SendBatch (entry.first, entry.second);
+
+  ZMQGameNotifier::Shutdown ();
+}
+
+bool
+ZMQGamePendingNotifier::SendBatch (const std::string& game,
+                                   const uint64_t first)
+{
+  LOCK (csSendBatch);
+
+  Batch batch;
+  {
+    LOCK (csBatches);
+    auto mit = batches.find (game);
+    if (mit == batches.end () || mit->second.first != first)
+      return true;
+    batch = std::move (mit->second);
+    batches.erase (mit);
+  }
+
+  std::ostringstream cmd;
+  cmd << PREFIX_BATCH << " json " << game;
+  if (!HasSubscriber (cmd.str ()))
+    {
+      SkipSequenceNumbers ({cmd.str ()});
+      return true;
+    }
+
+  UniValue seq(UniValue::VOBJ);
+  seq.pushKV ("first", batch.first);
+  seq.pushKV ("last", batch.last);
+
+  UniValue data(UniValue::VOBJ);
+  data.pushKV ("seq", seq);
+  data.pushKV ("moves", std::move (batch.moves));
+
+  return SendMessage (cmd.str (), data);
+}
+
+void
+ZMQGamePendingNotifier::RunFlusher ()
+{
+  while (true)
+    {
+      /* Find all batches that are due and the time when the next one
+         will be.  The due batches are sent after releasing the lock.  */
+      std::vector<std::pair<std::string, uint64_t>> due;
+      {
+        WAIT_LOCK (csBatches, lock);
+        if (stopFlushing)
+          break;
+
+        const int64_t now = GetTimeMillis ();
+        int64_t next = now + batchMillis;
+        for (const auto& entry : batches)
+          {
+            const int64_t dueTime = entry.second.started + batchMillis;
+            if (dueTime <= now)
+              due.emplace_back (entry.first, entry.second.first);
+            else
+              next = std::min (next, dueTime);
+          }
+
+        if (due.empty ())
+          {
+            cvBatches.wait_for (lock, std::chrono::milliseconds (next - now));
+            continue;
+          }
+      }
+
+      for (const auto& entry : due)
+        SendBatch (entry.first, entry.second);
+    }
+}
+
+bool
+ZMQGamePendingNotifier::NotifyPendingTx (const CTransactionRef& tx)
+{
+  std::set<std::string> games;
+  {
+    LOCK (trackedGames.cs);
+    games = trackedGames.games;
+  }
+
+  /* The sequence number is assigned here, so that it reflects the order
+     in which transactions were accepted to the mempool.  */
+  uint64_t sequence;
+  {
+    LOCK (csBatches);
+    sequence = nextSequence++;
+  }
+
+  /* Take the name value parsed during validation from the cache now, so
+     that the queued job does not have to parse it again even if it has
+     been evicted from the cache by the time the job runs.  */
+  std::shared_ptr<const ParsedNameValue> parsed;
+  for (const auto& out : tx->vout)
+    if (CNameScript::isNameScript (out.scriptPubKey))
+      {
+        parsed = GetNameValueCache ().Lookup (tx->GetHash ());
+        break;
+      }
+
+  /* We do not know which games the transaction has moves for before
+     parsing it, so a dropped transaction leaves a gap for all of them.  */
+  const char* prefix = (batchMax > 0 ? PREFIX_BATCH : PREFIX_MOVE);
+  std::set<std::string> topics;
+  for (const auto& game : games)
+    topics.insert (std::string (prefix) + " json " + game);
+
+  return Enqueue ([this, tx, parsed, games, sequence] ()
+    {
+      GameMoveIndex data;
+      data.AddTransaction (*tx, parsed);
+
+      for (const auto& entry : data.GetAllMoves ())
+        {
+          if (games.count (entry.first) == 0)
+            continue;
+
+          /* A single transaction has at most one move per game.  */
+          assert (entry.second.size () == 1);
+
+          /* Moves are collected into batches even if nobody is subscribed
+             at the moment, since we cannot know which batches would be
+             sent.  Whether a batch is published is checked when it is
+             complete.  */
+          if (batchMax > 0)
+            {
+              UniValue mv = entry.second.front ().ToJson ();
+              mv.pushKV ("seq", sequence);
+
+              bool full;
+              uint64_t first;
+              {
+                LOCK (csBatches);
+                auto mit = batches.find (entry.first);
+                if (mit == batches.end ())
+                  {
+                    Batch b;
+                    b.moves = UniValue (UniValue::VARR);
+                    b.first = sequence;
+                    b.started = GetTimeMillis ();
+                    mit = batches.emplace (entry.first, std::move (b)).first;
+                    cvBatches.notify_all ();
+                  }
+                mit->second.moves.push_back (mv);
+                mit->second.last = sequence;
+
+                full = (mit->second.moves.size () >= batchMax);
+                first = mit->second.first;
+              }
+
+              if (full && !SendBatch (entry.first, first))
+                return false;
+
+              continue;
+            }
+
+          std::ostringstream cmd;
+          cmd << PREFIX_MOVE << " json " << entry.first;
+          if (!HasSubscriber (cmd.str ()))
+            {
+              SkipSequenceNumbers ({cmd.str ()});
+              continue;
+            }
+
+          if (!SendMessage (cmd.str (), entry.second.front ().ToJson ()))
+            return false;
+        }
+
+      return true;
+    }, std::move (topics));
+}
@@ -5,17 +5,51 @@
 #ifndef BITCOIN_ZMQ_ZMQGAMES_H
 #define BITCOIN_ZMQ_ZMQGAMES_H
 
+#include <names/gamemoves.h>
+#include <primitives/transaction.h>
 #include <sync.h>
 #include <zmq/zmqpublishnotifier.h>
 
+#include <univalue.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
 #include <set>
 #include <string>
+#include <thread>
 #include <vector>
 
 class CBlock;
 class CBlockIndex;
 class CTransaction;
-class UniValue;
+
+/**
+ * Default for -zmqgameblocksbinary, i.e. whether game block notifications
+ * are also published in the binary encoding.
+ */
+static constexpr bool DEFAULT_ZMQ_GAME_BLOCKS_BINARY = false;
+
+/**
+ * Default for -zmqgametracksubscriptions, i.e. whether the game notifiers
+ * use XPUB sockets and only build notifications for topics that some
+ * connected subscriber is subscribed to.
+ */
+static constexpr bool DEFAULT_ZMQ_GAME_TRACK_SUBSCRIPTIONS = false;
+
+/**
+ * Default for -zmqgamequeue, the maximum number of pending notifications
+ * (blocks or transactions) queued for publishing by the game notifiers.
+ * Zero means that notifications are published synchronously from the
+ * validation callbacks.
+ */
+static constexpr int DEFAULT_ZMQ_GAME_QUEUE = 0;
+
+/** Default for -zmqgamequeuepolicy.  */
+static constexpr const char* DEFAULT_ZMQ_GAME_QUEUE_POLICY = "block";
 
 /**
  * Helper class to manage the list of tracked game IDs.
@@ -51,23 +85,203 @@ public:
 
 };
 
+class ZMQGameNotifier;
+
+/**
+ * Queue of jobs for publishing game notifications asynchronously on
+ * a dedicated thread, so that the validation callbacks are not delayed by
+ * the JSON work.  It is shared between all game notifiers, so that the
+ * relative order of e.g. block detaches and pending moves re-added to
+ * the mempool is preserved.  The queue is bounded and processed strictly
+ * in order.
+ */
+class ZMQGamePublishQueue
+{
+
+public:
+
+  /**
+   * What happens when a job is enqueued while the queue is full.
+   */
+  enum class Policy
+  {
+    /** Wait until there is space in the queue.  */
+    BLOCK,
+    /** Drop the job and leave a gap in the sequence numbers.  */
+    DROP,
+  };
+
+  /**
+   * Statistics about the queue.
+   */
+  struct Stats
+  {
+    size_t size;
+    size_t maxSize;
+    size_t peak;
+    uint64_t published;
+    uint64_t dropped;
+    Policy policy;
+  };
+
+  /**
+   * A job in the queue.  It builds and sends the actual notifications
+   * and returns false if sending failed.
+   */
+  using Job = std::function<bool ()>;
+
+private:
+
+  /**
+   * An entry in the queue.  If gap is set, jobs of the notifier have been
+   * dropped before this one, and the sequence numbers of the given topics
+   * (those the dropped jobs would have sent to) are skipped before the
+   * job is run.
+   */
+  struct Entry
+  {
+    ZMQGameNotifier* notifier;
+    Job job;
+    bool gap;
+    std::set<std::string> gapTopics;
+  };
+
+  const size_t maxSize;
+  const Policy policy;
+
+  /**
+   * Time in milliseconds the publisher waits before running each job.  This
+   * is set with -zmqgamequeuedelay and only used in tests, so that the queue
+   * fills up deterministically.
+   */
+  const int64_t delayMillis;
+
+  mutable Mutex cs;
+  std::condition_variable cv;
+
+  std::deque<Entry> queue GUARDED_BY (cs);
+
+  /**
+   * For each notifier that had jobs dropped since its last queued job, the
+   * topics of the dropped jobs.  The gap is recorded with the notifier's
+   * next queued job, so that there is at most one pending gap per notifier
+   * and the queue stays bounded.
+   */
+  std::map<ZMQGameNotifier*, std::set<std::string>> gaps GUARDED_BY (cs);
+
+  /** Number of entries taken from the queue but not yet finished.  */
+  size_t processing GUARDED_BY (cs) = 0;
+
+  /** Set when the publisher thread should finish.  */
+  bool stopping GUARDED_BY (cs) = false;
+
+  size_t peak GUARDED_BY (cs) = 0;
+  uint64_t published GUARDED_BY (cs) = 0;
+  uint64_t dropped GUARDED_BY (cs) = 0;
+
+  std::unique_ptr<std::thread> publisher;
+
+  /** Main function of the publisher thread.  */
+  void Run ();
+
+public:
+
+  /**
+   * Constructs the queue and starts the publisher thread.
+   */
+  explicit ZMQGamePublishQueue (size_t n, Policy p, int64_t delay = 0);
+
+  /**
+   * Processes all remaining jobs and stops the publisher thread.
+   */
+  ~ZMQGamePublishQueue ();
+
+  ZMQGamePublishQueue (const ZMQGamePublishQueue&) = delete;
+  void operator= (const ZMQGamePublishQueue&) = delete;
+
+  /**
+   * Parses a queue policy from its string form.  Returns false if the
+   * string is invalid.
+   */
+  static bool ParsePolicy (const std::string& str, Policy& p);
+
+  /**
+   * Adds a job for the given notifier.  dropTopics are the command strings
+   * the job will send to; they are used to record a sequence gap if
+   * the job is dropped.  If the queue is stopped while waiting for space,
+   * the job is discarded.
+   */
+  void Enqueue (ZMQGameNotifier& notifier, Job&& job,
+                std::set<std::string>&& dropTopics);
+
+  /**
+   * Waits until all jobs enqueued so far have been processed.
+   */
+  void Flush ();
+
+  /**
+   * Waits until all queued jobs have been processed (so that none refers
+   * to the given notifier anymore) and forgets about any pending gap for
+   * the notifier.  Called when the notifier is shut down.
+   */
+  void Remove (ZMQGameNotifier& notifier);
+
+  Stats GetStats () const;
+
+};
+
 /**
  * Superclass for game ZMQ notifiers.  It references a list of tracked
  * games and provides general utility methods common for all game notifiers.
+ * If a publishing queue is set, notifications are built and published
+ * asynchronously through it.
  */
 class ZMQGameNotifier : public CZMQAbstractPublishNotifier
 {
 
+private:
+
+  /** The publishing queue, if notifications are sent asynchronously.  */
+  ZMQGamePublishQueue* publishQueue = nullptr;
+
+  /** Set when a queued job failed to send its notifications.  */
+  std::atomic<bool> failed{false};
+
+  friend class ZMQGamePublishQueue;
+
 protected:
 
+  using Job = ZMQGamePublishQueue::Job;
+
   /** Reference to the list of tracked games.  */
   const TrackedGames& trackedGames;
 
+  /**
+   * Runs the job through the publishing queue (or directly if there is
+   * none).  dropTopics are the command strings the job will send to; they
+   * are used to record a sequence gap if the job is dropped.  Returns false
+   * if the notifier has failed, in which case it should be shut down.
+   */
+  bool Enqueue (Job&& job, std::set<std::string>&& dropTopics);
+
+  /**
+   * Waits until all queued jobs have been processed.
+   */
+  void FlushQueue ();
+
   /**
    * Sends a multipart message where the payload data is JSON.
    */
   bool SendMessage (const std::string& command, const UniValue& data);
 
+  /**
+   * Sends a multipart message with already serialised payload data.  The
+   * buffer is handed over to ZMQ without copying it.
+   */
+  bool SendMessage (const std::string& command, std::string&& data);
+  bool SendMessage (const std::string& command,
+                    std::vector<unsigned char>&& data);
+
 public:
 
   ZMQGameNotifier () = delete;
@@ -78,6 +292,24 @@ public:
     : trackedGames(tg)
   {}
 
+  /**
+   * Sets the publishing queue to use.  Must be called before Initialize.
+   * The queue must outlive the notifier.
+   */
+  void
+  SetPublishQueue (ZMQGamePublishQueue* q)
+  {
+    publishQueue = q;
+  }
+
+  const ZMQGamePublishQueue*
+  GetPublishQueue () const
+  {
+    return publishQueue;
+  }
+
+  void Shutdown () override;
+
 };
 
 /**
@@ -87,24 +319,140 @@ public:
 class ZMQGameBlocksNotifier : public ZMQGameNotifier
 {
 
+private:
+
+  /**
+   * Cache of the parsed game moves for recent blocks.  This allows us to
+   * reuse the move index e.g. between an attach and a later detach, or
+   * for game_sendupdates requests.  It is shared between all game blocks
+   * notifiers, so that blocks are only parsed once even if games are
+   * published on multiple endpoints.
+   */
+  const std::shared_ptr<BlockGameMovesCache> movesCache;
+
+  /**
+   * If not empty, the notifier only publishes for these games (which have
+   * a dedicated endpoint).  Otherwise it publishes for all tracked games
+   * except those in excludedGames.
+   */
+  std::set<std::string> onlyGames;
+
+  /** Games that are published by another notifier on their own endpoint.  */
+  std::set<std::string> excludedGames;
+
+  /**
+   * Whether to publish the binary encoding of notifications in addition
+   * to the JSON one.
+   */
+  bool sendBinary = DEFAULT_ZMQ_GAME_BLOCKS_BINARY;
+
+  /**
+   * Returns true if any of the notifications for the given games and command
+   * prefix has a subscriber.
+   */
+  bool HasAnySubscriber (const std::set<std::string>& games,
+                         const std::string& commandPrefix);
+
+  /**
+   * Returns the command strings of the notifications for the given games
+   * and command prefix.
+   */
+  std::set<std::string> GetTopics (const std::set<std::string>& games,
+                                   const std::string& commandPrefix) const;
+
+  /**
+   * Queues the notifications for the given block with the given command
+   * prefix for all currently tracked games handled by this notifier.
+   */
+  bool EnqueueBlockNotifications (const std::shared_ptr<const CBlock>& block,
+                                  const char* commandPrefix);
+
 public:
 
   static const char* PREFIX_ATTACH;
   static const char* PREFIX_DETACH;
 
-  using ZMQGameNotifier::ZMQGameNotifier;
+  explicit ZMQGameBlocksNotifier (const TrackedGames& tg,
+                                  std::shared_ptr<BlockGameMovesCache> c)
+    : ZMQGameNotifier(tg), movesCache(std::move (c))
+  {}
+
+  /**
+   * Parses an argument of -zmqpubgameblocksfor, which has the form
+   * "<game>=<address>".  Returns false if it is invalid.
+   */
+  static bool ParseGameEndpoint (const std::string& str,
+                                 std::string& game, std::string& address);
+
+  BlockGameMovesCache&
+  GetMovesCache ()
+  {
+    return *movesCache;
+  }
+
+  /**
+   * Restricts the notifier to the given games.  Must be called before
+   * Initialize.
+   */
+  void
+  SetOnlyGames (const std::set<std::string>& games)
+  {
+    onlyGames = games;
+  }
+
+  const std::set<std::string>&
+  GetOnlyGames () const
+  {
+    return onlyGames;
+  }
+
+  /**
+   * Excludes the given games from the notifier.  Must be called before
+   * Initialize.
+   */
+  void
+  SetExcludedGames (const std::set<std::string>& games)
+  {
+    excludedGames = games;
+  }
+
+  /**
+   * Returns true if notifications for the given game are published by
+   * this notifier.
+   */
+  bool HandlesGame (const std::string& game) const;
+
+  void
+  SetSendBinary (const bool val)
+  {
+    sendBinary = val;
+  }
 
   /**
    * Sends the block attach or detach notifications.  They are essentially the
-   * same, except that they have a different command string.
+   * same, except that they have a different command string.  Notifications
+   * are only built and sent for topics that have a subscriber.
    */
   bool SendBlockNotifications (const std::set<std::string>& games,
                                const std::string& commandPrefix,
                                const std::string& reqtoken,
-                               const CBlock& block);
+                               const BlockGameMoves& block);
 
-  bool NotifyBlockAttached (const CBlock& block) override;
-  bool NotifyBlockDetached (const CBlock& block) override;
+  /**
+   * Sends block notifications like SendBlockNotifications, but through
+   * the publishing queue (if any).  This is used for game_sendupdates, so
+   * that its notifications are ordered with respect to those triggered by
+   * validation.  Returns false if the notifier has failed.
+   */
+  bool EnqueueBlockNotifications (const std::set<std::string>& games,
+                                  const std::string& commandPrefix,
+                                  const std::string& reqtoken,
+                                  std::shared_ptr<const BlockGameMoves> block);
+
+  bool NotifyBlockAttached (
+      const std::shared_ptr<const CBlock>& block) override;
+  bool NotifyBlockDetached (
+      const std::shared_ptr<const CBlock>& block) override;
 
 };
 
@@ -117,12 +465,91 @@ class ZMQGamePendingNotifier : public ZMQGameNotifier
 private:
 
   static const char* PREFIX_MOVE;
+  static const char* PREFIX_BATCH;
+
+  /**
+   * Pending moves for one game that have not yet been sent as batch.
+   */
+  struct Batch
+  {
+
+    /** The moves, with their sequence numbers already added.  */
+    UniValue moves;
+
+    /** Sequence number of the first transaction in the batch.  */
+    uint64_t first;
+
+    /** Sequence number of the last transaction in the batch.  */
+    uint64_t last;
+
+    /** Time (in milliseconds) when the first move was added.  */
+    int64_t started;
+
+  };
+
+  /**
+   * Sequence number assigned to the next pending transaction.  This counts
+   * all transactions accepted to the mempool (not only game moves), in the
+   * order of acceptance.
+   */
+  uint64_t nextSequence GUARDED_BY (csBatches) = 0;
+
+  /** Maximum age of a batch in milliseconds before it is sent.  */
+  int64_t batchMillis = 0;
+
+  /** Maximum number of moves in a batch (0 disables batching).  */
+  size_t batchMax = 0;
+
+  mutable Mutex csBatches;
+  std::condition_variable cvBatches;
+
+  /**
+   * Lock held while a batch is taken out and published.  The batch itself
+   * is sent without holding csBatches, so that adding moves is not blocked
+   * by the socket.  This lock keeps batches for the same game in order.
+   * It is always acquired before csBatches.
+   */
+  Mutex csSendBatch;
+
+  /** Current batches per game.  */
+  std::map<std::string, Batch> batches GUARDED_BY (csBatches);
+
+  /** Set when the flushing thread should stop.  */
+  bool stopFlushing GUARDED_BY (csBatches) = false;
+
+  std::unique_ptr<std::thread> flusher;
+
+  /**
+   * Sends the batch for the given game and removes it.  Nothing is done
+   * if the current batch for the game does not start with the given
+   * sequence number, i.e. if it has been sent already in the meantime.
+   */
+  bool SendBatch (const std::string& game, uint64_t first)
+      LOCKS_EXCLUDED (csBatches);
+
+  /** Main function of the thread sending batches that are due.  */
+  void RunFlusher ();
 
 public:
 
   using ZMQGameNotifier::ZMQGameNotifier;
 
-  bool NotifyPendingTx (const CTransaction& tx) override;
+  /**
+   * Parses the argument of -zmqpubgamependingbatch, which has the form
+   * "<ms>,<max>".  Returns false if it is invalid.
+   */
+  static bool ParseBatchOptions (const std::string& str,
+                                 int64_t& millis, size_t& maxMoves);
+
+  /**
+   * Enables batching of pending moves.  Must be called before Initialize.
+   */
+  void SetBatchOptions (int64_t millis, size_t maxMoves);
+
+  bool Initialize (void* pcontext) override;
+  void Shutdown () override;
+
+  bool NotifyPendingTx (const CTransactionRef& tx) override;
 
 };
 
@@ -9,6 +9,8 @@
 #include <validation.h>
 #include <util/system.h>
 
+#include <algorithm>
+
 void zmqError(const char *str)
 {
     LogPrint(BCLog::ZMQ, "zmq: Error: %s, errno=%s\n", str, zmq_strerror(errno));
@@ -51,15 +53,76 @@ CZMQNotificationInterface* CZMQNotificationInterface::Create()
     const std::vector<std::string> vTrackedGames = gArgs.GetArgs("-trackgame");
     std::unique_ptr<TrackedGames> trackedGames(new TrackedGames(vTrackedGames));
 
-    ZMQGameBlocksNotifier* gameBlocksNotifier = nullptr;
-    factories["pubgameblocks"] = [&trackedGames, &gameBlocksNotifier]() {
-        assert (gameBlocksNotifier == nullptr);
-        gameBlocksNotifier = new ZMQGameBlocksNotifier(*trackedGames);
-        return gameBlocksNotifier;
+    // All game notifiers share a single publishing queue (if enabled), so
+    // that the order between their notifications is preserved.
+    std::unique_ptr<ZMQGamePublishQueue> gamePublishQueue;
+    const auto getGamePublishQueue = [&gamePublishQueue]() {
+        const int64_t size = gArgs.GetArg("-zmqgamequeue", DEFAULT_ZMQ_GAME_QUEUE);
+        if (size <= 0) {
+            return static_cast<ZMQGamePublishQueue*>(nullptr);
+        }
+        if (gamePublishQueue == nullptr) {
+            ZMQGamePublishQueue::Policy policy;
+            if (!ZMQGamePublishQueue::ParsePolicy(gArgs.GetArg("-zmqgamequeuepolicy", DEFAULT_ZMQ_GAME_QUEUE_POLICY), policy)) {
+                // This has been checked already during init.
+                assert(false);
+            }
+            const int64_t delay = gArgs.GetArg("-zmqgamequeuedelay", 0);
+            gamePublishQueue = MakeUnique<ZMQGamePublishQueue>(size, policy, delay);
+        }
+        return gamePublishQueue.get();
     };
 
-    factories["pubgamepending"] = [&trackedGames]() {
-        return new ZMQGamePendingNotifier(*trackedGames);
+    // Games with their own endpoint (-zmqpubgameblocksfor), grouped by
+    // the address.  These games are excluded from -zmqpubgameblocks.
+    // Endpoints are only set up for games tracked with -trackgame.
+    std::map<std::string, std::set<std::string>> gamesByEndpoint;
+    std::set<std::string> gamesWithEndpoint;
+    for (const auto& arg : gArgs.GetArgs("-zmqpubgameblocksfor")) {
+        std::string game, address;
+        if (!ZMQGameBlocksNotifier::ParseGameEndpoint(arg, game, address)) {
+            // This has been checked already during init.
+            assert(false);
+        }
+        if (std::find(vTrackedGames.begin(), vTrackedGames.end(), game) == vTrackedGames.end()) {
+            LogPrintf("Ignoring -zmqpubgameblocksfor for untracked game %s\n", game);
+            continue;
+        }
+        gamesByEndpoint[address].insert(game);
+        gamesWithEndpoint.insert(game);
+    }
+
+    const bool trackSubscriptions = gArgs.GetBoolArg("-zmqgametracksubscriptions", DEFAULT_ZMQ_GAME_TRACK_SUBSCRIPTIONS);
+
+    std::vector<ZMQGameBlocksNotifier*> gameBlocksNotifiers;
+    const auto gameMovesCache = std::make_shared<BlockGameMovesCache>();
+    const auto newGameBlocksNotifier = [&]() {
+        auto* notifier = new ZMQGameBlocksNotifier(*trackedGames, gameMovesCache);
+        notifier->SetSendBinary(gArgs.GetBoolArg("-zmqgameblocksbinary", DEFAULT_ZMQ_GAME_BLOCKS_BINARY));
+        notifier->SetPublishQueue(getGamePublishQueue());
+        notifier->SetTrackSubscriptions(trackSubscriptions);
+        gameBlocksNotifiers.push_back(notifier);
+        return notifier;
+    };
+
+    factories["pubgameblocks"] = [&]() {
+        auto* notifier = newGameBlocksNotifier();
+        notifier->SetExcludedGames(gamesWithEndpoint);
+        return notifier;
+    };
+
+    factories["pubgamepending"] = [&]() {
+        auto* notifier = new ZMQGamePendingNotifier(*trackedGames);
+        notifier->SetPublishQueue(getGamePublishQueue());
+        notifier->SetTrackSubscriptions(trackSubscriptions);
+
+        int64_t batchMillis;
+        size_t batchMax;
+        const std::string strBatch = gArgs.GetArg("-zmqpubgamependingbatch", "");
+        if (!strBatch.empty() && ZMQGamePendingNotifier::ParseBatchOptions(strBatch, batchMillis, batchMax)) {
+            notifier->SetBatchOptions(batchMillis, batchMax);
+        }
+        return notifier;
     };
 
     for (const auto& entry : factories)
@@ -77,12 +140,23 @@ CZMQNotificationInterface* CZMQNotificationInterface::Create()
         }
     }
 
+    for (const auto& entry : gamesByEndpoint)
+    {
+        auto* notifier = newGameBlocksNotifier();
+        notifier->SetOnlyGames(entry.second);
+        notifier->SetType("pubgameblocks");
+        notifier->SetAddress(entry.first);
+        notifier->SetOutboundMessageHighWaterMark(static_cast<int>(gArgs.GetArg("-zmqpubgameblockshwm", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM)));
+        notifiers.push_back(notifier);
+    }
+
     if (!notifiers.empty())
     {
         notificationInterface = new CZMQNotificationInterface();
         notificationInterface->trackedGames = std::move(trackedGames);
+        notificationInterface->gamePublishQueue = std::move(gamePublishQueue);
         notificationInterface->notifiers = notifiers;
-        notificationInterface->gameBlocksNotifier = gameBlocksNotifier;
+        notificationInterface->gameBlocksNotifiers = gameBlocksNotifiers;
 
         if (!notificationInterface->Initialize())
         {
@@ -94,6 +168,16 @@ CZMQNotificationInterface* CZMQNotificationInterface::Create()
     return notificationInterface;
 }
 
+ZMQGameBlocksNotifier* CZMQNotificationInterface::GetGameBlocksNotifier(const std::string& game)
+{
+    for (auto* notifier : gameBlocksNotifiers) {
+        if (notifier->HandlesGame(game)) {
+            return notifier;
+        }
+    }
+    return nullptr;
+}
+
 // Called at startup to conditionally set up ZMQ socket(s)
 bool CZMQNotificationInterface::Initialize()
 {
@@ -199,7 +283,7 @@ void CZMQNotificationInterface::TransactionAddedToMempool(const CTransactionRef&
     for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
     {
         CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyPendingTx(*ptx))
+        if (notifier->NotifyPendingTx(ptx))
         {
             i++;
         }
@@ -222,7 +306,7 @@ void CZMQNotificationInterface::BlockConnected(const std::shared_ptr<const CBloc
     for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
     {
         CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyBlockAttached(*pblock))
+        if (notifier->NotifyBlockAttached(pblock))
         {
             i++;
         }
@@ -239,7 +323,7 @@ void CZMQNotificationInterface::BlockDisconnected(const std::shared_ptr<const CB
     for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
     {
         CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyBlockDetached(*pblock))
+        if (notifier->NotifyBlockDetached(pblock))
         {
             i++;
         }
@@ -9,6 +9,8 @@
 #include <zmq/zmqgames.h>
 
 #include <list>
+#include <string>
+#include <vector>
 
 class CBlockIndex;
 class CZMQAbstractNotifier;
@@ -27,9 +29,11 @@ public:
         return trackedGames.get();
     }
 
-    inline ZMQGameBlocksNotifier* GetGameBlocksNotifier() {
-        return gameBlocksNotifier;
-    }
+    /**
+     * Returns the game blocks notifier that publishes notifications for
+     * the given game, or null if there is none.
+     */
+    ZMQGameBlocksNotifier* GetGameBlocksNotifier(const std::string& game);
 
 protected:
     bool Initialize();
@@ -48,14 +52,18 @@ private:
     std::list<CZMQAbstractNotifier*> notifiers;
 
     /**
-     * The game blocks notifier, if any.  This is used to send on-demand
-     * notifications for game_sendupdates.
+     * The game blocks notifiers, i.e. the one for -zmqpubgameblocks (if any)
+     * and those for games with their own endpoint.  They are used to send
+     * on-demand notifications for game_sendupdates.
      */
-    ZMQGameBlocksNotifier* gameBlocksNotifier;
+    std::vector<ZMQGameBlocksNotifier*> gameBlocksNotifiers;
 
     /** The tracked games for notifications.  */
     std::unique_ptr<TrackedGames> trackedGames;
 
+    /** The queue for publishing game notifications, if enabled.  */
+    std::unique_ptr<ZMQGamePublishQueue> gamePublishQueue;
+
     /**
      * Sends out a transaction notification (NotifyTransaction on all our
      * notifiers).  This is called when adding to the mempool, when connecting
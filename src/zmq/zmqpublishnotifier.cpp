@@ -27,6 +27,60 @@ static const char *MSG_RAWTX     = "rawtx";
  */
 static CCriticalSection cs_zmqPublish;
 
+/**
+ * Subscriptions received on XPUB sockets, keyed by the socket.  Since libzmq
+ * only reports the first subscription and the last unsubscription for each
+ * topic prefix, this is the set of prefixes that at least one connected
+ * subscriber is subscribed to.  Sockets can be shared between notifiers, so
+ * this is kept per socket rather than per notifier.
+ */
+static std::map<void*, std::set<std::string>> mapSubscriptions GUARDED_BY(cs_zmqPublish);
+
+/**
+ * Processes all subscription changes received on the socket since the last
+ * call, if it tracks subscriptions.  This is done whenever the socket is
+ * used, so that the messages do not pile up even if nobody asks for the
+ * subscriptions.  Returns the current set of subscribed prefixes, or null
+ * if the socket does not track them.
+ */
+static const std::set<std::string>* ReadSubscriptions(void* sock, const std::string& address)
+{
+    AssertLockHeld(cs_zmqPublish);
+
+    auto mit = mapSubscriptions.find(sock);
+    if (mit == mapSubscriptions.end())
+        return nullptr;
+    auto& prefixes = mit->second;
+
+    /* each message is the topic prefix preceded by 1 (subscribe)
+       or 0 (unsubscribe) */
+    while (true)
+    {
+        zmq_msg_t msg;
+        zmq_msg_init(&msg);
+        if (zmq_msg_recv(&msg, sock, ZMQ_DONTWAIT) == -1)
+        {
+            zmq_msg_close(&msg);
+            break;
+        }
+
+        const char* data = static_cast<const char*>(zmq_msg_data(&msg));
+        const size_t size = zmq_msg_size(&msg);
+        if (size > 0 && (data[0] == 0 || data[0] == 1))
+        {
+            const std::string prefix(data + 1, size - 1);
+            if (data[0] == 1)
+                prefixes.insert(prefix);
+            else
+                prefixes.erase(prefix);
+            LogPrint(BCLog::ZMQ, "zmq: %s '%s' at %s\n", data[0] == 1 ? "Subscription to" : "Unsubscription from", prefix, address);
+        }
+        zmq_msg_close(&msg);
+    }
+
+    return &prefixes;
+}
+
 // Internal function to send multipart message
 static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
 {
@@ -72,6 +126,60 @@ static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
     return 0;
 }
 
+// Frees a buffer handed over to ZMQ with zmq_msg_init_data
+template <typename Buffer>
+static void zmq_free_buffer(void *data, void *hint)
+{
+    delete static_cast<Buffer*>(hint);
+}
+
+// Internal function to send a multipart message (command, data, sequence
+// number) where the data buffer is taken over by ZMQ without copying it
+template <typename Buffer>
+static int zmq_send_owned(void *sock, const char *command, Buffer&& data, const unsigned char *msgseq)
+{
+    AssertLockHeld(cs_zmqPublish);
+
+    zmq_msg_t msg;
+
+    if (zmq_msg_init_size(&msg, strlen(command)) != 0) {
+        zmqError("Unable to initialize ZMQ msg");
+        return -1;
+    }
+    memcpy(zmq_msg_data(&msg), command, strlen(command));
+    if (zmq_msg_send(&msg, sock, ZMQ_SNDMORE) == -1) {
+        zmqError("Unable to send ZMQ msg");
+        zmq_msg_close(&msg);
+        return -1;
+    }
+
+    Buffer* buf = new Buffer(std::move(data));
+    void* ptr = const_cast<void*>(static_cast<const void*>(buf->data()));
+    if (zmq_msg_init_data(&msg, ptr, buf->size(), zmq_free_buffer<Buffer>, buf) != 0) {
+        zmqError("Unable to initialize ZMQ msg");
+        delete buf;
+        return -1;
+    }
+    if (zmq_msg_send(&msg, sock, ZMQ_SNDMORE) == -1) {
+        zmqError("Unable to send ZMQ msg");
+        zmq_msg_close(&msg);
+        return -1;
+    }
+
+    if (zmq_msg_init_size(&msg, sizeof(uint32_t)) != 0) {
+        zmqError("Unable to initialize ZMQ msg");
+        return -1;
+    }
+    memcpy(zmq_msg_data(&msg), msgseq, sizeof(uint32_t));
+    if (zmq_msg_send(&msg, sock, 0) == -1) {
+        zmqError("Unable to send ZMQ msg");
+        zmq_msg_close(&msg);
+        return -1;
+    }
+
+    return 0;
+}
+
 bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
 {
     assert(!psocket);
@@ -81,13 +189,19 @@ bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
 
     if (i==mapPublishNotifiers.end())
     {
-        psocket = zmq_socket(pcontext, ZMQ_PUB);
+        psocket = zmq_socket(pcontext, trackSubscriptions ? ZMQ_XPUB : ZMQ_PUB);
         if (!psocket)
         {
             zmqError("Failed to create socket");
             return false;
         }
 
+        if (trackSubscriptions)
+        {
+            LOCK(cs_zmqPublish);
+            mapSubscriptions[psocket];
+        }
+
         LogPrint(BCLog::ZMQ, "zmq: Outbound message high water mark for %s at %s is %d\n", type, address, outbound_message_high_water_mark);
 
         int rc = zmq_setsockopt(psocket, ZMQ_SNDHWM, &outbound_message_high_water_mark, sizeof(outbound_message_high_water_mark));
@@ -147,6 +261,9 @@ void CZMQAbstractPublishNotifier::Shutdown()
         int linger = 0;
         zmq_setsockopt(psocket, ZMQ_LINGER, &linger, sizeof(linger));
         zmq_close(psocket);
+
+        LOCK(cs_zmqPublish);
+        mapSubscriptions.erase(psocket);
     }
 
     psocket = nullptr;
@@ -156,6 +273,7 @@ bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const void* d
 {
     assert(psocket);
     LOCK(cs_zmqPublish);
+    ReadSubscriptions(psocket, address);
 
     /* send three parts, command & data & a LE 4byte sequence number */
     unsigned char msgseq[sizeof(uint32_t)];
@@ -170,6 +288,59 @@ bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const void* d
     return true;
 }
 
+template <typename Buffer>
+bool CZMQAbstractPublishNotifier::SendOwnedMessage(const char *command, Buffer&& data)
+{
+    assert(psocket);
+    LOCK(cs_zmqPublish);
+    ReadSubscriptions(psocket, address);
+
+    unsigned char msgseq[sizeof(uint32_t)];
+    WriteLE32(&msgseq[0], sequenceNumbers[command]);
+    int rc = zmq_send_owned(psocket, command, std::move(data), msgseq);
+    if (rc == -1)
+        return false;
+
+    ++sequenceNumbers[command];
+
+    return true;
+}
+
+bool CZMQAbstractPublishNotifier::SendMessage(const char *command, std::string&& data)
+{
+    return SendOwnedMessage(command, std::move(data));
+}
+
+bool CZMQAbstractPublishNotifier::SendMessage(const char *command, std::vector<unsigned char>&& data)
+{
+    return SendOwnedMessage(command, std::move(data));
+}
+
+bool CZMQAbstractPublishNotifier::HasSubscriber(const std::string& command)
+{
+    assert(psocket);
+    LOCK(cs_zmqPublish);
+
+    const auto* prefixes = ReadSubscriptions(psocket, address);
+    if (prefixes == nullptr)
+        return true;
+
+    for (const auto& prefix : *prefixes)
+        if (command.compare(0, prefix.size(), prefix) == 0)
+            return true;
+
+    return false;
+}
+
+void CZMQAbstractPublishNotifier::SkipSequenceNumbers(const std::set<std::string>& commands)
+{
+    LOCK(cs_zmqPublish);
+
+    for (const auto& cmd : commands) {
+        ++sequenceNumbers[cmd];
+    }
+}
+
 bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
 {
     uint256 hash = pindex->GetBlockHash();
@@ -8,7 +8,9 @@
 #include <zmq/zmqabstractnotifier.h>
 
 #include <map>
+#include <set>
 #include <string>
+#include <vector>
 
 class CBlockIndex;
 
@@ -18,8 +20,22 @@ private:
     /** Upcounting sequence number of messages, per command string.  */
     std::map<std::string, uint32_t> sequenceNumbers;
 
+    /** Whether the socket should be created as XPUB, so that the
+        subscriptions of connected subscribers can be tracked.  */
+    bool trackSubscriptions = false;
+
+    template <typename Buffer>
+    bool SendOwnedMessage(const char *command, Buffer&& data);
+
 public:
 
+    /* create the socket as XPUB and track the subscriptions of connected
+       subscribers (see HasSubscriber); must be called before Initialize */
+    void SetTrackSubscriptions(bool track)
+    {
+        trackSubscriptions = track;
+    }
+
     /* send zmq multipart message
        parts:
           * command
@@ -28,6 +44,21 @@ public:
     */
     bool SendMessage(const char *command, const void* data, size_t size);
 
+    /* send zmq multipart message like above, but hand the data buffer
+       over to ZMQ instead of copying it into the message */
+    bool SendMessage(const char *command, std::string&& data);
+    bool SendMessage(const char *command, std::vector<unsigned char>&& data);
+
+    /* increment the sequence numbers of the given commands without sending
+       anything, so that subscribers can detect that messages have been
+       dropped */
+    void SkipSequenceNumbers(const std::set<std::string>& commands);
+
+    /* check whether any connected subscriber is subscribed to a prefix of
+       the given command; this is always true if the socket does not track
+       subscriptions */
+    bool HasSubscriber(const std::string& command);
+
     bool Initialize(void *pcontext) override;
     void Shutdown() override;
 };
@@ -7,6 +7,7 @@
 #include <rpc/server.h>
 #include <rpc/util.h>
 #include <zmq/zmqabstractnotifier.h>
+#include <zmq/zmqgames.h>
 #include <zmq/zmqnotificationinterface.h>
 
 #include <univalue.h>
@@ -23,7 +24,16 @@ UniValue getzmqnotifications(const JSONRPCRequest& request)
             "  {                        (json object)\n"
             "    \"type\": \"pubhashtx\",   (string) Type of notification\n"
             "    \"address\": \"...\",      (string) Address of the publisher\n"
-            "    \"hwm\": n                 (numeric) Outbound message high water mark\n"
+            "    \"hwm\": n,                (numeric) Outbound message high water mark\n"
+            "    \"games\": [...],          (json array, only for game blocks notifiers with their own endpoint) Games published on this address\n"
+            "    \"queue\": {             (json object, only for asynchronous game notifiers) Publishing queue shared by all game notifiers\n"
+            "      \"size\": n,             (numeric) Number of currently queued notifications\n"
+            "      \"maxsize\": n,          (numeric) Maximum size of the queue\n"
+            "      \"peak\": n,             (numeric) Largest size the queue had so far\n"
+            "      \"published\": n,        (numeric) Number of notifications published\n"
+            "      \"dropped\": n,          (numeric) Number of notifications dropped because the queue was full\n"
+            "      \"policy\": \"...\"        (string) Policy when the queue is full (block or drop)\n"
+            "    }\n"
             "  },\n"
             "  ...\n"
             "]\n"
@@ -41,6 +51,28 @@ UniValue getzmqnotifications(const JSONRPCRequest& request)
             obj.pushKV("type", n->GetType());
             obj.pushKV("address", n->GetAddress());
             obj.pushKV("hwm", n->GetOutboundMessageHighWaterMark());
+
+            const auto* blocksNotifier = dynamic_cast<const ZMQGameBlocksNotifier*>(n);
+            if (blocksNotifier != nullptr && !blocksNotifier->GetOnlyGames().empty()) {
+                UniValue games(UniValue::VARR);
+                for (const auto& g : blocksNotifier->GetOnlyGames()) {
+                    games.push_back(g);
+                }
+                obj.pushKV("games", games);
+            }
+
+            const auto* gameNotifier = dynamic_cast<const ZMQGameNotifier*>(n);
+            if (gameNotifier != nullptr && gameNotifier->GetPublishQueue() != nullptr) {
+                const auto stats = gameNotifier->GetPublishQueue()->GetStats();
+                UniValue queue(UniValue::VOBJ);
+                queue.pushKV("size", static_cast<uint64_t>(stats.size));
+                queue.pushKV("maxsize", static_cast<uint64_t>(stats.maxSize));
+                queue.pushKV("peak", static_cast<uint64_t>(stats.peak));
+                queue.pushKV("published", stats.published);
+                queue.pushKV("dropped", stats.dropped);
+                queue.pushKV("policy", stats.policy == ZMQGamePublishQueue::Policy::DROP ? "drop" : "block");
+                obj.pushKV("queue", queue);
+            }
             result.push_back(obj);
         }
     }
@@ -381,5 +381,36 @@ class RESTTest (BitcoinTestFramework):
                                           req_type=ReqType.BIN,
                                           ret_type=RetType.OBJ)
 
+        # Batched lookup of names.
+        self.log.info("Test the /names URI")
+        body = "\n".join([variants[0], "x/unknown", variants[1]]) + "\n"
+        data = self.test_rest_request ('/names', http_method='POST', body=body,
+                                       req_type=ReqType.JSON)
+        assert_equal(data, [nameData, None, nameData])
+
+        res = self.test_rest_request ('/names', http_method='POST', body=body,
+                                      req_type=ReqType.BIN,
+                                      ret_type=RetType.BYTES)
+        valueBytes = value.encode ('ascii')
+        assert len (valueBytes) < 0xfd
+        entry = b'\x01' + bytes ([len (valueBytes)]) + valueBytes
+        assert_equal(res, entry + b'\x00' + entry)
+
+        res = self.test_rest_request ('/names', http_method='POST', body=body,
+                                      req_type=ReqType.HEX,
+                                      ret_type=RetType.BYTES)
+        assert_equal(res.decode ('ascii'), (entry + b'\x00' + entry).hex () + "\n")
+
+        self.test_rest_request ('/names', http_method='GET',
+                                status=http.client.METHOD_NOT_ALLOWED,
+                                req_type=ReqType.JSON, ret_type=RetType.OBJ)
+        self.test_rest_request ('/names', http_method='POST', body='%x2',
+                                status=http.client.BAD_REQUEST,
+                                req_type=ReqType.JSON, ret_type=RetType.OBJ)
+        tooMany = "\n".join(["x/a"] * 1001)
+        self.test_rest_request ('/names', http_method='POST', body=tooMany,
+                                status=http.client.BAD_REQUEST,
+                                req_type=ReqType.JSON, ret_type=RetType.OBJ)
+
 if __name__ == '__main__':
     RESTTest().main()
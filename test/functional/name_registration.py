@@ -128,6 +128,35 @@ class NameRegistrationTest (NameTestFramework):
       val ("updated"),
     ])
 
+    # Paging through the history.
+    def historyValues (options):
+      return [e['value'] for e in node.name_history ("x/test-name", options)]
+    assert_equal (historyValues ({"start": 1, "count": 2}),
+                  [valueOfLength (2048), duplicateKeys])
+    assert_equal (historyValues ({"start": 3}), [val ("sent"), val ("updated")])
+    assert_equal (historyValues ({"start": 5}), [])
+    assert_equal (historyValues ({"count": 0}), [])
+    assert_equal (historyValues ({"reverse": True, "count": 2}),
+                  [val ("updated"), val ("sent")])
+    assert_equal (historyValues ({"reverse": True, "start": 4}),
+                  [val ("test-value")])
+    assert_raises_rpc_error (-8, 'start must not be negative',
+                             node.name_history, "x/test-name", {"start": -1})
+    assert_raises_rpc_error (-8, 'count must not be negative',
+                             node.name_history, "x/test-name", {"count": -1})
+
+    # Batched lookup of names.
+    res = node.name_show_many (["x/test-name", "x/unknown", "x/name-0",
+                                "x/test-name"])
+    assert_equal (len (res), 4)
+    assert_equal (res[0], node.name_show ("x/test-name"))
+    assert_equal (res[1], None)
+    assert_equal (res[2], node.name_show ("x/name-0"))
+    assert_equal (res[3], res[0])
+    assert_equal (node.name_show_many ([]), [])
+    assert_raises_rpc_error (-8, 'at most 1000 names',
+                             node.name_show_many, ["x/name-0"] * 1001)
+
     # Invalid updates.
     assert_raises_rpc_error (-25, 'this name can not be updated',
                              node.name_update, "x/wrong-name", val ("foo"))
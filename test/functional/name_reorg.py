@@ -13,7 +13,10 @@ class NameReorgTest (NameTestFramework):
 
   def set_test_params (self):
     self.setup_clean_chain = True
-    self.setup_name_test ([["-namehistory"]])
+    # Do the full name DB check only every other block, and check the names
+    # touched by all other connected and disconnected blocks incrementally.
+    self.setup_name_test ([["-namehistory", "-checknamedb=2",
+                            "-checknamedbincremental"]])
 
   def run_test (self):
     node = self.nodes[0]
@@ -11,7 +11,8 @@ from test_framework.util import *
 class NameScanningTest (NameTestFramework):
 
   def set_test_params (self):
-    self.setup_name_test ([["-nameencoding=ascii", "-valueencoding=ascii"]] * 1)
+    self.args = ["-nameencoding=ascii", "-valueencoding=ascii"]
+    self.setup_name_test ([self.args] * 2)
 
   def run_test (self):
     self.node = self.nodes[0]
@@ -105,10 +106,62 @@ class NameScanningTest (NameTestFramework):
     }
     self.checkList (self.node.name_scan ("", 100, options), ["d/a"])
 
+    # Report the block the scan is consistent with.
+    res = self.node.name_scan ("", 2, {"withBlock": True})
+    assert_equal (res["hash"], self.node.getbestblockhash ())
+    assert_equal (res["height"], self.node.getblockcount ())
+    self.checkList (res["names"], ["d/a", "d/b"])
+    res = self.node.name_scan ("", 0, {"withBlock": True})
+    assert_equal (res["names"], [])
+
     # Upstream Namecoin tests here that a name with invalid UTF-8 doesn't
     # break name_filter's regexp check.  In Xaya, this name is invalid,
     # so we can't do this.
 
+    # Rebuild the second node's database with the lexicographic index.
+    self.sync_blocks ()
+    self.restart_node (1, extra_args=self.args + ["-namescanindex", "-reindex"])
+    wait_until (lambda: (self.nodes[1].getbestblockhash ()
+                          == self.node.getbestblockhash ()))
+    self.testScanIndex (self.nodes[1])
+
+  def testScanIndex (self, node):
+    """
+    Tests prefix scans with the lexicographic name index enabled.
+    """
+
+    # With a prefix, names are returned in lexicographic order.
+    self.checkList (node.name_scan ("", 100, {"prefix": "d/"}),
+                    ["d/a", "d/aa", "d/b", "d/c"])
+    self.checkList (node.name_scan ("", 100, {"prefix": "d/a"}),
+                    ["d/a", "d/aa"])
+    self.checkList (node.name_scan ("", 100, {"prefix": "d/x"}), [])
+    self.checkList (node.name_scan ("", 100, {"prefix": "e/"}), [])
+
+    # Combination with start, count and other filters.
+    self.checkList (node.name_scan ("d/ab", 100, {"prefix": "d/"}),
+                    ["d/b", "d/c"])
+    self.checkList (node.name_scan ("c", 100, {"prefix": "d/a"}),
+                    ["d/a", "d/aa"])
+    self.checkList (node.name_scan ("", 2, {"prefix": "d/"}),
+                    ["d/a", "d/aa"])
+    options = {
+        "prefix": "d/",
+        "maxConf": 20,
+    }
+    self.checkList (node.name_scan ("", 100, options), ["d/a", "d/c"])
+
+    # Without a prefix, the usual order is used.
+    self.checkList (node.name_scan (), ["d/a", "d/b", "d/c", "d/aa"])
+
+    # Unconfirmed changes are merged with the index.
+    node.name_register ("d/ab", val ("value ab"))
+    node.generate (1)
+    self.checkList (node.name_scan ("", 100, {"prefix": "d/a"}),
+                    ["d/a", "d/aa", "d/ab"])
+
+    assert node.name_checkdb ()
+
   def checkList (self, data, names):
     """
     Check that the result in 'data' contains the names
@@ -244,7 +244,11 @@ BASE_SCRIPTS = [
     # Xaya-specific tests
     'xaya_dualalgo.py',
     'xaya_gameblocks.py',
+    'xaya_gameendpoints.py',
     'xaya_gamepending.py',
+    'xaya_gamependingbatch.py',
+    'xaya_gamequeue.py',
+    'xaya_gamesendupdates.py',
     'xaya_postico_fork.py',
     'xaya_premine.py',
     'xaya_trackedgames.py',
@@ -85,6 +85,7 @@ class GameBlocksTest (XayaZmqTest):
     self._test_reorg ()
     self._test_sendUpdates ()
     self._test_maxGameBlockAttaches ()
+    self._test_queueStats ()
 
     # After all the real tests, verify no more notifications are there.
     # This especially verifies that the "ignored" game we are subscribed to
@@ -93,6 +94,20 @@ class GameBlocksTest (XayaZmqTest):
     for _, sub in self.games.items ():
       sub.assertNoMessage ()
 
+  def _test_queueStats (self):
+    """
+    Verifies that getzmqnotifications reports no publishing queue, since
+    notifications are sent synchronously by default.  The queue itself
+    is tested in xaya_gamequeue.py.
+    """
+
+    self.log.info ("Testing queue statistics...")
+
+    notifications = self.node.getzmqnotifications ()
+    assert_equal (len (notifications), 1)
+    assert_equal (notifications[0]["type"], "pubgameblocks")
+    assert "queue" not in notifications[0]
+
   def _test_currencyIgnored (self):
     """
     Tests that a currency transaction does not show up as move in the
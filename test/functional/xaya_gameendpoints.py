@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Xaya developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+"""Tests per-game endpoints and subscription tracking of game notifiers."""
+
+from test_framework.util import (
+  assert_equal,
+  zmq_port,
+)
+from test_framework.xaya_zmq import (
+  XayaZmqTest,
+  ZmqSubscriber,
+)
+
+import json
+import time
+
+
+class GameEndpointsTest (XayaZmqTest):
+
+  def set_test_params (self):
+    self.num_nodes = 1
+
+  def setup_nodes (self):
+    self.address = "tcp://127.0.0.1:%d" % zmq_port (1)
+    self.addressA = "tcp://127.0.0.1:%d" % zmq_port (2)
+    self.addressUntracked = "tcp://127.0.0.1:%d" % zmq_port (3)
+
+    args = []
+    args.append ("-zmqpubgameblocks=%s" % self.address)
+    args.append ("-zmqpubgameblocksfor=a=%s" % self.addressA)
+    args.append ("-zmqpubgameblocksfor=untracked=%s" % self.addressUntracked)
+    args.append ("-zmqgametracksubscriptions")
+    args.extend (["-trackgame=%s" % g for g in ["a", "b", "c"]])
+    self.add_nodes (self.num_nodes, extra_args=[args])
+    self.start_nodes ()
+    self.import_deterministic_coinbase_privkeys ()
+
+    self.node = self.nodes[0]
+
+  def run_test (self):
+    # Make the checks for BitcoinTestFramework subclasses happy.
+    super ().run_test ()
+
+  def run_test_with_zmq (self, ctx):
+    self.games = {
+      "a": ZmqSubscriber (ctx, self.addressA, "a"),
+      "b": ZmqSubscriber (ctx, self.address, "b"),
+      "wrong": ZmqSubscriber (ctx, self.address, "a"),
+    }
+    for _, sub in self.games.items ():
+      sub.subscribe ("game-block-attach")
+
+    self._test_notifiers ()
+    self._test_endpoints ()
+    self._test_lateSubscriber (ctx)
+    self._test_sendUpdates ()
+
+    self.log.info ("Verifying that there are no unexpected messages...")
+    for _, sub in self.games.items ():
+      sub.assertNoMessage ()
+
+  def _test_notifiers (self):
+    self.log.info ("Testing getzmqnotifications...")
+
+    # There is no notifier for the endpoint of the untracked game.
+
+    notifications = self.node.getzmqnotifications ()
+    assert_equal (len (notifications), 2)
+    byAddress = {n["address"]: n for n in notifications}
+    assert_equal (byAddress[self.address]["type"], "pubgameblocks")
+    assert "games" not in byAddress[self.address]
+    assert_equal (byAddress[self.addressA]["type"], "pubgameblocks")
+    assert_equal (byAddress[self.addressA]["games"], ["a"])
+
+  def _test_endpoints (self):
+    self.log.info ("Testing notifications on separate endpoints...")
+
+    txid = self.node.name_register ("p/x", json.dumps ({"g": {"a": 1, "b": 2}}))
+    self.node.generate (1)
+
+    topic, data = self.games["a"].receive ()
+    assert_equal (topic, "game-block-attach json a")
+    assert_equal ([mv["txid"] for mv in data["moves"]], [txid])
+    assert_equal (data["moves"][0]["move"], 1)
+
+    topic, data = self.games["b"].receive ()
+    assert_equal (topic, "game-block-attach json b")
+    assert_equal (data["moves"][0]["move"], 2)
+
+  def _test_lateSubscriber (self, ctx):
+    self.log.info ("Testing subscriber that connects later...")
+
+    # Game c is tracked, but nobody is subscribed to it yet.  Thus no
+    # notifications are sent, but its sequence number is advanced
+    # nevertheless (for all blocks attached so far in the test).
+    self.node.generate (2)
+    self.games["a"].receive ()
+    self.games["a"].receive ()
+    self.games["b"].receive ()
+    self.games["b"].receive ()
+
+    self.games["c"] = ZmqSubscriber (ctx, self.address, "c")
+    self.games["c"].subscribe ("game-block-attach")
+    # Give the daemon time to learn about the new subscription.
+    time.sleep (1)
+
+    blk = self.node.generate (1)[0]
+    self.games["a"].receive ()
+    self.games["b"].receive ()
+
+    # The subscriber verifies that the sequence number it receives matches
+    # the expected one.
+    self.games["c"].sequence["game-block-attach json c"] = 3
+    topic, data = self.games["c"].receive ()
+    assert_equal (topic, "game-block-attach json c")
+    assert_equal (data["block"]["hash"], blk)
+
+  def _test_sendUpdates (self):
+    self.log.info ("Testing game_sendupdates for a separate endpoint...")
+
+    parent = self.node.getbestblockhash ()
+    blk = self.node.generate (1)[0]
+    for g in ["a", "b", "c"]:
+      self.games[g].receive ()
+
+    upd = self.node.game_sendupdates ("a", parent)
+    assert_equal (upd["toblock"], blk)
+
+    topic, data = self.games["a"].receive ()
+    assert_equal (topic, "game-block-attach json a")
+    assert_equal (data["block"]["hash"], blk)
+    assert_equal (data["reqtoken"], upd["reqtoken"])
+
+
+if __name__ == '__main__':
+  GameEndpointsTest ().main ()
@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Xaya developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+"""Tests batching of "game-pending" ZMQ notifications."""
+
+from test_framework.util import (
+  assert_equal,
+  assert_greater_than,
+  zmq_port,
+)
+from test_framework.xaya_zmq import (
+  XayaZmqTest,
+  ZmqSubscriber,
+)
+
+import json
+import time
+
+# Batching options used for the test:  Batches are sent either after
+# two seconds or when three moves have been collected.
+BATCH_MILLIS = 2000
+BATCH_MAX = 3
+
+
+class GamePendingBatchTest (XayaZmqTest):
+
+  def set_test_params (self):
+    self.num_nodes = 1
+
+  def setup_nodes (self):
+    self.address = "tcp://127.0.0.1:%d" % zmq_port (1)
+
+    args = []
+    args.append ("-zmqpubgamepending=%s" % self.address)
+    args.append ("-zmqpubgamependingbatch=%d,%d" % (BATCH_MILLIS, BATCH_MAX))
+    args.extend (["-trackgame=%s" % g for g in ["a", "b"]])
+    self.add_nodes (self.num_nodes, extra_args=[args])
+    self.start_nodes ()
+    self.import_deterministic_coinbase_privkeys ()
+
+    self.node = self.nodes[0]
+
+  def run_test (self):
+    # Make the checks for BitcoinTestFramework subclasses happy.
+    super ().run_test ()
+
+  def run_test_with_zmq (self, ctx):
+    self.games = {}
+    for g in ["a", "b"]:
+      self.games[g] = ZmqSubscriber (ctx, self.address, g)
+      self.games[g].subscribe ("game-pending-batch")
+
+    self._test_sizeLimit ()
+    self._test_timeLimit ()
+
+    self.log.info ("Verifying that there are no unexpected messages...")
+    for _, sub in self.games.items ():
+      sub.assertNoMessage ()
+
+  def _test_sizeLimit (self):
+    self.log.info ("Testing batch sent when full...")
+
+    txids = []
+    for i in range (BATCH_MAX):
+      txids.append (self.node.name_register ("p/size%d" % i,
+                                             json.dumps ({"g": {"a": i}})))
+
+    topic, data = self.games["a"].receive ()
+    assert_equal (topic, "game-pending-batch json a")
+    assert_equal ([mv["txid"] for mv in data["moves"]], txids)
+    assert_equal ([mv["move"] for mv in data["moves"]], list (range (BATCH_MAX)))
+
+    seqs = [mv["seq"] for mv in data["moves"]]
+    assert_equal (seqs, sorted (seqs))
+    assert_greater_than (seqs[-1], seqs[0])
+    assert_equal (data["seq"], {"first": seqs[0], "last": seqs[-1]})
+
+    self.node.generate (1)
+
+  def _test_timeLimit (self):
+    self.log.info ("Testing batch sent after timeout...")
+
+    start = time.time ()
+    txid = self.node.name_register ("p/time", json.dumps ({"g": {"b": 42}}))
+
+    topic, data = self.games["b"].receive ()
+    assert_equal (topic, "game-pending-batch json b")
+    assert_equal (len (data["moves"]), 1)
+    assert_equal (data["moves"][0]["txid"], txid)
+    assert_equal (data["moves"][0]["name"], "time")
+    assert_equal (data["moves"][0]["move"], 42)
+    assert_equal (data["seq"]["first"], data["moves"][0]["seq"])
+    assert_equal (data["seq"]["last"], data["moves"][0]["seq"])
+    assert_greater_than (time.time () - start, BATCH_MILLIS / 1000 * 0.9)
+
+    self.node.generate (1)
+
+
+if __name__ == '__main__':
+  GamePendingBatchTest ().main ()
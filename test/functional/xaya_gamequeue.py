@@ -0,0 +1,176 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Xaya developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+"""Tests the asynchronous publishing queue of the game ZMQ notifiers."""
+
+from test_framework.util import (
+  assert_equal,
+  assert_greater_than,
+  zmq_port,
+)
+from test_framework.xaya_zmq import (
+  XayaZmqTest,
+  ZmqSubscriber,
+)
+
+import codecs
+import json
+import struct
+import time
+
+# Size of the publishing queue and the artificial delay (in milliseconds)
+# before each queued notification is published.  With those, the queue
+# fills up when a handful of blocks is generated at once.
+QUEUE_SIZE = 2
+QUEUE_DELAY = 500
+
+# Number of blocks generated in one go to fill up the queue.
+NUM_BLOCKS = 8
+
+
+class GameQueueTest (XayaZmqTest):
+
+  def set_test_params (self):
+    self.num_nodes = 1
+
+  def setup_nodes (self):
+    self.address = "tcp://127.0.0.1:%d" % zmq_port (1)
+    self.add_nodes (self.num_nodes, extra_args=[self.getArgs ("block")])
+    self.start_nodes ()
+    self.import_deterministic_coinbase_privkeys ()
+
+    self.node = self.nodes[0]
+
+  def getArgs (self, policy):
+    args = []
+    args.append ("-zmqpubgameblocks=%s" % self.address)
+    args.append ("-zmqgamequeue=%d" % QUEUE_SIZE)
+    args.append ("-zmqgamequeuepolicy=%s" % policy)
+    args.append ("-zmqgamequeuedelay=%d" % QUEUE_DELAY)
+    args.extend (["-trackgame=%s" % g for g in ["a", "b"]])
+    return args
+
+  def run_test (self):
+    # Make the checks for BitcoinTestFramework subclasses happy.
+    super ().run_test ()
+
+  def run_test_with_zmq (self, ctx):
+    self._test_block (ctx)
+    self._test_drop (ctx)
+
+  def getQueueStats (self):
+    notifications = self.node.getzmqnotifications ()
+    assert_equal (len (notifications), 1)
+    return notifications[0]["queue"]
+
+  def _test_block (self, ctx):
+    self.log.info ("Testing the block policy...")
+
+    games = {}
+    for g in ["a", "b"]:
+      games[g] = ZmqSubscriber (ctx, self.address, g)
+      games[g].subscribe ("game-block-attach")
+    # Give the subscriptions time to reach the publisher.
+    time.sleep (1)
+
+    # Generating the blocks has to wait for the publisher, since only
+    # QUEUE_SIZE notifications can be queued (and one processed).
+    start = time.time ()
+    blks = self.node.generate (NUM_BLOCKS)
+    elapsed = time.time () - start
+    minWait = (NUM_BLOCKS - QUEUE_SIZE - 1) * QUEUE_DELAY / 1000
+    assert_greater_than (elapsed, minWait * 0.9)
+
+    # A game_sendupdates request made afterwards is queued behind the
+    # block notifications.
+    token = self.node.game_sendupdates ("a", blks[-2])["reqtoken"]
+
+    # All notifications arrive in order and without gaps (the latter is
+    # verified by ZmqSubscriber).
+    for g in ["a", "b"]:
+      for blk in blks:
+        topic, data = games[g].receive ()
+        assert_equal (topic, "game-block-attach json %s" % g)
+        assert_equal (data["block"]["hash"], blk)
+        assert "reqtoken" not in data
+    topic, data = games["a"].receive ()
+    assert_equal (topic, "game-block-attach json a")
+    assert_equal (data["block"]["hash"], blks[-1])
+    assert_equal (data["reqtoken"], token)
+
+    for _, sub in games.items ():
+      sub.assertNoMessage ()
+
+    stats = self.getQueueStats ()
+    assert_equal (stats["maxsize"], QUEUE_SIZE)
+    assert_equal (stats["policy"], "block")
+    assert_equal (stats["dropped"], 0)
+    assert_equal (stats["peak"], QUEUE_SIZE)
+
+  def _test_drop (self, ctx):
+    self.log.info ("Testing the drop policy...")
+
+    self.restart_node (0, extra_args=self.getArgs ("drop"))
+
+    # We do not use ZmqSubscriber here, since it asserts that there are
+    # no gaps in the sequence numbers.
+    import zmq
+    socket = ctx.socket (zmq.SUB)
+    socket.set (zmq.RCVTIMEO, 60000)
+    socket.connect (self.address)
+    for prefix in ["game-block-attach", "game-block-detach"]:
+      socket.setsockopt_string (zmq.SUBSCRIBE, "%s json a" % prefix)
+    time.sleep (1)
+
+    # Generating the blocks does not wait, but notifications are dropped.
+    blks = self.node.generate (NUM_BLOCKS)
+    stats = self.getQueueStats ()
+    assert_equal (stats["policy"], "drop")
+    assert_greater_than (stats["dropped"], 0)
+    assert_greater_than (NUM_BLOCKS - QUEUE_SIZE, stats["dropped"] - 1)
+
+    # Wait for the queue to drain and generate one more block, so that the
+    # gap from the dropped notifications is signalled even if the last
+    # notifications were the ones dropped.
+    while self.getQueueStats ()["size"] > 0:
+      time.sleep (0.1)
+    time.sleep (2 * QUEUE_DELAY / 1000)
+    blks.extend (self.node.generate (1))
+
+    def receive ():
+      topic, body, seq = socket.recv_multipart ()
+      return (codecs.decode (topic, "ascii"),
+              json.loads (codecs.decode (body, "ascii")),
+              struct.unpack ("<I", seq)[-1])
+
+    # The received notifications are in order and the sequence numbers
+    # have a gap where notifications were dropped.
+    received = []
+    while True:
+      topic, data, seq = receive ()
+      assert_equal (topic, "game-block-attach json a")
+      received.append ((data["block"]["hash"], seq))
+      if data["block"]["hash"] == blks[-1]:
+        break
+    assert_greater_than (len (blks), len (received))
+    assert_equal ([b for b, _ in received],
+                  [b for b in blks if b in dict (received)])
+    seqs = [s for _, s in received]
+    assert_equal (seqs, sorted (set (seqs)))
+    assert_greater_than (seqs[-1], len (seqs) - 1)
+
+    # The detach topic had no notifications dropped, so its sequence
+    # number must not have been advanced.
+    self.node.invalidateblock (blks[-1])
+    topic, data, seq = receive ()
+    assert_equal (topic, "game-block-detach json a")
+    assert_equal (data["block"]["hash"], blks[-1])
+    assert_equal (seq, 0)
+
+    socket.close (linger=0)
+
+
+if __name__ == '__main__':
+  GameQueueTest ().main ()
@@ -0,0 +1,170 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Xaya developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+"""Tests concurrent processing of game_sendupdates requests."""
+
+from test_framework.util import (
+  assert_equal,
+  assert_greater_than,
+  zmq_port,
+)
+from test_framework.xaya_zmq import (
+  XayaZmqTest,
+  ZmqSubscriber,
+)
+
+import os
+import time
+
+# Notifications are published through a small queue with an artificial
+# delay, so that requests take long enough to overlap.
+QUEUE_DELAY = 100
+
+
+class GameSendUpdatesTest (XayaZmqTest):
+
+  def set_test_params (self):
+    self.num_nodes = 1
+
+  def setup_nodes (self):
+    self.address = "tcp://127.0.0.1:%d" % zmq_port (1)
+
+    args = []
+    args.append ("-zmqpubgameblocks=%s" % self.address)
+    args.append ("-zmqgamequeue=1")
+    args.append ("-zmqgamequeuedelay=%d" % QUEUE_DELAY)
+    args.append ("-sendupdatesthreads=2")
+    args.append ("-sendupdatesreadahead=4")
+    args.append ("-trackgame=a")
+    self.add_nodes (self.num_nodes, extra_args=[args])
+    self.start_nodes ()
+    self.import_deterministic_coinbase_privkeys ()
+
+    self.node = self.nodes[0]
+
+  def run_test (self):
+    # Make the checks for BitcoinTestFramework subclasses happy.
+    super ().run_test ()
+
+  def run_test_with_zmq (self, ctx):
+    self.sub = ZmqSubscriber (ctx, self.address, "a")
+    self.sub.subscribe ("game-block-attach")
+    self.sub.subscribe ("game-block-detach")
+    time.sleep (1)
+
+    self.blocks = self.node.generate (30)
+    for blk in self.blocks:
+      _, data = self.sub.receive ()
+      assert_equal (data["block"]["hash"], blk)
+
+    self._test_ordering ()
+    self._test_fairness ()
+    self._test_readErrors (ctx)
+
+    self.log.info ("Verifying that there are no unexpected messages...")
+    self.sub.assertNoMessage ()
+
+  def receiveForTokens (self, num):
+    """
+    Receives num notifications and returns them as list of
+    (reqtoken, topic, block hash) tuples.
+    """
+
+    res = []
+    for _ in range (num):
+      topic, data = self.sub.receive ()
+      res.append ((data["reqtoken"], topic, data["block"]["hash"]))
+
+    return res
+
+  def _test_ordering (self):
+    self.log.info ("Testing ordering of concurrent requests...")
+
+    # Request updates from a side chain to the main chain (detaches and
+    # then attaches) and, concurrently, a second request along the main
+    # chain.  Each request has its notifications in order, independent of
+    # the reader threads.
+    fork = self.blocks[-10]
+    self.node.invalidateblock (fork)
+    for _ in range (10):
+      self.sub.receive ()
+    side = self.node.generatetoaddress (3, self.node.getnewaddress ())
+    for _ in side:
+      self.sub.receive ()
+    self.node.reconsiderblock (fork)
+    for _ in range (13):
+      self.sub.receive ()
+    assert_equal (self.node.getbestblockhash (), self.blocks[-1])
+
+    resFork = self.node.game_sendupdates ("a", side[-1])
+    resMain = self.node.game_sendupdates ("a", self.blocks[0])
+    assert_equal (resFork["steps"], {"detach": 3, "attach": 10})
+    assert_equal (resMain["steps"], {"detach": 0, "attach": 29})
+
+    msgs = self.receiveForTokens (3 + 10 + 29)
+
+    forkMsgs = [(t, h) for tok, t, h in msgs if tok == resFork["reqtoken"]]
+    expected = [("game-block-detach json a", h) for h in reversed (side)]
+    expected.extend ([("game-block-attach json a", h)
+                      for h in self.blocks[-10:]])
+    assert_equal (forkMsgs, expected)
+
+    mainMsgs = [h for tok, _, h in msgs if tok == resMain["reqtoken"]]
+    assert_equal (mainMsgs, self.blocks[1:])
+
+  def _test_fairness (self):
+    self.log.info ("Testing round-robin between requests...")
+
+    # A long request started before a short one does not block the
+    # short one until it is done.
+    resLong = self.node.game_sendupdates ("a", self.blocks[0])
+    resShort = self.node.game_sendupdates ("a", self.blocks[-3])
+
+    msgs = self.receiveForTokens (29 + 2)
+    tokens = [tok for tok, _, _ in msgs]
+    lastShort = max (i for i, tok in enumerate (tokens)
+                     if tok == resShort["reqtoken"])
+    lastLong = max (i for i, tok in enumerate (tokens)
+                    if tok == resLong["reqtoken"])
+    assert_greater_than (lastLong, lastShort)
+    assert_greater_than (len (tokens) // 2, lastShort)
+
+    assert_equal ([h for tok, _, h in msgs if tok == resLong["reqtoken"]],
+                  self.blocks[1:])
+    assert_equal ([h for tok, _, h in msgs if tok == resShort["reqtoken"]],
+                  self.blocks[-2:])
+
+  def _test_readErrors (self, ctx):
+    self.log.info ("Testing blocks that cannot be read...")
+
+    # Restart the node so that the parsed moves are no longer cached, and
+    # make the block data unavailable.  Reading the blocks fails for the
+    # reader threads, and those steps are skipped.  The worker is not
+    # blocked by that, and later requests work again.
+    self.restart_node (0)
+    self.sub = ZmqSubscriber (ctx, self.address, "a")
+    self.sub.subscribe ("game-block-attach")
+    time.sleep (1)
+
+    blkFile = os.path.join (self.node.datadir, "regtest", "blocks",
+                            "blk00000.dat")
+    os.rename (blkFile, blkFile + ".moved")
+    resFailed = self.node.game_sendupdates ("a", self.blocks[0])
+    assert_equal (resFailed["steps"]["attach"], 29)
+
+    # Wait until the failed request has been processed before the block
+    # data becomes available again.
+    time.sleep (2)
+    os.rename (blkFile + ".moved", blkFile)
+
+    res = self.node.game_sendupdates ("a", self.blocks[-2])
+    topic, data = self.sub.receive ()
+    assert_equal (topic, "game-block-attach json a")
+    assert_equal (data["reqtoken"], res["reqtoken"])
+    assert_equal (data["block"]["hash"], self.blocks[-1])
+
+
+if __name__ == '__main__':
+  GameSendUpdatesTest ().main ()